@@ -0,0 +1,611 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "AigBitExpressions.h"
+
+AigBitExpressionEngine::AigBitExpressionEngine() : and_count(0), collect_threshold(1 << 16), visit_epoch(0)
+{
+    Reference(AddNode(BitExpressionKind::Const, 0, 0) << 1);
+}
+
+std::shared_ptr<IBitExpression> AigBitExpressionEngine::Const(bool value)
+{
+    return GetHandle(value ? 1 : 0);
+}
+
+std::shared_ptr<IBitExpression> AigBitExpressionEngine::Variable(size_t var_index, size_t bit_number)
+{
+    MaybeCollect();
+    return GetHandle(MakeVariable(static_cast<uint32_t>(var_index), static_cast<uint32_t>(bit_number)));
+}
+
+std::shared_ptr<IBitExpression> AigBitExpressionEngine::Neg(const std::shared_ptr<IBitExpression>& argument)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> argument_handle = Import(argument);
+    return GetHandle(GetLiteral(argument_handle) ^ 1);
+}
+
+std::shared_ptr<IBitExpression> AigBitExpressionEngine::Or(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> left_handle = Import(left);
+    const std::shared_ptr<IBitExpression> right_handle = Import(right);
+    return GetHandle(MakeOr(GetLiteral(left_handle), GetLiteral(right_handle)));
+}
+
+std::shared_ptr<IBitExpression> AigBitExpressionEngine::And(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> left_handle = Import(left);
+    const std::shared_ptr<IBitExpression> right_handle = Import(right);
+    return GetHandle(MakeAnd(GetLiteral(left_handle), GetLiteral(right_handle)));
+}
+
+std::shared_ptr<IBitExpression> AigBitExpressionEngine::Xor(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> left_handle = Import(left);
+    const std::shared_ptr<IBitExpression> right_handle = Import(right);
+    return GetHandle(MakeXor(GetLiteral(left_handle), GetLiteral(right_handle)));
+}
+
+std::string AigBitExpressionEngine::ToString(uint32_t literal, const BitExpressionStates& info) const
+{
+    struct Frame
+    {
+        uint32_t literal;
+        uint32_t next;
+    };
+    std::vector<Frame> frames;
+    std::vector<std::string> strings;
+    size_t written_nodes = 1;
+    Frame root = { literal, 0 };
+    frames.push_back(root);
+    while (!frames.empty())
+    {
+        const uint32_t current = frames.back().literal;
+        const uint32_t node = current >> 1;
+        const bool complement = (current & 1) != 0;
+        const bool leaf = kinds[node] == BitExpressionKind::Const || kinds[node] == BitExpressionKind::Variable;
+        // An Or is printed over the complemented fanins of its And node
+        const uint32_t fanin_mask = !leaf && IsOr(current) ? 1 : 0;
+        if (!leaf && frames.back().next < 2)
+        {
+            Frame frame = { (frames.back().next++ ? fanins1[node] : fanins0[node]) ^ fanin_mask, 0 };
+            if (written_nodes >= max_string_nodes)
+            {
+                strings.push_back("...");
+                continue;
+            }
+            ++written_nodes;
+            frames.push_back(frame);
+            continue;
+        }
+        frames.pop_back();
+        std::string text;
+        if (kinds[node] == BitExpressionKind::Const)
+        {
+            text = complement ? "1" : "0";
+        }
+        else if (kinds[node] == BitExpressionKind::Variable)
+        {
+            text = (complement ? "!" : "") + info.GetVarName(fanins0[node]) + "." + std::to_string(fanins1[node]);
+        }
+        else
+        {
+            std::string right_str = std::move(strings.back());
+            strings.pop_back();
+            std::string left_str = std::move(strings.back());
+            strings.pop_back();
+            if (fanin_mask)
+            {
+                text = left_str + "+" + right_str;
+            }
+            else
+            {
+                if (Priority(fanins0[node]) < 2)
+                {
+                    left_str = "(" + left_str + ")";
+                }
+                if (Priority(fanins1[node]) < 2)
+                {
+                    right_str = "(" + right_str + ")";
+                }
+                text = complement ? "!(" + left_str + "*" + right_str + ")" : left_str + "*" + right_str;
+            }
+        }
+        strings.push_back(std::move(text));
+    }
+    return strings.back();
+}
+
+bool AigBitExpressionEngine::Constant(uint32_t literal, const BitExpressionStates& input) const
+{
+    const uint64_t epoch = input.GetEpoch();
+    if (constant_epochs[literal >> 1] == epoch)
+    {
+        return constant_values[literal >> 1] != 0;
+    }
+    CollectStale(literal, constant_epochs, epoch);
+    for (size_t i = 0; i < cone.size(); ++i)
+    {
+        const uint32_t node = cone[i];
+        switch (kinds[node])
+        {
+        case BitExpressionKind::Const:
+            constant_values[node] = 1;
+            break;
+        case BitExpressionKind::Variable:
+            constant_values[node] = input.IsInputBitConstant(BitExpressionStates::GetBitIndex(fanins0[node], fanins1[node]));
+            break;
+        default:
+            constant_values[node] = constant_values[fanins0[node] >> 1] & constant_values[fanins1[node] >> 1];
+            break;
+        }
+        constant_epochs[node] = epoch;
+    }
+    return constant_values[literal >> 1] != 0;
+}
+
+bool AigBitExpressionEngine::Calculate(uint32_t literal, const BitExpressionStates& input) const
+{
+    const uint64_t epoch = input.GetEpoch();
+    if (calculate_epochs[literal >> 1] == epoch)
+    {
+        return (calculate_values[literal >> 1] ^ (literal & 1)) != 0;
+    }
+    CollectStale(literal, calculate_epochs, epoch);
+    for (size_t i = 0; i < cone.size(); ++i)
+    {
+        const uint32_t node = cone[i];
+        switch (kinds[node])
+        {
+        case BitExpressionKind::Const:
+            calculate_values[node] = 0;
+            break;
+        case BitExpressionKind::Variable:
+            calculate_values[node] = input.GetInputBitValue(BitExpressionStates::GetBitIndex(fanins0[node], fanins1[node]));
+            break;
+        default:
+        {
+            const uint32_t left = fanins0[node];
+            const uint32_t right = fanins1[node];
+            calculate_values[node] = (calculate_values[left >> 1] ^ (left & 1)) & (calculate_values[right >> 1] ^ (right & 1));
+            break;
+        }
+        }
+        calculate_epochs[node] = epoch;
+    }
+    return (calculate_values[literal >> 1] ^ (literal & 1)) != 0;
+}
+
+int AigBitExpressionEngine::Priority(uint32_t literal) const
+{
+    const uint32_t node = literal >> 1;
+    if (kinds[node] != BitExpressionKind::And)
+    {
+        return kinds[node] == BitExpressionKind::Variable && (literal & 1) ? 3 : 4;
+    }
+    if (IsOr(literal))
+    {
+        return 0;
+    }
+    return (literal & 1) ? 3 : 2;
+}
+
+uint32_t AigBitExpressionEngine::Optimize(uint32_t literal, const BitExpressionStates& input)
+{
+    MaybeCollect();
+    const uint64_t epoch = input.GetEpoch();
+    if (optimized_epochs[literal >> 1] == epoch)
+    {
+        return optimized[literal >> 1] ^ (literal & 1);
+    }
+    CollectStale(literal, optimized_epochs, epoch);
+    for (size_t i = 0; i < cone.size(); ++i)
+    {
+        const uint32_t node = cone[i];
+        uint32_t result = node << 1;
+        if (kinds[node] == BitExpressionKind::Variable)
+        {
+            const size_t bit_index = BitExpressionStates::GetBitIndex(fanins0[node], fanins1[node]);
+            if (input.IsInputBitConstant(bit_index))
+            {
+                result = input.GetInputBitValue(bit_index) ? 1 : 0;
+            }
+        }
+        else if (kinds[node] == BitExpressionKind::And)
+        {
+            const uint32_t left = fanins0[node];
+            const uint32_t right = fanins1[node];
+            result = MakeAnd(optimized[left >> 1] ^ (left & 1), optimized[right >> 1] ^ (right & 1));
+        }
+        optimized[node] = result;
+        optimized_epochs[node] = epoch;
+    }
+    return optimized[literal >> 1] ^ (literal & 1);
+}
+
+std::shared_ptr<IBitExpression> AigBitExpressionEngine::GetHandle(uint32_t literal)
+{
+    return BitExpressionTable::Intern<AigBitExpression>(BitExpressionKey(BitExpressionKind::Handle, GetEngineId(), literal), shared_from_this(), literal);
+}
+
+void AigBitExpressionEngine::Reference(uint32_t literal)
+{
+    ++references[literal >> 1];
+}
+
+void AigBitExpressionEngine::Release(uint32_t literal)
+{
+    --references[literal >> 1];
+}
+
+// Frees the nodes no handle reaches; optimized results may point at them, so those are dropped too
+void AigBitExpressionEngine::Collect()
+{
+    ++visit_epoch;
+    std::vector<uint32_t> stack;
+    for (uint32_t node = 0; node < kinds.size(); ++node)
+    {
+        if (references[node] && visit_epochs[node] != visit_epoch)
+        {
+            visit_epochs[node] = visit_epoch;
+            stack.push_back(node);
+        }
+        while (!stack.empty())
+        {
+            const uint32_t current = stack.back();
+            stack.pop_back();
+            if (kinds[current] != BitExpressionKind::And)
+            {
+                continue;
+            }
+            const uint32_t fanins[2] = { fanins0[current] >> 1, fanins1[current] >> 1 };
+            for (size_t j = 0; j < 2; ++j)
+            {
+                if (visit_epochs[fanins[j]] != visit_epoch)
+                {
+                    visit_epochs[fanins[j]] = visit_epoch;
+                    stack.push_back(fanins[j]);
+                }
+            }
+        }
+    }
+    for (uint32_t node = 1; node < kinds.size(); ++node)
+    {
+        if (visit_epochs[node] != visit_epoch && kinds[node] != BitExpressionKind::Handle)
+        {
+            unique_nodes.erase(BitExpressionKey(kinds[node], fanins0[node], fanins1[node]));
+            if (kinds[node] == BitExpressionKind::And)
+            {
+                --and_count;
+            }
+            kinds[node] = BitExpressionKind::Handle;
+            free_nodes.push_back(node);
+        }
+    }
+    std::fill(optimized_epochs.begin(), optimized_epochs.end(), 0);
+    collect_threshold = std::max<size_t>(1 << 16, 2 * GetNodeCount());
+}
+
+size_t AigBitExpressionEngine::GetNodeCount() const
+{
+    return kinds.size() - free_nodes.size();
+}
+
+size_t AigBitExpressionEngine::GetAndCount() const
+{
+    return and_count;
+}
+
+void AigBitExpressionEngine::WriteAiger(std::ostream& output, const std::vector<std::shared_ptr<IBitExpression> >& outputs, const BitExpressionStates& info)
+{
+    std::vector<std::shared_ptr<IBitExpression> > output_handles;
+    std::vector<uint32_t> output_literals;
+    for (size_t i = 0; i < outputs.size(); ++i)
+    {
+        output_handles.push_back(Import(outputs[i]));
+        output_literals.push_back(GetLiteral(output_handles.back()));
+    }
+
+    // Indices of freed nodes are reused, so gates are listed by a depth-first walk rather than by index
+    ++visit_epoch;
+    cone.clear();
+    for (size_t i = 0; i < output_literals.size(); ++i)
+    {
+        AppendCone(output_literals[i], nullptr, 0);
+    }
+    const std::vector<uint32_t> nodes(cone);
+
+    std::vector<uint32_t> inputs;
+    std::vector<uint32_t> gates;
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        if (kinds[nodes[i]] == BitExpressionKind::Variable)
+        {
+            inputs.push_back(nodes[i]);
+        }
+        else if (kinds[nodes[i]] == BitExpressionKind::And)
+        {
+            gates.push_back(nodes[i]);
+        }
+    }
+    std::unordered_map<uint32_t, uint32_t> aiger_variables;
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        aiger_variables[inputs[i]] = static_cast<uint32_t>(i + 1);
+    }
+    for (size_t i = 0; i < gates.size(); ++i)
+    {
+        aiger_variables[gates[i]] = static_cast<uint32_t>(inputs.size() + i + 1);
+    }
+    auto to_aiger = [&](uint32_t literal) -> uint32_t
+    {
+        const uint32_t node = literal >> 1;
+        return (node ? aiger_variables[node] << 1 : 0) | (literal & 1);
+    };
+
+    output << "aag " << inputs.size() + gates.size() << " " << inputs.size() << " 0 " << output_literals.size() << " " << gates.size() << "\n";
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        output << to_aiger(inputs[i] << 1) << "\n";
+    }
+    for (size_t i = 0; i < output_literals.size(); ++i)
+    {
+        output << to_aiger(output_literals[i]) << "\n";
+    }
+    for (size_t i = 0; i < gates.size(); ++i)
+    {
+        const uint32_t left = to_aiger(fanins0[gates[i]]);
+        const uint32_t right = to_aiger(fanins1[gates[i]]);
+        output << to_aiger(gates[i] << 1) << " " << std::max(left, right) << " " << std::min(left, right) << "\n";
+    }
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        output << "i" << i << " " << info.GetVarName(fanins0[inputs[i]]) << "." << fanins1[inputs[i]] << "\n";
+    }
+}
+
+uint32_t AigBitExpressionEngine::AddNode(BitExpressionKind kind, uint32_t fanin0, uint32_t fanin1)
+{
+    const BitExpressionKey key(kind, fanin0, fanin1);
+    auto found = unique_nodes.find(key);
+    if (found != unique_nodes.end())
+    {
+        return found->second;
+    }
+    uint32_t node;
+    if (!free_nodes.empty())
+    {
+        node = free_nodes.back();
+        free_nodes.pop_back();
+        kinds[node] = kind;
+        fanins0[node] = fanin0;
+        fanins1[node] = fanin1;
+        constant_epochs[node] = 0;
+        calculate_epochs[node] = 0;
+        optimized_epochs[node] = 0;
+    }
+    else
+    {
+        node = static_cast<uint32_t>(kinds.size());
+        kinds.push_back(kind);
+        fanins0.push_back(fanin0);
+        fanins1.push_back(fanin1);
+        references.push_back(0);
+        visit_epochs.push_back(0);
+        constant_epochs.push_back(0);
+        constant_values.push_back(0);
+        calculate_epochs.push_back(0);
+        calculate_values.push_back(0);
+        optimized_epochs.push_back(0);
+        optimized.push_back(0);
+    }
+    if (kind == BitExpressionKind::And)
+    {
+        ++and_count;
+    }
+    unique_nodes.insert(std::make_pair(key, node));
+    return node;
+}
+
+void AigBitExpressionEngine::Export(const std::vector<const IBitExpression*>& expressions, IBitExpressionSink& sink, std::vector<uint32_t>& slots) const
+{
+    ++visit_epoch;
+    cone.clear();
+    for (size_t i = 0; i < expressions.size(); ++i)
+    {
+        if (expressions[i]->GetEngine() != this)
+        {
+            throw std::runtime_error("AigBitExpressionEngine::Export(): expression belongs to another engine");
+        }
+        AppendCone(static_cast<const AigBitExpression*>(expressions[i])->GetLiteral(), nullptr, 0);
+    }
+    std::vector<uint32_t> node_slots(kinds.size());
+    auto literal_slot = [&](uint32_t literal) -> uint32_t
+    {
+        const uint32_t slot = node_slots[literal >> 1];
+        return (literal & 1) ? sink.Neg(slot) : slot;
+    };
+    for (size_t i = 0; i < cone.size(); ++i)
+    {
+        const uint32_t node = cone[i];
+        switch (kinds[node])
+        {
+        case BitExpressionKind::Const:
+            node_slots[node] = sink.Const(false);
+            break;
+        case BitExpressionKind::Variable:
+            node_slots[node] = sink.Variable(fanins0[node], fanins1[node]);
+            break;
+        default:
+            node_slots[node] = sink.And(literal_slot(fanins0[node]), literal_slot(fanins1[node]));
+            break;
+        }
+    }
+    slots.clear();
+    for (size_t i = 0; i < expressions.size(); ++i)
+    {
+        slots.push_back(literal_slot(static_cast<const AigBitExpression*>(expressions[i])->GetLiteral()));
+    }
+}
+
+uint32_t AigBitExpressionEngine::MakeVariable(uint32_t var_index, uint32_t bit_number)
+{
+    return AddNode(BitExpressionKind::Variable, var_index, bit_number) << 1;
+}
+
+uint32_t AigBitExpressionEngine::MakeAnd(uint32_t left, uint32_t right)
+{
+    if (left > right)
+    {
+        std::swap(left, right);
+    }
+    if (left == 0 || left == (right ^ 1))
+    {
+        return 0;
+    }
+    if (left == 1 || left == right)
+    {
+        return right;
+    }
+    return AddNode(BitExpressionKind::And, left, right) << 1;
+}
+
+uint32_t AigBitExpressionEngine::MakeOr(uint32_t left, uint32_t right)
+{
+    return MakeAnd(left ^ 1, right ^ 1) ^ 1;
+}
+
+uint32_t AigBitExpressionEngine::MakeXor(uint32_t left, uint32_t right)
+{
+    return MakeOr(MakeAnd(left, right ^ 1), MakeAnd(left ^ 1, right));
+}
+
+uint32_t AigBitExpressionEngine::GetLiteral(const std::shared_ptr<IBitExpression>& expression) const
+{
+    return static_cast<const AigBitExpression*>(expression.get())->GetLiteral();
+}
+
+bool AigBitExpressionEngine::IsOr(uint32_t literal) const
+{
+    const uint32_t node = literal >> 1;
+    return (literal & 1) && kinds[node] == BitExpressionKind::And && (fanins0[node] & 1) && (fanins1[node] & 1);
+}
+
+// Indices of freed nodes are reused, so a gate may precede its fanins; the cone is ordered by a
+// depth-first walk instead
+void AigBitExpressionEngine::CollectStale(uint32_t literal, const std::vector<uint64_t>& epochs, uint64_t epoch) const
+{
+    ++visit_epoch;
+    cone.clear();
+    AppendCone(literal, &epochs, epoch);
+}
+
+void AigBitExpressionEngine::AppendCone(uint32_t literal, const std::vector<uint64_t>* epochs, uint64_t epoch) const
+{
+    frames.push_back(std::make_pair(literal >> 1, false));
+    while (!frames.empty())
+    {
+        const uint32_t node = frames.back().first;
+        const bool expanded = frames.back().second;
+        frames.pop_back();
+        if (expanded)
+        {
+            cone.push_back(node);
+            continue;
+        }
+        if ((epochs && (*epochs)[node] == epoch) || visit_epochs[node] == visit_epoch)
+        {
+            continue;
+        }
+        visit_epochs[node] = visit_epoch;
+        frames.push_back(std::make_pair(node, true));
+        if (kinds[node] == BitExpressionKind::And)
+        {
+            frames.push_back(std::make_pair(fanins0[node] >> 1, false));
+            frames.push_back(std::make_pair(fanins1[node] >> 1, false));
+        }
+    }
+}
+
+void AigBitExpressionEngine::MaybeCollect()
+{
+    if (GetNodeCount() > collect_threshold)
+    {
+        Collect();
+    }
+}
+
+AigBitExpression::AigBitExpression(const std::shared_ptr<AigBitExpressionEngine>& engine_, uint32_t literal_)
+    : IBitExpression(BitExpressionKey(BitExpressionKind::Handle, engine_->GetEngineId(), literal_)), engine(engine_), literal(literal_)
+{
+    engine->Reference(literal);
+}
+
+AigBitExpression::~AigBitExpression()
+{
+    engine->Release(literal);
+}
+
+std::string AigBitExpression::ToString(const BitExpressionStates& info) const
+{
+    return engine->ToString(literal, info);
+}
+
+bool AigBitExpression::Constant(const BitExpressionStates& input) const
+{
+    return engine->Constant(literal, input);
+}
+
+bool AigBitExpression::Calculate(const BitExpressionStates& input) const
+{
+    return engine->Calculate(literal, input);
+}
+
+int AigBitExpression::Priority() const
+{
+    return engine->Priority(literal);
+}
+
+void AigBitExpression::Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) const
+{
+    const uint32_t optimized_literal = engine->Optimize(literal, input);
+    if (optimized_literal != literal)
+    {
+        output = engine->GetHandle(optimized_literal);
+    }
+}
+
+IBitExpressionEngine* AigBitExpression::GetEngine() const
+{
+    return engine.get();
+}
+
+uint32_t AigBitExpression::GetLiteral() const
+{
+    return literal;
+}
@@ -0,0 +1,116 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "BitExpressions.h"
+
+// And-Inverter Graph: every gate is an AND, a literal is node * 2 + complement
+class AigBitExpressionEngine : public IBitExpressionEngine, public std::enable_shared_from_this<AigBitExpressionEngine>
+{
+public:
+    AigBitExpressionEngine();
+
+    std::shared_ptr<IBitExpression> Const(bool value);
+    std::shared_ptr<IBitExpression> Variable(size_t var_index, size_t bit_number);
+    std::shared_ptr<IBitExpression> Neg(const std::shared_ptr<IBitExpression>& argument);
+    std::shared_ptr<IBitExpression> Or(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
+    std::shared_ptr<IBitExpression> And(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
+    std::shared_ptr<IBitExpression> Xor(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
+
+    std::string ToString(uint32_t literal, const BitExpressionStates& info) const;
+    bool Constant(uint32_t literal, const BitExpressionStates& input) const;
+    bool Calculate(uint32_t literal, const BitExpressionStates& input) const;
+    int Priority(uint32_t literal) const;
+    uint32_t Optimize(uint32_t literal, const BitExpressionStates& input);
+    std::shared_ptr<IBitExpression> GetHandle(uint32_t literal);
+    void Reference(uint32_t literal);
+    void Release(uint32_t literal);
+    void Collect();
+    size_t GetNodeCount() const;
+    size_t GetAndCount() const;
+    void WriteAiger(std::ostream& output, const std::vector<std::shared_ptr<IBitExpression> >& outputs, const BitExpressionStates& info);
+    void Export(const std::vector<const IBitExpression*>& expressions, IBitExpressionSink& sink, std::vector<uint32_t>& slots) const;
+private:
+    // ToString expands shared nodes, so operands past this many written nodes are elided as "..."
+    static const size_t max_string_nodes = 1 << 12;
+
+    uint32_t AddNode(BitExpressionKind kind, uint32_t fanin0, uint32_t fanin1);
+    uint32_t MakeVariable(uint32_t var_index, uint32_t bit_number);
+    uint32_t MakeAnd(uint32_t left, uint32_t right);
+    uint32_t MakeOr(uint32_t left, uint32_t right);
+    uint32_t MakeXor(uint32_t left, uint32_t right);
+    uint32_t GetLiteral(const std::shared_ptr<IBitExpression>& expression) const;
+    bool IsOr(uint32_t literal) const;
+    // Lists the nodes under literal not yet stamped with epoch, fanins before the gates using them
+    void CollectStale(uint32_t literal, const std::vector<uint64_t>& epochs, uint64_t epoch) const;
+    // Appends the nodes under literal not yet visited in visit_epoch or stamped in epochs to the cone
+    void AppendCone(uint32_t literal, const std::vector<uint64_t>* epochs, uint64_t epoch) const;
+    void MaybeCollect();
+
+    // Freed nodes keep the Handle kind until they are reused
+    std::vector<BitExpressionKind> kinds;
+    std::vector<uint32_t> fanins0;
+    std::vector<uint32_t> fanins1;
+    std::vector<uint32_t> references;
+    std::vector<uint32_t> free_nodes;
+    std::unordered_map<BitExpressionKey, uint32_t, BitExpressionKeyHash> unique_nodes;
+    size_t and_count;
+    size_t collect_threshold;
+
+    mutable std::vector<uint32_t> cone;
+    mutable std::vector<std::pair<uint32_t, bool> > frames;
+    mutable std::vector<uint64_t> visit_epochs;
+    mutable uint64_t visit_epoch;
+    // Node results, without the complement of the literal, are stamped with the epoch of the state
+    // they were computed for
+    mutable std::vector<uint64_t> constant_epochs;
+    mutable std::vector<uint8_t> constant_values;
+    mutable std::vector<uint64_t> calculate_epochs;
+    mutable std::vector<uint8_t> calculate_values;
+    std::vector<uint64_t> optimized_epochs;
+    std::vector<uint32_t> optimized;
+};
+
+struct AigBitExpression : public IBitExpression
+{
+    AigBitExpression(const std::shared_ptr<AigBitExpressionEngine>& engine, uint32_t literal);
+    ~AigBitExpression();
+    std::string ToString(const BitExpressionStates& info) const;
+    bool Constant(const BitExpressionStates& input) const;
+    bool Calculate(const BitExpressionStates& input) const;
+    int Priority() const;
+    void Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) const;
+    IBitExpressionEngine* GetEngine() const;
+    uint32_t GetLiteral() const;
+private:
+    std::shared_ptr<AigBitExpressionEngine> engine;
+    uint32_t literal;
+};
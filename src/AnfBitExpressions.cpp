@@ -0,0 +1,519 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "AnfBitExpressions.h"
+
+size_t AnfVectorHash::operator()(const std::vector<uint32_t>& items) const
+{
+    uint64_t result = items.size();
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        result = (result ^ items[i]) * 0x9E3779B97F4A7C15ull;
+    }
+    return static_cast<size_t>(result ^ (result >> 32));
+}
+
+AnfBitExpressionEngine::AnfBitExpressionEngine(size_t max_monomials_) : max_monomials(max_monomials_), collect_threshold(1 << 16)
+{
+    AddMonomial(std::vector<uint32_t>());
+    std::vector<uint32_t> zero;
+    Reference(AddPolynomial(zero));
+    std::vector<uint32_t> one(1, 0);
+    Reference(AddPolynomial(one));
+}
+
+std::shared_ptr<IBitExpression> AnfBitExpressionEngine::Const(bool value)
+{
+    return GetHandle(value ? 1 : 0);
+}
+
+std::shared_ptr<IBitExpression> AnfBitExpressionEngine::Variable(size_t var_index, size_t bit_number)
+{
+    MaybeCollect();
+    const uint32_t bit_index = static_cast<uint32_t>(BitExpressionStates::GetBitIndex(var_index, bit_number));
+    std::vector<uint32_t> monomial_ids(1, AddMonomial(std::vector<uint32_t>(1, bit_index)));
+    return GetHandle(AddPolynomial(monomial_ids));
+}
+
+std::shared_ptr<IBitExpression> AnfBitExpressionEngine::Neg(const std::shared_ptr<IBitExpression>& argument)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> argument_handle = Import(argument);
+    return GetHandle(MakeXor(GetPolynomial(argument_handle), 1));
+}
+
+std::shared_ptr<IBitExpression> AnfBitExpressionEngine::Or(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> left_handle = Import(left);
+    const std::shared_ptr<IBitExpression> right_handle = Import(right);
+    const uint32_t left_polynomial = GetPolynomial(left_handle);
+    const uint32_t right_polynomial = GetPolynomial(right_handle);
+    return GetHandle(MakeXor(MakeXor(left_polynomial, right_polynomial), MakeAnd(left_polynomial, right_polynomial)));
+}
+
+std::shared_ptr<IBitExpression> AnfBitExpressionEngine::And(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> left_handle = Import(left);
+    const std::shared_ptr<IBitExpression> right_handle = Import(right);
+    return GetHandle(MakeAnd(GetPolynomial(left_handle), GetPolynomial(right_handle)));
+}
+
+std::shared_ptr<IBitExpression> AnfBitExpressionEngine::Xor(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> left_handle = Import(left);
+    const std::shared_ptr<IBitExpression> right_handle = Import(right);
+    return GetHandle(MakeXor(GetPolynomial(left_handle), GetPolynomial(right_handle)));
+}
+
+std::string AnfBitExpressionEngine::ToString(uint32_t polynomial, const BitExpressionStates& info) const
+{
+    const std::vector<uint32_t>& monomial_ids = polynomials[polynomial];
+    if (monomial_ids.empty())
+    {
+        return "0";
+    }
+    std::string result;
+    for (size_t i = 0; i < monomial_ids.size(); ++i)
+    {
+        const std::vector<uint32_t>& bit_indexes = monomials[monomial_ids[i]];
+        if (i)
+        {
+            result += "^";
+        }
+        if (bit_indexes.empty())
+        {
+            result += "1";
+        }
+        for (size_t j = 0; j < bit_indexes.size(); ++j)
+        {
+            if (j)
+            {
+                result += "*";
+            }
+            const size_t var_index = bit_indexes[j] / BitExpressionStates::max_bit_count;
+            const size_t bit_number = bit_indexes[j] % BitExpressionStates::max_bit_count;
+            result += info.GetVarName(var_index) + "." + std::to_string(bit_number);
+        }
+    }
+    return result;
+}
+
+bool AnfBitExpressionEngine::Constant(uint32_t polynomial, const BitExpressionStates& input) const
+{
+    const std::vector<uint32_t>& monomial_ids = polynomials[polynomial];
+    for (size_t i = 0; i < monomial_ids.size(); ++i)
+    {
+        const std::vector<uint32_t>& bit_indexes = monomials[monomial_ids[i]];
+        for (size_t j = 0; j < bit_indexes.size(); ++j)
+        {
+            if (!input.IsInputBitConstant(bit_indexes[j]))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool AnfBitExpressionEngine::Calculate(uint32_t polynomial, const BitExpressionStates& input) const
+{
+    bool result = false;
+    const std::vector<uint32_t>& monomial_ids = polynomials[polynomial];
+    for (size_t i = 0; i < monomial_ids.size(); ++i)
+    {
+        const std::vector<uint32_t>& bit_indexes = monomials[monomial_ids[i]];
+        bool monomial_value = true;
+        for (size_t j = 0; j < bit_indexes.size() && monomial_value; ++j)
+        {
+            monomial_value = input.GetInputBitValue(bit_indexes[j]);
+        }
+        result ^= monomial_value;
+    }
+    return result;
+}
+
+int AnfBitExpressionEngine::Priority(uint32_t polynomial) const
+{
+    const std::vector<uint32_t>& monomial_ids = polynomials[polynomial];
+    if (monomial_ids.size() > 1)
+    {
+        return 1;
+    }
+    if (monomial_ids.size() == 1 && monomials[monomial_ids[0]].size() > 1)
+    {
+        return 2;
+    }
+    return 4;
+}
+
+uint32_t AnfBitExpressionEngine::Optimize(uint32_t polynomial, const BitExpressionStates& input)
+{
+    MaybeCollect();
+    const std::vector<uint32_t> monomial_ids = polynomials[polynomial];
+    std::vector<uint32_t> new_monomial_ids;
+    std::vector<uint32_t> free_bit_indexes;
+    bool changed = false;
+    for (size_t i = 0; i < monomial_ids.size(); ++i)
+    {
+        const std::vector<uint32_t>& bit_indexes = monomials[monomial_ids[i]];
+        free_bit_indexes.clear();
+        bool monomial_value = true;
+        for (size_t j = 0; j < bit_indexes.size() && monomial_value; ++j)
+        {
+            if (!input.IsInputBitConstant(bit_indexes[j]))
+            {
+                free_bit_indexes.push_back(bit_indexes[j]);
+            }
+            else
+            {
+                monomial_value = input.GetInputBitValue(bit_indexes[j]);
+            }
+        }
+        if (!monomial_value)
+        {
+            changed = true;
+        }
+        else if (free_bit_indexes.size() != bit_indexes.size())
+        {
+            changed = true;
+            new_monomial_ids.push_back(AddMonomial(free_bit_indexes));
+        }
+        else
+        {
+            new_monomial_ids.push_back(monomial_ids[i]);
+        }
+    }
+    return changed ? AddPolynomial(new_monomial_ids) : polynomial;
+}
+
+std::shared_ptr<IBitExpression> AnfBitExpressionEngine::GetHandle(uint32_t polynomial)
+{
+    return BitExpressionTable::Intern<AnfBitExpression>(BitExpressionKey(BitExpressionKind::Handle, GetEngineId(), polynomial), shared_from_this(), polynomial);
+}
+
+void AnfBitExpressionEngine::Reference(uint32_t polynomial)
+{
+    ++references[polynomial];
+}
+
+void AnfBitExpressionEngine::Release(uint32_t polynomial)
+{
+    --references[polynomial];
+}
+
+// Frees the polynomials no handle references and the monomials only they use; computed results may
+// name freed polynomials, so the cache is dropped too
+void AnfBitExpressionEngine::Collect()
+{
+    std::vector<bool> live_monomials(monomials.size(), false);
+    live_monomials[0] = true;
+    for (auto found = unique_polynomials.begin(); found != unique_polynomials.end();)
+    {
+        const uint32_t polynomial = found->second;
+        if (!references[polynomial])
+        {
+            std::vector<uint32_t>().swap(polynomials[polynomial]);
+            free_polynomials.push_back(polynomial);
+            found = unique_polynomials.erase(found);
+            continue;
+        }
+        const std::vector<uint32_t>& monomial_ids = polynomials[polynomial];
+        for (size_t i = 0; i < monomial_ids.size(); ++i)
+        {
+            live_monomials[monomial_ids[i]] = true;
+        }
+        ++found;
+    }
+    for (auto found = unique_monomials.begin(); found != unique_monomials.end();)
+    {
+        const uint32_t monomial = found->second;
+        if (!live_monomials[monomial])
+        {
+            std::vector<uint32_t>().swap(monomials[monomial]);
+            free_monomials.push_back(monomial);
+            found = unique_monomials.erase(found);
+            continue;
+        }
+        ++found;
+    }
+    computed.clear();
+    collect_threshold = std::max<size_t>(1 << 16, 2 * GetPolynomialCount());
+}
+
+size_t AnfBitExpressionEngine::GetPolynomialCount() const
+{
+    return unique_polynomials.size();
+}
+
+size_t AnfBitExpressionEngine::GetMonomialCount(uint32_t polynomial) const
+{
+    return polynomials[polynomial].size();
+}
+
+size_t AnfBitExpressionEngine::GetDegree(uint32_t polynomial) const
+{
+    size_t result = 0;
+    const std::vector<uint32_t>& monomial_ids = polynomials[polynomial];
+    for (size_t i = 0; i < monomial_ids.size(); ++i)
+    {
+        result = std::max(result, monomials[monomial_ids[i]].size());
+    }
+    return result;
+}
+
+// Monomials shared between polynomials are emitted once; the constant monomial becomes true
+void AnfBitExpressionEngine::Export(const std::vector<const IBitExpression*>& expressions, IBitExpressionSink& sink, std::vector<uint32_t>& slots) const
+{
+    std::unordered_map<uint32_t, uint32_t> monomial_slots;
+    slots.clear();
+    for (size_t i = 0; i < expressions.size(); ++i)
+    {
+        if (expressions[i]->GetEngine() != this)
+        {
+            throw std::runtime_error("AnfBitExpressionEngine::Export(): expression belongs to another engine");
+        }
+        const std::vector<uint32_t>& monomial_ids = polynomials[static_cast<const AnfBitExpression*>(expressions[i])->GetPolynomial()];
+        uint32_t result = sink.Const(false);
+        for (size_t j = 0; j < monomial_ids.size(); ++j)
+        {
+            auto found = monomial_slots.find(monomial_ids[j]);
+            if (found == monomial_slots.end())
+            {
+                const std::vector<uint32_t>& bit_indexes = monomials[monomial_ids[j]];
+                uint32_t product = sink.Const(true);
+                for (size_t k = 0; k < bit_indexes.size(); ++k)
+                {
+                    const size_t bit_index = bit_indexes[k];
+                    product = sink.And(product, sink.Variable(bit_index / BitExpressionStates::max_bit_count, bit_index % BitExpressionStates::max_bit_count));
+                }
+                found = monomial_slots.insert(std::make_pair(monomial_ids[j], product)).first;
+            }
+            result = sink.Xor(result, found->second);
+        }
+        slots.push_back(result);
+    }
+}
+
+uint32_t AnfBitExpressionEngine::AddMonomial(const std::vector<uint32_t>& bit_indexes)
+{
+    auto found = unique_monomials.find(bit_indexes);
+    if (found != unique_monomials.end())
+    {
+        return found->second;
+    }
+    uint32_t monomial;
+    if (!free_monomials.empty())
+    {
+        monomial = free_monomials.back();
+        free_monomials.pop_back();
+        monomials[monomial] = bit_indexes;
+    }
+    else
+    {
+        monomial = static_cast<uint32_t>(monomials.size());
+        monomials.push_back(bit_indexes);
+    }
+    unique_monomials.insert(std::make_pair(bit_indexes, monomial));
+    return monomial;
+}
+
+uint32_t AnfBitExpressionEngine::AddPolynomial(std::vector<uint32_t>& monomial_ids)
+{
+    // x ^ x = 0: sort the monomials and drop them in equal pairs
+    std::sort(monomial_ids.begin(), monomial_ids.end());
+    size_t count = 0;
+    for (size_t i = 0; i < monomial_ids.size(); ++i)
+    {
+        if (i + 1 < monomial_ids.size() && monomial_ids[i] == monomial_ids[i + 1])
+        {
+            ++i;
+        }
+        else
+        {
+            monomial_ids[count++] = monomial_ids[i];
+        }
+    }
+    monomial_ids.resize(count);
+    if (count > max_monomials)
+        throw std::runtime_error("AnfBitExpressionEngine::AddPolynomial(): polynomial has too many monomials");
+
+    auto found = unique_polynomials.find(monomial_ids);
+    if (found != unique_polynomials.end())
+    {
+        return found->second;
+    }
+    uint32_t polynomial;
+    if (!free_polynomials.empty())
+    {
+        polynomial = free_polynomials.back();
+        free_polynomials.pop_back();
+        polynomials[polynomial] = monomial_ids;
+    }
+    else
+    {
+        polynomial = static_cast<uint32_t>(polynomials.size());
+        polynomials.push_back(monomial_ids);
+        references.push_back(0);
+    }
+    unique_polynomials.insert(std::make_pair(monomial_ids, polynomial));
+    return polynomial;
+}
+
+uint32_t AnfBitExpressionEngine::MakeXor(uint32_t left, uint32_t right)
+{
+    if (left == 0)
+    {
+        return right;
+    }
+    if (right == 0)
+    {
+        return left;
+    }
+    if (left == right)
+    {
+        return 0;
+    }
+    const BitExpressionKey key(BitExpressionKind::Xor, std::min(left, right), std::max(left, right));
+    auto found = computed.find(key);
+    if (found != computed.end())
+    {
+        return found->second;
+    }
+    std::vector<uint32_t> monomial_ids(polynomials[left]);
+    monomial_ids.insert(monomial_ids.end(), polynomials[right].begin(), polynomials[right].end());
+    const uint32_t result = AddPolynomial(monomial_ids);
+    computed.insert(std::make_pair(key, result));
+    return result;
+}
+
+uint32_t AnfBitExpressionEngine::MakeAnd(uint32_t left, uint32_t right)
+{
+    if (left == 0 || right == 0)
+    {
+        return 0;
+    }
+    if (left == 1 || left == right)
+    {
+        return right;
+    }
+    if (right == 1)
+    {
+        return left;
+    }
+    const BitExpressionKey key(BitExpressionKind::And, std::min(left, right), std::max(left, right));
+    auto found = computed.find(key);
+    if (found != computed.end())
+    {
+        return found->second;
+    }
+    const std::vector<uint32_t> left_monomials(polynomials[left]);
+    const std::vector<uint32_t> right_monomials(polynomials[right]);
+    if (left_monomials.size() * right_monomials.size() > max_monomials * 16)
+        throw std::runtime_error("AnfBitExpressionEngine::MakeAnd(): product has too many monomials");
+
+    std::vector<uint32_t> monomial_ids;
+    monomial_ids.reserve(left_monomials.size() * right_monomials.size());
+    std::vector<uint32_t> bit_indexes;
+    for (size_t i = 0; i < left_monomials.size(); ++i)
+    {
+        for (size_t j = 0; j < right_monomials.size(); ++j)
+        {
+            const std::vector<uint32_t>& left_bits = monomials[left_monomials[i]];
+            const std::vector<uint32_t>& right_bits = monomials[right_monomials[j]];
+            bit_indexes.clear();
+            std::set_union(left_bits.begin(), left_bits.end(), right_bits.begin(), right_bits.end(), std::back_inserter(bit_indexes));
+            monomial_ids.push_back(AddMonomial(bit_indexes));
+        }
+    }
+    const uint32_t result = AddPolynomial(monomial_ids);
+    computed.insert(std::make_pair(key, result));
+    return result;
+}
+
+uint32_t AnfBitExpressionEngine::GetPolynomial(const std::shared_ptr<IBitExpression>& expression)
+{
+    return static_cast<const AnfBitExpression*>(Import(expression).get())->GetPolynomial();
+}
+
+// The computed cache only grows between collections, so it also triggers one
+void AnfBitExpressionEngine::MaybeCollect()
+{
+    if (GetPolynomialCount() > collect_threshold || computed.size() > collect_threshold)
+    {
+        Collect();
+    }
+}
+
+AnfBitExpression::AnfBitExpression(const std::shared_ptr<AnfBitExpressionEngine>& engine_, uint32_t polynomial_)
+    : IBitExpression(BitExpressionKey(BitExpressionKind::Handle, engine_->GetEngineId(), polynomial_)), engine(engine_), polynomial(polynomial_)
+{
+    engine->Reference(polynomial);
+}
+
+AnfBitExpression::~AnfBitExpression()
+{
+    engine->Release(polynomial);
+}
+
+std::string AnfBitExpression::ToString(const BitExpressionStates& info) const
+{
+    return engine->ToString(polynomial, info);
+}
+
+bool AnfBitExpression::Constant(const BitExpressionStates& input) const
+{
+    return engine->Constant(polynomial, input);
+}
+
+bool AnfBitExpression::Calculate(const BitExpressionStates& input) const
+{
+    return engine->Calculate(polynomial, input);
+}
+
+int AnfBitExpression::Priority() const
+{
+    return engine->Priority(polynomial);
+}
+
+void AnfBitExpression::Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) const
+{
+    const uint32_t optimized_polynomial = engine->Optimize(polynomial, input);
+    if (optimized_polynomial != polynomial)
+    {
+        output = engine->GetHandle(optimized_polynomial);
+    }
+}
+
+IBitExpressionEngine* AnfBitExpression::GetEngine() const
+{
+    return engine.get();
+}
+
+uint32_t AnfBitExpression::GetPolynomial() const
+{
+    return polynomial;
+}
@@ -0,0 +1,99 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "BitExpressions.h"
+
+struct AnfVectorHash
+{
+    size_t operator()(const std::vector<uint32_t>& items) const;
+};
+
+// Algebraic Normal Form: a polynomial is an XOR of monomials, a monomial is an AND of input bits
+class AnfBitExpressionEngine : public IBitExpressionEngine, public std::enable_shared_from_this<AnfBitExpressionEngine>
+{
+public:
+    explicit AnfBitExpressionEngine(size_t max_monomials = 1 << 16);
+
+    std::shared_ptr<IBitExpression> Const(bool value);
+    std::shared_ptr<IBitExpression> Variable(size_t var_index, size_t bit_number);
+    std::shared_ptr<IBitExpression> Neg(const std::shared_ptr<IBitExpression>& argument);
+    std::shared_ptr<IBitExpression> Or(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
+    std::shared_ptr<IBitExpression> And(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
+    std::shared_ptr<IBitExpression> Xor(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
+
+    std::string ToString(uint32_t polynomial, const BitExpressionStates& info) const;
+    bool Constant(uint32_t polynomial, const BitExpressionStates& input) const;
+    bool Calculate(uint32_t polynomial, const BitExpressionStates& input) const;
+    int Priority(uint32_t polynomial) const;
+    uint32_t Optimize(uint32_t polynomial, const BitExpressionStates& input);
+    std::shared_ptr<IBitExpression> GetHandle(uint32_t polynomial);
+    size_t GetMonomialCount(uint32_t polynomial) const;
+    size_t GetDegree(uint32_t polynomial) const;
+    void Reference(uint32_t polynomial);
+    void Release(uint32_t polynomial);
+    void Collect();
+    size_t GetPolynomialCount() const;
+    void Export(const std::vector<const IBitExpression*>& expressions, IBitExpressionSink& sink, std::vector<uint32_t>& slots) const;
+private:
+    uint32_t AddMonomial(const std::vector<uint32_t>& bit_indexes);
+    uint32_t AddPolynomial(std::vector<uint32_t>& monomial_ids);
+    uint32_t MakeXor(uint32_t left, uint32_t right);
+    uint32_t MakeAnd(uint32_t left, uint32_t right);
+    uint32_t GetPolynomial(const std::shared_ptr<IBitExpression>& expression);
+    void MaybeCollect();
+
+    size_t max_monomials;
+    // Freed monomials and polynomials are empty and out of the unique tables until they are reused
+    std::vector<std::vector<uint32_t> > monomials;
+    std::unordered_map<std::vector<uint32_t>, uint32_t, AnfVectorHash> unique_monomials;
+    std::vector<uint32_t> free_monomials;
+    std::vector<std::vector<uint32_t> > polynomials;
+    std::unordered_map<std::vector<uint32_t>, uint32_t, AnfVectorHash> unique_polynomials;
+    std::vector<uint32_t> references;
+    std::vector<uint32_t> free_polynomials;
+    std::unordered_map<BitExpressionKey, uint32_t, BitExpressionKeyHash> computed;
+    size_t collect_threshold;
+};
+
+struct AnfBitExpression : public IBitExpression
+{
+    AnfBitExpression(const std::shared_ptr<AnfBitExpressionEngine>& engine, uint32_t polynomial);
+    ~AnfBitExpression();
+    std::string ToString(const BitExpressionStates& info) const;
+    bool Constant(const BitExpressionStates& input) const;
+    bool Calculate(const BitExpressionStates& input) const;
+    int Priority() const;
+    void Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) const;
+    IBitExpressionEngine* GetEngine() const;
+    uint32_t GetPolynomial() const;
+private:
+    std::shared_ptr<AnfBitExpressionEngine> engine;
+    uint32_t polynomial;
+};
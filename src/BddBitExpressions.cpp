@@ -0,0 +1,651 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#include "BddBitExpressions.h"
+
+const uint32_t BddBitExpressionEngine::terminal_level;
+const size_t BddBitExpressionEngine::cache_size;
+
+IBddVariableOrder::~IBddVariableOrder()
+{
+}
+
+uint32_t NaturalBddVariableOrder::GetLevel(size_t var_index, size_t bit_number) const
+{
+    return static_cast<uint32_t>(BitExpressionStates::GetBitIndex(var_index, bit_number));
+}
+
+uint32_t InterleavedBddVariableOrder::GetLevel(size_t var_index, size_t bit_number) const
+{
+    if (var_index > 0xFFFF)
+        throw std::runtime_error("InterleavedBddVariableOrder::GetLevel(): too many variables");
+
+    return static_cast<uint32_t>(bit_number << 16 | var_index);
+}
+
+BddNodeKey::BddNodeKey(uint32_t level_, uint32_t low_, uint32_t high_) : level(level_), low(low_), high(high_)
+{
+}
+
+bool BddNodeKey::operator==(const BddNodeKey& other) const
+{
+    return level == other.level && low == other.low && high == other.high;
+}
+
+size_t BddNodeKeyHash::operator()(const BddNodeKey& key) const
+{
+    uint64_t result = static_cast<uint64_t>(key.low) << 32 | key.high;
+    result = (result ^ key.level) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(result ^ (result >> 32));
+}
+
+BddBitExpressionEngine::BddBitExpressionEngine(const std::shared_ptr<IBddVariableOrder>& order_)
+    : order(order_), collect_threshold(1 << 16), visit_epoch(0)
+{
+    for (uint32_t terminal = 0; terminal < 2; ++terminal)
+    {
+        levels.push_back(terminal_level);
+        bit_indexes.push_back(0);
+        lows.push_back(terminal);
+        highs.push_back(terminal);
+        references.push_back(1);
+        visit_epochs.push_back(0);
+        constant_values.push_back(static_cast<uint8_t>(terminal));
+        restricted.push_back(terminal);
+        probabilities.push_back(terminal);
+    }
+    CacheEntry empty_entry = { BitExpressionKind::Handle, 0, 0, 0 };
+    cache.resize(cache_size, empty_entry);
+}
+
+std::shared_ptr<IBitExpression> BddBitExpressionEngine::Const(bool value)
+{
+    return GetHandle(value ? 1 : 0);
+}
+
+std::shared_ptr<IBitExpression> BddBitExpressionEngine::Variable(size_t var_index, size_t bit_number)
+{
+    MaybeCollect();
+    const uint32_t level = order->GetLevel(var_index, bit_number);
+    const uint32_t bit_index = static_cast<uint32_t>(BitExpressionStates::GetBitIndex(var_index, bit_number));
+    auto found = level_bits.find(level);
+    if (found == level_bits.end())
+    {
+        level_bits.insert(std::make_pair(level, bit_index));
+    }
+    else if (found->second != bit_index)
+        throw std::runtime_error("BddBitExpressionEngine::Variable(): two input bits share one level");
+
+    return GetHandle(MakeNode(level, bit_index, 0, 1));
+}
+
+std::shared_ptr<IBitExpression> BddBitExpressionEngine::Neg(const std::shared_ptr<IBitExpression>& argument)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> argument_handle = Import(argument);
+    return GetHandle(Not(GetNode(argument_handle)));
+}
+
+std::shared_ptr<IBitExpression> BddBitExpressionEngine::Or(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> left_handle = Import(left);
+    const std::shared_ptr<IBitExpression> right_handle = Import(right);
+    return GetHandle(Apply(BitExpressionKind::Or, GetNode(left_handle), GetNode(right_handle)));
+}
+
+std::shared_ptr<IBitExpression> BddBitExpressionEngine::And(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> left_handle = Import(left);
+    const std::shared_ptr<IBitExpression> right_handle = Import(right);
+    return GetHandle(Apply(BitExpressionKind::And, GetNode(left_handle), GetNode(right_handle)));
+}
+
+std::shared_ptr<IBitExpression> BddBitExpressionEngine::Xor(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> left_handle = Import(left);
+    const std::shared_ptr<IBitExpression> right_handle = Import(right);
+    return GetHandle(Apply(BitExpressionKind::Xor, GetNode(left_handle), GetNode(right_handle)));
+}
+
+// Shared subgraphs are printed again at every use, so operands past max_string_nodes written nodes
+// are elided as "..."
+std::string BddBitExpressionEngine::ToString(uint32_t node, const BitExpressionStates& info) const
+{
+    struct Frame
+    {
+        uint32_t node;
+        uint32_t next;
+    };
+    std::vector<Frame> frames;
+    std::vector<std::string> strings;
+    size_t written_nodes = 1;
+    Frame root = { node, 0 };
+    frames.push_back(root);
+    while (!frames.empty())
+    {
+        const uint32_t current = frames.back().node;
+        const uint32_t low = current < 2 ? 0 : lows[current];
+        const uint32_t high = current < 2 ? 0 : highs[current];
+        const uint32_t count = (high > 1 ? 1 : 0) + (low > 1 ? 1 : 0);
+        if (frames.back().next < count)
+        {
+            Frame frame = { frames.back().next++ == 0 && high > 1 ? high : low, 0 };
+            if (written_nodes >= max_string_nodes)
+            {
+                strings.push_back("...");
+                continue;
+            }
+            ++written_nodes;
+            frames.push_back(frame);
+            continue;
+        }
+        frames.pop_back();
+        if (current < 2)
+        {
+            strings.push_back(current ? "1" : "0");
+            continue;
+        }
+        std::string low_str;
+        if (low > 1)
+        {
+            low_str = std::move(strings.back());
+            strings.pop_back();
+            if (Priority(low) < 2)
+            {
+                low_str = "(" + low_str + ")";
+            }
+        }
+        std::string high_str;
+        if (high > 1)
+        {
+            high_str = std::move(strings.back());
+            strings.pop_back();
+            if (Priority(high) < 2)
+            {
+                high_str = "(" + high_str + ")";
+            }
+        }
+        const uint32_t bit_index = bit_indexes[current];
+        const std::string variable = info.GetVarName(bit_index / BitExpressionStates::max_bit_count) + "." + std::to_string(bit_index % BitExpressionStates::max_bit_count);
+        std::string text;
+        if (low == 0 && high == 1)
+        {
+            text = variable;
+        }
+        else if (low == 1 && high == 0)
+        {
+            text = "!" + variable;
+        }
+        else if (low == 0)
+        {
+            text = variable + "*" + high_str;
+        }
+        else if (high == 0)
+        {
+            text = "!" + variable + "*" + low_str;
+        }
+        else if (low == 1)
+        {
+            text = "!" + variable + "+" + high_str;
+        }
+        else if (high == 1)
+        {
+            text = variable + "+" + low_str;
+        }
+        else
+        {
+            text = variable + "*" + high_str + "+!" + variable + "*" + low_str;
+        }
+        strings.push_back(std::move(text));
+    }
+    return strings.back();
+}
+
+bool BddBitExpressionEngine::Constant(uint32_t node, const BitExpressionStates& input) const
+{
+    ++visit_epoch;
+    return ConstantValue(node, input) != 2;
+}
+
+bool BddBitExpressionEngine::Calculate(uint32_t node, const BitExpressionStates& input) const
+{
+    while (node > 1)
+    {
+        node = input.GetInputBitValue(bit_indexes[node]) ? highs[node] : lows[node];
+    }
+    return node != 0;
+}
+
+int BddBitExpressionEngine::Priority(uint32_t node) const
+{
+    if (node < 2 || (lows[node] == 0 && highs[node] == 1))
+    {
+        return 4;
+    }
+    if (lows[node] == 1 && highs[node] == 0)
+    {
+        return 3;
+    }
+    if (lows[node] == 0 || highs[node] == 0)
+    {
+        return 2;
+    }
+    return 0;
+}
+
+uint32_t BddBitExpressionEngine::Optimize(uint32_t node, const BitExpressionStates& input)
+{
+    MaybeCollect();
+    ++visit_epoch;
+    return Restrict(node, input);
+}
+
+double BddBitExpressionEngine::CountModels(const std::shared_ptr<IBitExpression>& expression, const BitExpressionStates& input)
+{
+    const std::shared_ptr<IBitExpression> handle = Import(expression);
+    ++visit_epoch;
+    const uint32_t node = Restrict(GetNode(handle), input);
+    const int free_bit_count = static_cast<int>(input.GetFreeBitCount());
+    ++visit_epoch;
+    return std::ldexp(Probability(node), free_bit_count);
+}
+
+std::shared_ptr<IBitExpression> BddBitExpressionEngine::GetHandle(uint32_t node)
+{
+    return BitExpressionTable::Intern<BddBitExpression>(BitExpressionKey(BitExpressionKind::Handle, GetEngineId(), node), shared_from_this(), node);
+}
+
+void BddBitExpressionEngine::Reference(uint32_t node)
+{
+    ++references[node];
+}
+
+void BddBitExpressionEngine::Release(uint32_t node)
+{
+    --references[node];
+}
+
+void BddBitExpressionEngine::Collect()
+{
+    ++visit_epoch;
+    std::vector<uint32_t> stack;
+    for (uint32_t node = 0; node < levels.size(); ++node)
+    {
+        if (references[node] && visit_epochs[node] != visit_epoch)
+        {
+            visit_epochs[node] = visit_epoch;
+            stack.push_back(node);
+        }
+        while (!stack.empty())
+        {
+            const uint32_t current = stack.back();
+            stack.pop_back();
+            if (current < 2)
+            {
+                continue;
+            }
+            if (visit_epochs[lows[current]] != visit_epoch)
+            {
+                visit_epochs[lows[current]] = visit_epoch;
+                stack.push_back(lows[current]);
+            }
+            if (visit_epochs[highs[current]] != visit_epoch)
+            {
+                visit_epochs[highs[current]] = visit_epoch;
+                stack.push_back(highs[current]);
+            }
+        }
+    }
+    for (uint32_t node = 2; node < levels.size(); ++node)
+    {
+        if (visit_epochs[node] != visit_epoch && levels[node] != terminal_level)
+        {
+            unique_nodes.erase(BddNodeKey(levels[node], lows[node], highs[node]));
+            levels[node] = terminal_level;
+            free_nodes.push_back(node);
+        }
+    }
+    for (size_t i = 0; i < cache.size(); ++i)
+    {
+        cache[i].operation = BitExpressionKind::Handle;
+    }
+    collect_threshold = std::max<size_t>(1 << 16, 2 * GetNodeCount());
+}
+
+size_t BddBitExpressionEngine::GetNodeCount() const
+{
+    return levels.size() - free_nodes.size();
+}
+
+// Every decision node becomes (bit & high) | (~bit & low)
+void BddBitExpressionEngine::Export(const std::vector<const IBitExpression*>& expressions, IBitExpressionSink& sink, std::vector<uint32_t>& slots) const
+{
+    std::vector<uint32_t> node_slots(levels.size());
+    node_slots[0] = sink.Const(false);
+    node_slots[1] = sink.Const(true);
+    ++visit_epoch;
+    visit_epochs[0] = visit_epoch;
+    visit_epochs[1] = visit_epoch;
+    std::vector<std::pair<uint32_t, bool> > stack;
+    for (size_t i = 0; i < expressions.size(); ++i)
+    {
+        if (expressions[i]->GetEngine() != this)
+        {
+            throw std::runtime_error("BddBitExpressionEngine::Export(): expression belongs to another engine");
+        }
+        stack.push_back(std::make_pair(static_cast<const BddBitExpression*>(expressions[i])->GetNode(), false));
+        while (!stack.empty())
+        {
+            const uint32_t node = stack.back().first;
+            const bool expanded = stack.back().second;
+            stack.pop_back();
+            if (expanded)
+            {
+                const size_t bit_index = bit_indexes[node];
+                const uint32_t bit = sink.Variable(bit_index / BitExpressionStates::max_bit_count, bit_index % BitExpressionStates::max_bit_count);
+                const uint32_t high = sink.And(bit, node_slots[highs[node]]);
+                const uint32_t low = sink.And(sink.Neg(bit), node_slots[lows[node]]);
+                node_slots[node] = sink.Or(high, low);
+                continue;
+            }
+            if (visit_epochs[node] == visit_epoch)
+            {
+                continue;
+            }
+            visit_epochs[node] = visit_epoch;
+            stack.push_back(std::make_pair(node, true));
+            stack.push_back(std::make_pair(lows[node], false));
+            stack.push_back(std::make_pair(highs[node], false));
+        }
+    }
+    slots.clear();
+    for (size_t i = 0; i < expressions.size(); ++i)
+    {
+        slots.push_back(node_slots[static_cast<const BddBitExpression*>(expressions[i])->GetNode()]);
+    }
+}
+
+uint32_t BddBitExpressionEngine::MakeNode(uint32_t level, uint32_t bit_index, uint32_t low, uint32_t high)
+{
+    if (low == high)
+    {
+        return low;
+    }
+    const BddNodeKey key(level, low, high);
+    auto found = unique_nodes.find(key);
+    if (found != unique_nodes.end())
+    {
+        return found->second;
+    }
+    uint32_t node;
+    if (!free_nodes.empty())
+    {
+        node = free_nodes.back();
+        free_nodes.pop_back();
+        visit_epochs[node] = 0;
+        levels[node] = level;
+        bit_indexes[node] = bit_index;
+        lows[node] = low;
+        highs[node] = high;
+    }
+    else
+    {
+        node = static_cast<uint32_t>(levels.size());
+        levels.push_back(level);
+        bit_indexes.push_back(bit_index);
+        lows.push_back(low);
+        highs.push_back(high);
+        references.push_back(0);
+        visit_epochs.push_back(0);
+        constant_values.push_back(0);
+        restricted.push_back(0);
+        probabilities.push_back(0);
+    }
+    unique_nodes.insert(std::make_pair(key, node));
+    return node;
+}
+
+uint32_t BddBitExpressionEngine::Apply(BitExpressionKind operation, uint32_t left, uint32_t right)
+{
+    switch (operation)
+    {
+    case BitExpressionKind::And:
+        if (left == 0 || right == 0)
+            return 0;
+        if (left == 1 || left == right)
+            return right;
+        if (right == 1)
+            return left;
+        break;
+    case BitExpressionKind::Or:
+        if (left == 1 || right == 1)
+            return 1;
+        if (left == 0 || left == right)
+            return right;
+        if (right == 0)
+            return left;
+        break;
+    default:
+        if (left == right)
+            return 0;
+        if (left == 0)
+            return right;
+        if (right == 0)
+            return left;
+        if (left == 1)
+            return Not(right);
+        if (right == 1)
+            return Not(left);
+        break;
+    }
+    if (left > right)
+    {
+        std::swap(left, right);
+    }
+    CacheEntry& entry = GetCacheEntry(operation, left, right);
+    if (entry.operation == operation && entry.left == left && entry.right == right)
+    {
+        return entry.result;
+    }
+    const uint32_t level = std::min(levels[left], levels[right]);
+    const uint32_t left_low = levels[left] == level ? lows[left] : left;
+    const uint32_t left_high = levels[left] == level ? highs[left] : left;
+    const uint32_t right_low = levels[right] == level ? lows[right] : right;
+    const uint32_t right_high = levels[right] == level ? highs[right] : right;
+    const uint32_t bit_index = levels[left] == level ? bit_indexes[left] : bit_indexes[right];
+    const uint32_t low = Apply(operation, left_low, right_low);
+    const uint32_t high = Apply(operation, left_high, right_high);
+    const uint32_t result = MakeNode(level, bit_index, low, high);
+    CacheEntry& new_entry = GetCacheEntry(operation, left, right);
+    new_entry.operation = operation;
+    new_entry.left = left;
+    new_entry.right = right;
+    new_entry.result = result;
+    return result;
+}
+
+uint32_t BddBitExpressionEngine::Not(uint32_t node)
+{
+    if (node < 2)
+    {
+        return node ^ 1;
+    }
+    CacheEntry& entry = GetCacheEntry(BitExpressionKind::Neg, node, 0);
+    if (entry.operation == BitExpressionKind::Neg && entry.left == node)
+    {
+        return entry.result;
+    }
+    const uint32_t low = Not(lows[node]);
+    const uint32_t high = Not(highs[node]);
+    const uint32_t result = MakeNode(levels[node], bit_indexes[node], low, high);
+    CacheEntry& new_entry = GetCacheEntry(BitExpressionKind::Neg, node, 0);
+    new_entry.operation = BitExpressionKind::Neg;
+    new_entry.left = node;
+    new_entry.right = 0;
+    new_entry.result = result;
+    return result;
+}
+
+uint32_t BddBitExpressionEngine::Restrict(uint32_t node, const BitExpressionStates& input)
+{
+    if (node < 2)
+    {
+        return node;
+    }
+    if (visit_epochs[node] == visit_epoch)
+    {
+        return restricted[node];
+    }
+    uint32_t result;
+    const uint32_t bit_index = bit_indexes[node];
+    if (input.IsInputBitConstant(bit_index))
+    {
+        result = Restrict(input.GetInputBitValue(bit_index) ? highs[node] : lows[node], input);
+    }
+    else
+    {
+        const uint32_t low = Restrict(lows[node], input);
+        const uint32_t high = Restrict(highs[node], input);
+        result = MakeNode(levels[node], bit_index, low, high);
+    }
+    visit_epochs[node] = visit_epoch;
+    restricted[node] = result;
+    return result;
+}
+
+uint8_t BddBitExpressionEngine::ConstantValue(uint32_t node, const BitExpressionStates& input) const
+{
+    if (node < 2)
+    {
+        return static_cast<uint8_t>(node);
+    }
+    if (visit_epochs[node] == visit_epoch)
+    {
+        return constant_values[node];
+    }
+    uint8_t result;
+    const uint32_t bit_index = bit_indexes[node];
+    if (input.IsInputBitConstant(bit_index))
+    {
+        result = ConstantValue(input.GetInputBitValue(bit_index) ? highs[node] : lows[node], input);
+    }
+    else
+    {
+        const uint8_t low = ConstantValue(lows[node], input);
+        const uint8_t high = low == 2 ? 2 : ConstantValue(highs[node], input);
+        result = low == high ? low : 2;
+    }
+    visit_epochs[node] = visit_epoch;
+    constant_values[node] = result;
+    return result;
+}
+
+double BddBitExpressionEngine::Probability(uint32_t node)
+{
+    if (node < 2)
+    {
+        return node;
+    }
+    if (visit_epochs[node] == visit_epoch)
+    {
+        return probabilities[node];
+    }
+    const double result = (Probability(lows[node]) + Probability(highs[node])) / 2;
+    visit_epochs[node] = visit_epoch;
+    probabilities[node] = result;
+    return result;
+}
+
+uint32_t BddBitExpressionEngine::GetNode(const std::shared_ptr<IBitExpression>& expression) const
+{
+    return static_cast<const BddBitExpression*>(expression.get())->GetNode();
+}
+
+BddBitExpressionEngine::CacheEntry& BddBitExpressionEngine::GetCacheEntry(BitExpressionKind operation, uint32_t left, uint32_t right)
+{
+    const uint64_t hash = (static_cast<uint64_t>(left) << 32 | right) * 0x9E3779B97F4A7C15ull + static_cast<uint64_t>(operation);
+    return cache[(hash >> 40) & (cache_size - 1)];
+}
+
+void BddBitExpressionEngine::MaybeCollect()
+{
+    if (GetNodeCount() > collect_threshold)
+    {
+        Collect();
+    }
+}
+
+BddBitExpression::BddBitExpression(const std::shared_ptr<BddBitExpressionEngine>& engine_, uint32_t node_)
+    : IBitExpression(BitExpressionKey(BitExpressionKind::Handle, engine_->GetEngineId(), node_)), engine(engine_), node(node_)
+{
+    engine->Reference(node);
+}
+
+BddBitExpression::~BddBitExpression()
+{
+    engine->Release(node);
+}
+
+std::string BddBitExpression::ToString(const BitExpressionStates& info) const
+{
+    return engine->ToString(node, info);
+}
+
+bool BddBitExpression::Constant(const BitExpressionStates& input) const
+{
+    return engine->Constant(node, input);
+}
+
+bool BddBitExpression::Calculate(const BitExpressionStates& input) const
+{
+    return engine->Calculate(node, input);
+}
+
+int BddBitExpression::Priority() const
+{
+    return engine->Priority(node);
+}
+
+void BddBitExpression::Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) const
+{
+    const uint32_t optimized_node = engine->Optimize(node, input);
+    if (optimized_node != node)
+    {
+        output = engine->GetHandle(optimized_node);
+    }
+}
+
+IBitExpressionEngine* BddBitExpression::GetEngine() const
+{
+    return engine.get();
+}
+
+uint32_t BddBitExpression::GetNode() const
+{
+    return node;
+}
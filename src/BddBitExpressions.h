@@ -0,0 +1,147 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "BitExpressions.h"
+
+struct IBddVariableOrder
+{
+    virtual ~IBddVariableOrder();
+    virtual uint32_t GetLevel(size_t var_index, size_t bit_number) const = 0;
+};
+
+struct NaturalBddVariableOrder : public IBddVariableOrder
+{
+    uint32_t GetLevel(size_t var_index, size_t bit_number) const;
+};
+
+// Bit number major: the same bit of all variables sits together, which keeps adders small
+struct InterleavedBddVariableOrder : public IBddVariableOrder
+{
+    uint32_t GetLevel(size_t var_index, size_t bit_number) const;
+};
+
+struct BddNodeKey
+{
+    BddNodeKey(uint32_t level, uint32_t low, uint32_t high);
+    bool operator==(const BddNodeKey& other) const;
+
+    uint32_t level;
+    uint32_t low;
+    uint32_t high;
+};
+
+struct BddNodeKeyHash
+{
+    size_t operator()(const BddNodeKey& key) const;
+};
+
+// Reduced ordered binary decision diagrams over input bits, node 0 is false and node 1 is true
+class BddBitExpressionEngine : public IBitExpressionEngine, public std::enable_shared_from_this<BddBitExpressionEngine>
+{
+public:
+    explicit BddBitExpressionEngine(const std::shared_ptr<IBddVariableOrder>& order = std::make_shared<NaturalBddVariableOrder>());
+
+    std::shared_ptr<IBitExpression> Const(bool value);
+    std::shared_ptr<IBitExpression> Variable(size_t var_index, size_t bit_number);
+    std::shared_ptr<IBitExpression> Neg(const std::shared_ptr<IBitExpression>& argument);
+    std::shared_ptr<IBitExpression> Or(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
+    std::shared_ptr<IBitExpression> And(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
+    std::shared_ptr<IBitExpression> Xor(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
+
+    std::string ToString(uint32_t node, const BitExpressionStates& info) const;
+    bool Constant(uint32_t node, const BitExpressionStates& input) const;
+    bool Calculate(uint32_t node, const BitExpressionStates& input) const;
+    int Priority(uint32_t node) const;
+    uint32_t Optimize(uint32_t node, const BitExpressionStates& input);
+    double CountModels(const std::shared_ptr<IBitExpression>& expression, const BitExpressionStates& input);
+    std::shared_ptr<IBitExpression> GetHandle(uint32_t node);
+    void Reference(uint32_t node);
+    void Release(uint32_t node);
+    void Collect();
+    size_t GetNodeCount() const;
+    void Export(const std::vector<const IBitExpression*>& expressions, IBitExpressionSink& sink, std::vector<uint32_t>& slots) const;
+private:
+    static const uint32_t terminal_level = 0xFFFFFFFF;
+    static const size_t cache_size = 1 << 18;
+    static const size_t max_string_nodes = 1 << 12;
+
+    struct CacheEntry
+    {
+        BitExpressionKind operation;
+        uint32_t left;
+        uint32_t right;
+        uint32_t result;
+    };
+
+    uint32_t MakeNode(uint32_t level, uint32_t bit_index, uint32_t low, uint32_t high);
+    uint32_t Apply(BitExpressionKind operation, uint32_t left, uint32_t right);
+    uint32_t Not(uint32_t node);
+    uint32_t Restrict(uint32_t node, const BitExpressionStates& input);
+    uint8_t ConstantValue(uint32_t node, const BitExpressionStates& input) const;
+    double Probability(uint32_t node);
+    uint32_t GetNode(const std::shared_ptr<IBitExpression>& expression) const;
+    CacheEntry& GetCacheEntry(BitExpressionKind operation, uint32_t left, uint32_t right);
+    void MaybeCollect();
+
+    std::shared_ptr<IBddVariableOrder> order;
+    std::vector<uint32_t> levels;
+    std::vector<uint32_t> bit_indexes;
+    std::vector<uint32_t> lows;
+    std::vector<uint32_t> highs;
+    std::vector<uint32_t> references;
+    std::vector<uint32_t> free_nodes;
+    std::unordered_map<BddNodeKey, uint32_t, BddNodeKeyHash> unique_nodes;
+    std::unordered_map<uint32_t, uint32_t> level_bits;
+    std::vector<CacheEntry> cache;
+    size_t collect_threshold;
+
+    // Bumped by every Constant call, so 64 bits keep it from wrapping onto stale stamps
+    mutable std::vector<uint64_t> visit_epochs;
+    mutable uint64_t visit_epoch;
+    mutable std::vector<uint8_t> constant_values;
+    std::vector<uint32_t> restricted;
+    std::vector<double> probabilities;
+};
+
+struct BddBitExpression : public IBitExpression
+{
+    BddBitExpression(const std::shared_ptr<BddBitExpressionEngine>& engine, uint32_t node);
+    ~BddBitExpression();
+    std::string ToString(const BitExpressionStates& info) const;
+    bool Constant(const BitExpressionStates& input) const;
+    bool Calculate(const BitExpressionStates& input) const;
+    int Priority() const;
+    void Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) const;
+    IBitExpressionEngine* GetEngine() const;
+    uint32_t GetNode() const;
+private:
+    std::shared_ptr<BddBitExpressionEngine> engine;
+    uint32_t node;
+};
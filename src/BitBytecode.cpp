@@ -0,0 +1,394 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdexcept>
+#include <unordered_map>
+
+#include "BitBytecode.h"
+
+// Engine expressions are exported into the builder, so they share its hash-consing and folding
+struct BitBytecodeBuilder : public IBitExpressionSink
+{
+    explicit BitBytecodeBuilder(const BitExpressionStates& state);
+    uint32_t AddExpression(const std::shared_ptr<IBitExpression>& root);
+    uint32_t MakeNode(BitExpressionKind kind, uint32_t first, uint32_t second);
+    uint32_t Const(bool value);
+    uint32_t Variable(size_t var_index, size_t bit_number);
+    uint32_t Neg(uint32_t argument);
+    uint32_t Or(uint32_t left, uint32_t right);
+    uint32_t And(uint32_t left, uint32_t right);
+    uint32_t Xor(uint32_t left, uint32_t right);
+    bool AreComplementary(uint32_t first, uint32_t second) const;
+
+    const BitExpressionStates& state;
+    std::vector<BitExpressionKey> nodes;
+    std::unordered_map<BitExpressionKey, uint32_t, BitExpressionKeyHash> unique_nodes;
+    std::unordered_map<const IBitExpression*, uint32_t> slots;
+};
+
+BitBytecodeBuilder::BitBytecodeBuilder(const BitExpressionStates& state_) : state(state_)
+{
+    nodes.push_back(BitExpressionKey(BitExpressionKind::Const, 0, 0));
+    nodes.push_back(BitExpressionKey(BitExpressionKind::Const, 1, 0));
+}
+
+uint32_t BitBytecodeBuilder::AddExpression(const std::shared_ptr<IBitExpression>& root)
+{
+    std::vector<std::pair<const IBitExpression*, bool> > stack;
+    stack.push_back(std::make_pair(root.get(), false));
+    while (!stack.empty())
+    {
+        const IBitExpression* node = stack.back().first;
+        const bool expanded = stack.back().second;
+        stack.pop_back();
+        if (slots.count(node))
+        {
+            continue;
+        }
+        const BitExpressionKey& key = node->GetKey();
+        if (key.kind == BitExpressionKind::Const)
+        {
+            slots[node] = key.first;
+        }
+        else if (key.kind == BitExpressionKind::Variable)
+        {
+            slots[node] = Variable(key.first, key.second);
+        }
+        else if (!node->GetOperandCount())
+        {
+            // Tree operators route engine operands to the engine, so only roots may be engine expressions
+            throw std::runtime_error("BitBytecode::Compile(): engine expression below a tree operator");
+        }
+        else if (expanded)
+        {
+            uint32_t result = slots[node->GetOperand(0).get()];
+            if (key.kind == BitExpressionKind::Neg)
+            {
+                result = MakeNode(key.kind, result, 0);
+            }
+            for (size_t i = 1; i < node->GetOperandCount(); ++i)
+            {
+                result = MakeNode(key.kind, result, slots[node->GetOperand(i).get()]);
+            }
+            slots[node] = result;
+        }
+        else
+        {
+            stack.push_back(std::make_pair(node, true));
+            for (size_t i = node->GetOperandCount(); i-- > 0;)
+            {
+                stack.push_back(std::make_pair(node->GetOperand(i).get(), false));
+            }
+        }
+    }
+    return slots[root.get()];
+}
+
+uint32_t BitBytecodeBuilder::MakeNode(BitExpressionKind kind, uint32_t first, uint32_t second)
+{
+    switch (kind)
+    {
+    case BitExpressionKind::Neg:
+        if (first < 2)
+            return first ^ 1;
+        if (nodes[first].kind == BitExpressionKind::Neg)
+            return nodes[first].first;
+        break;
+    case BitExpressionKind::Or:
+        if (first == 1 || second == 1 || AreComplementary(first, second))
+            return 1;
+        if (first == 0 || first == second)
+            return second;
+        if (second == 0)
+            return first;
+        break;
+    case BitExpressionKind::And:
+        if (first == 0 || second == 0 || AreComplementary(first, second))
+            return 0;
+        if (first == 1 || first == second)
+            return second;
+        if (second == 1)
+            return first;
+        break;
+    case BitExpressionKind::Xor:
+        if (first == second)
+            return 0;
+        if (AreComplementary(first, second))
+            return 1;
+        if (first == 0)
+            return second;
+        if (second == 0)
+            return first;
+        if (first == 1)
+            return MakeNode(BitExpressionKind::Neg, second, 0);
+        if (second == 1)
+            return MakeNode(BitExpressionKind::Neg, first, 0);
+        break;
+    default:
+        break;
+    }
+    if (kind != BitExpressionKind::Neg && kind != BitExpressionKind::Variable && first > second)
+    {
+        std::swap(first, second);
+    }
+    const BitExpressionKey key(kind, first, second);
+    auto found = unique_nodes.find(key);
+    if (found != unique_nodes.end())
+    {
+        return found->second;
+    }
+    nodes.push_back(key);
+    const uint32_t node = static_cast<uint32_t>(nodes.size() - 1);
+    unique_nodes.insert(std::make_pair(key, node));
+    return node;
+}
+
+uint32_t BitBytecodeBuilder::Const(bool value)
+{
+    return value ? 1 : 0;
+}
+
+uint32_t BitBytecodeBuilder::Variable(size_t var_index, size_t bit_number)
+{
+    const size_t bit_index = BitExpressionStates::GetBitIndex(var_index, bit_number);
+    if (state.IsInputBitConstant(bit_index))
+    {
+        return state.GetInputBitValue(bit_index) ? 1 : 0;
+    }
+    return MakeNode(BitExpressionKind::Variable, static_cast<uint32_t>(bit_index), 0);
+}
+
+uint32_t BitBytecodeBuilder::Neg(uint32_t argument)
+{
+    return MakeNode(BitExpressionKind::Neg, argument, 0);
+}
+
+uint32_t BitBytecodeBuilder::Or(uint32_t left, uint32_t right)
+{
+    return MakeNode(BitExpressionKind::Or, left, right);
+}
+
+uint32_t BitBytecodeBuilder::And(uint32_t left, uint32_t right)
+{
+    return MakeNode(BitExpressionKind::And, left, right);
+}
+
+uint32_t BitBytecodeBuilder::Xor(uint32_t left, uint32_t right)
+{
+    return MakeNode(BitExpressionKind::Xor, left, right);
+}
+
+bool BitBytecodeBuilder::AreComplementary(uint32_t first, uint32_t second) const
+{
+    return (nodes[first].kind == BitExpressionKind::Neg && nodes[first].first == second) ||
+        (nodes[second].kind == BitExpressionKind::Neg && nodes[second].first == first);
+}
+
+std::shared_ptr<BitBytecode> BitBytecode::Compile(const BitExpressionStates& state, const std::vector<size_t>& var_indexes)
+{
+    BitBytecodeBuilder builder(state);
+    std::vector<uint32_t> roots;
+    // Engine roots are gathered per engine and exported together, so their shared nodes are emitted once
+    std::vector<std::shared_ptr<IBitExpression> > expressions;
+    std::vector<IBitExpressionEngine*> engines;
+    std::vector<std::vector<const IBitExpression*> > engine_expressions;
+    std::vector<std::vector<size_t> > engine_roots;
+    for (size_t i = 0; i < var_indexes.size(); ++i)
+    {
+        for (size_t bit_number = 0; bit_number < state.GetBitCount(); ++bit_number)
+        {
+            const size_t bit_index = BitExpressionStates::GetBitIndex(var_indexes[i], bit_number);
+            expressions.push_back(state.GetBitExpression(bit_index));
+            IBitExpressionEngine* engine = expressions.back()->GetEngine();
+            if (!engine)
+            {
+                roots.push_back(builder.AddExpression(expressions.back()));
+                continue;
+            }
+            size_t engine_number = 0;
+            while (engine_number < engines.size() && engines[engine_number] != engine)
+            {
+                ++engine_number;
+            }
+            if (engine_number == engines.size())
+            {
+                engines.push_back(engine);
+                engine_expressions.emplace_back();
+                engine_roots.emplace_back();
+            }
+            engine_expressions[engine_number].push_back(expressions.back().get());
+            engine_roots[engine_number].push_back(roots.size());
+            roots.push_back(0);
+        }
+    }
+    std::vector<uint32_t> engine_slots;
+    for (size_t i = 0; i < engines.size(); ++i)
+    {
+        engines[i]->Export(engine_expressions[i], builder, engine_slots);
+        for (size_t j = 0; j < engine_slots.size(); ++j)
+        {
+            roots[engine_roots[i][j]] = engine_slots[j];
+        }
+    }
+    const std::vector<BitExpressionKey>& nodes = builder.nodes;
+
+    const size_t output_use = static_cast<size_t>(-1);
+    std::vector<size_t> last_uses(nodes.size(), 0);
+    std::vector<bool> live(nodes.size(), false);
+    for (size_t i = 0; i < roots.size(); ++i)
+    {
+        live[roots[i]] = true;
+        last_uses[roots[i]] = output_use;
+    }
+    for (size_t node = nodes.size(); node-- > 2;)
+    {
+        const BitExpressionKind kind = nodes[node].kind;
+        if (!live[node] || kind == BitExpressionKind::Variable)
+        {
+            continue;
+        }
+        live[nodes[node].first] = true;
+        last_uses[nodes[node].first] = std::max(last_uses[nodes[node].first], node);
+        if (kind != BitExpressionKind::Neg)
+        {
+            live[nodes[node].second] = true;
+            last_uses[nodes[node].second] = std::max(last_uses[nodes[node].second], node);
+        }
+    }
+
+    std::shared_ptr<BitBytecode> result = std::make_shared<BitBytecode>();
+    std::vector<uint32_t> registers(nodes.size(), 0);
+    registers[1] = true_register;
+    for (size_t node = 2; node < nodes.size(); ++node)
+    {
+        if (live[node] && nodes[node].kind == BitExpressionKind::Variable)
+        {
+            registers[node] = first_input_register + static_cast<uint32_t>(result->inputs.size());
+            result->inputs.push_back(nodes[node].first);
+        }
+    }
+    result->register_count = first_input_register + static_cast<uint32_t>(result->inputs.size());
+
+    std::vector<uint32_t> free_registers;
+    for (size_t node = 2; node < nodes.size(); ++node)
+    {
+        const BitExpressionKey& key = nodes[node];
+        if (!live[node] || key.kind == BitExpressionKind::Variable)
+        {
+            continue;
+        }
+        Instruction instruction = { key.kind, 0, registers[key.first], 0 };
+        if (last_uses[key.first] == node && nodes[key.first].kind != BitExpressionKind::Variable && key.first > 1)
+        {
+            free_registers.push_back(registers[key.first]);
+        }
+        if (key.kind != BitExpressionKind::Neg)
+        {
+            instruction.second = registers[key.second];
+            if (last_uses[key.second] == node && nodes[key.second].kind != BitExpressionKind::Variable && key.second > 1)
+            {
+                free_registers.push_back(registers[key.second]);
+            }
+        }
+        if (free_registers.empty())
+        {
+            instruction.destination = result->register_count++;
+        }
+        else
+        {
+            instruction.destination = free_registers.back();
+            free_registers.pop_back();
+        }
+        registers[node] = instruction.destination;
+        result->instructions.push_back(instruction);
+    }
+
+    result->var_indexes = var_indexes;
+    result->bit_count = state.GetBitCount();
+    for (size_t i = 0; i < roots.size(); ++i)
+    {
+        result->outputs.push_back(registers[roots[i]]);
+    }
+    return result;
+}
+
+uint32_t BitBytecode::GetOutputRegister(size_t var_index, size_t bit_number) const
+{
+    for (size_t i = 0; i < var_indexes.size(); ++i)
+    {
+        if (var_indexes[i] == var_index)
+        {
+            return outputs[i * bit_count + bit_number];
+        }
+    }
+    throw std::runtime_error("BitBytecode::GetOutputRegister(): variable was not compiled");
+}
+
+BitBytecodeVm::BitBytecodeVm(const std::shared_ptr<const BitBytecode>& code_) : code(code_), registers(code_->register_count, 0)
+{
+    registers[BitBytecode::true_register] = 1;
+}
+
+void BitBytecodeVm::Run(const BitExpressionStates& input)
+{
+    const std::vector<size_t>& inputs = code->inputs;
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        registers[BitBytecode::first_input_register + i] = input.GetInputBitValue(inputs[i]) ? 1 : 0;
+    }
+    uint8_t* values = registers.data();
+    const BitBytecode::Instruction* instruction = code->instructions.data();
+    const BitBytecode::Instruction* end = instruction + code->instructions.size();
+    for (; instruction != end; ++instruction)
+    {
+        switch (instruction->kind)
+        {
+        case BitExpressionKind::Neg:
+            values[instruction->destination] = values[instruction->first] ^ 1;
+            break;
+        case BitExpressionKind::Or:
+            values[instruction->destination] = values[instruction->first] | values[instruction->second];
+            break;
+        case BitExpressionKind::And:
+            values[instruction->destination] = values[instruction->first] & values[instruction->second];
+            break;
+        default:
+            values[instruction->destination] = values[instruction->first] ^ values[instruction->second];
+            break;
+        }
+    }
+}
+
+bool BitBytecodeVm::GetBitValue(size_t var_index, size_t bit_number) const
+{
+    return registers[code->GetOutputRegister(var_index, bit_number)] != 0;
+}
+
+BitExpressionStates::work_type BitBytecodeVm::GetVarValue(size_t var_index) const
+{
+    BitExpressionStates::work_type result = 0;
+    for (size_t bit_number = 0; bit_number < code->bit_count; ++bit_number)
+    {
+        const BitExpressionStates::work_type bit_value = GetBitValue(var_index, bit_number) ? 1 : 0;
+        result |= bit_value << bit_number;
+    }
+    return result;
+}
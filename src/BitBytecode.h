@@ -0,0 +1,70 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "BitExpressions.h"
+
+// Register bytecode for the bit expressions of selected variables, engine expressions lowered through
+// IBitExpressionEngine::Export; registers 0 and 1 hold the constants and the free input bits follow
+// them, so only Neg/Or/And/Xor are executed
+struct BitBytecode
+{
+    struct Instruction
+    {
+        BitExpressionKind kind;
+        uint32_t destination;
+        uint32_t first;
+        uint32_t second;
+    };
+
+    static const uint32_t false_register = 0;
+    static const uint32_t true_register = 1;
+    static const uint32_t first_input_register = 2;
+
+    static std::shared_ptr<BitBytecode> Compile(const BitExpressionStates& state, const std::vector<size_t>& var_indexes);
+
+    uint32_t GetOutputRegister(size_t var_index, size_t bit_number) const;
+
+    std::vector<Instruction> instructions;
+    std::vector<size_t> inputs;
+    std::vector<size_t> var_indexes;
+    size_t bit_count;
+    std::vector<uint32_t> outputs;
+    uint32_t register_count;
+};
+
+struct BitBytecodeVm
+{
+    explicit BitBytecodeVm(const std::shared_ptr<const BitBytecode>& code);
+
+    void Run(const BitExpressionStates& input);
+    bool GetBitValue(size_t var_index, size_t bit_number) const;
+    BitExpressionStates::work_type GetVarValue(size_t var_index) const;
+private:
+    std::shared_ptr<const BitBytecode> code;
+    std::vector<uint8_t> registers;
+};
@@ -0,0 +1,218 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "BitExpressionPrinter.h"
+
+static bool IsOperator(const IBitExpression* node)
+{
+    return node->GetOperandCount() != 0;
+}
+
+static const char* GetSymbol(BitExpressionKind kind)
+{
+    switch (kind)
+    {
+    case BitExpressionKind::Or:
+        return "+";
+    case BitExpressionKind::And:
+        return "*";
+    default:
+        return "^";
+    }
+}
+
+BitExpressionPrinter::BitExpressionPrinter(const BitExpressionStates& info_, size_t max_depth_, size_t max_nodes_)
+    : info(info_), max_depth(max_depth_), max_nodes(max_nodes_), written_nodes(0)
+{
+}
+
+void BitExpressionPrinter::AddRoot(const std::string& name, const std::shared_ptr<IBitExpression>& expression)
+{
+    roots.push_back(std::make_pair(name, expression));
+    std::vector<const IBitExpression*> nodes;
+    nodes.push_back(expression.get());
+    while (!nodes.empty())
+    {
+        const IBitExpression* node = nodes.back();
+        nodes.pop_back();
+        auto found = use_counts.find(node);
+        if (found != use_counts.end())
+        {
+            ++found->second;
+            continue;
+        }
+        if (use_counts.size() >= max_nodes)
+        {
+            continue;
+        }
+        use_counts.insert(std::make_pair(node, 1));
+        for (size_t i = 0; i < node->GetOperandCount(); ++i)
+        {
+            nodes.push_back(node->GetOperand(i).get());
+        }
+    }
+}
+
+void BitExpressionPrinter::Write(std::ostream& output)
+{
+    for (size_t i = 0; i < roots.size(); ++i)
+    {
+        const IBitExpression* root = roots[i].second.get();
+        WriteBindings(output, root);
+        output << roots[i].first << " = ";
+        if (bindings.count(root))
+        {
+            output << "t" << bindings[root];
+        }
+        else if (IsOperator(root) && written_nodes >= max_nodes)
+        {
+            output << "...";
+        }
+        else
+        {
+            WriteLine(output, root);
+        }
+        output << "\n";
+    }
+    roots.clear();
+}
+
+bool BitExpressionPrinter::IsShared(const IBitExpression* node) const
+{
+    auto found = use_counts.find(node);
+    return IsOperator(node) && found != use_counts.end() && found->second > 1;
+}
+
+bool BitExpressionPrinter::IsElided(const IBitExpression* node, size_t depth) const
+{
+    return depth > max_depth || written_nodes >= max_nodes || IsShared(node);
+}
+
+// Emits the bindings a root needs in post-order, so every tN is defined before it is referenced
+void BitExpressionPrinter::WriteBindings(std::ostream& output, const IBitExpression* root)
+{
+    std::vector<Frame> frames;
+    Frame frame = { root, 0, 0, false };
+    frames.push_back(frame);
+    while (!frames.empty() && written_nodes < max_nodes)
+    {
+        Frame& top = frames.back();
+        if (top.next < top.node->GetOperandCount())
+        {
+            const IBitExpression* operand = top.node->GetOperand(top.next++).get();
+            const bool shared = IsShared(operand);
+            const size_t depth = shared ? 0 : top.depth + 1;
+            // Nodes past the use count cap are never bound; they are written inline within the node budget
+            if (IsOperator(operand) && use_counts.count(operand) && !bindings.count(operand) && depth <= max_depth)
+            {
+                Frame operand_frame = { operand, 0, depth, false };
+                frames.push_back(operand_frame);
+            }
+            continue;
+        }
+        const IBitExpression* node = top.node;
+        frames.pop_back();
+        if (IsShared(node) && !bindings.count(node))
+        {
+            const size_t number = bindings.size();
+            output << "  t" << number << " = ";
+            WriteLine(output, node);
+            output << "\n";
+            bindings[node] = number;
+        }
+    }
+}
+
+void BitExpressionPrinter::WriteLine(std::ostream& output, const IBitExpression* root)
+{
+    std::vector<Frame> frames;
+    if (!IsOperator(root))
+    {
+        WriteOperand(output, root, 0, -1, frames);
+        return;
+    }
+    Frame frame = { root, 0, 0, false };
+    frames.push_back(frame);
+    ++written_nodes;
+    while (!frames.empty())
+    {
+        Frame& top = frames.back();
+        const IBitExpression* node = top.node;
+        const BitExpressionKind kind = node->GetKind();
+        if (top.next < node->GetOperandCount())
+        {
+            if (kind == BitExpressionKind::Neg)
+            {
+                output << "!";
+            }
+            else if (top.next)
+            {
+                output << GetSymbol(kind);
+            }
+            const IBitExpression* operand = node->GetOperand(top.next++).get();
+            WriteOperand(output, operand, top.depth + 1, node->Priority(), frames);
+            continue;
+        }
+        if (top.parenthesized)
+        {
+            output << ")";
+        }
+        frames.pop_back();
+    }
+}
+
+void BitExpressionPrinter::WriteOperand(std::ostream& output, const IBitExpression* node, size_t depth, int parent_priority, std::vector<Frame>& frames)
+{
+    const BitExpressionKey& key = node->GetKey();
+    if (key.kind == BitExpressionKind::Const)
+    {
+        output << key.first;
+    }
+    else if (key.kind == BitExpressionKind::Variable)
+    {
+        output << info.GetVarName(key.first) << "." << key.second;
+    }
+    else if (!IsOperator(node))
+    {
+        // Engine expressions keep their own formatting
+        const bool parenthesized = node->Priority() < parent_priority;
+        output << (parenthesized ? "(" : "") << node->ToString(info) << (parenthesized ? ")" : "");
+    }
+    else if (bindings.count(node))
+    {
+        output << "t" << bindings[node];
+    }
+    else if (IsElided(node, depth))
+    {
+        output << "...";
+    }
+    else
+    {
+        const bool parenthesized = node->Priority() < parent_priority;
+        if (parenthesized)
+        {
+            output << "(";
+        }
+        Frame frame = { node, 0, depth, parenthesized };
+        frames.push_back(frame);
+        ++written_nodes;
+    }
+}
@@ -0,0 +1,70 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+#include "BitExpressions.h"
+
+// Streams expressions as let-bindings: an operator node used more than once by the added roots
+// is written once as "tN = ..." before its first use and referred to as tN afterwards.
+// Terms nested deeper than max_depth within a line, or past max_nodes written nodes, are elided as "...";
+// sharing is only detected among the first max_nodes distinct nodes so the cost stays bounded on huge DAGs
+struct BitExpressionPrinter
+{
+    static const size_t default_max_depth = 64;
+    static const size_t default_max_nodes = 1 << 12;
+
+    explicit BitExpressionPrinter(const BitExpressionStates& info, size_t max_depth = default_max_depth, size_t max_nodes = default_max_nodes);
+
+    void AddRoot(const std::string& name, const std::shared_ptr<IBitExpression>& expression);
+    void Write(std::ostream& output);
+private:
+    struct Frame
+    {
+        const IBitExpression* node;
+        size_t next;
+        size_t depth;
+        bool parenthesized;
+    };
+
+    bool IsShared(const IBitExpression* node) const;
+    bool IsElided(const IBitExpression* node, size_t depth) const;
+    void WriteBindings(std::ostream& output, const IBitExpression* root);
+    void WriteLine(std::ostream& output, const IBitExpression* root);
+    void WriteOperand(std::ostream& output, const IBitExpression* node, size_t depth, int parent_priority, std::vector<Frame>& frames);
+
+    const BitExpressionStates& info;
+    size_t max_depth;
+    size_t max_nodes;
+    size_t written_nodes;
+    std::vector<std::pair<std::string, std::shared_ptr<IBitExpression> > > roots;
+    std::unordered_map<const IBitExpression*, uint32_t> use_counts;
+    std::unordered_map<const IBitExpression*, size_t> bindings;
+};
@@ -0,0 +1,222 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "BitExpressionStatistics.h"
+#include "WordExpressions.h"
+
+static size_t GetNodeBytes(const IBitExpression* node)
+{
+    switch (node->GetKind())
+    {
+    case BitExpressionKind::Const:
+        return sizeof(ConstBitExpression);
+    case BitExpressionKind::Variable:
+        return sizeof(VariableBitExpression);
+    case BitExpressionKind::Neg:
+        return sizeof(NegBitExpression);
+    case BitExpressionKind::Handle:
+        return sizeof(IBitExpression);
+    default:
+        return sizeof(AssociativeBitExpression) + node->GetOperandCount() * sizeof(std::shared_ptr<IBitExpression>);
+    }
+}
+
+static void WriteJsonString(std::ostream& output, const std::string& text)
+{
+    output << "\"";
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        if (text[i] == '"' || text[i] == '\\')
+        {
+            output << "\\";
+        }
+        output << text[i];
+    }
+    output << "\"";
+}
+
+BitExpressionStatistics BitExpressionStatistics::Collect(const BitExpressionStates& state)
+{
+    BitExpressionStatistics result;
+    result.live_node_count = BitExpressionTable::GetNodeCount();
+    result.unique_node_count = 0;
+    result.unique_word_node_count = 0;
+    result.byte_count = 0;
+
+    // Depth of every finished node; leaves are at depth 0
+    std::unordered_map<const IBitExpression*, size_t> depths;
+    // Last variable that visited a node, so a node shared between variables is counted by each of them
+    std::unordered_map<const IBitExpression*, size_t> owners;
+    std::vector<std::pair<const IBitExpression*, size_t> > stack;
+    // The same for the word terms; reading the bits of a word variable would blast it
+    std::unordered_map<const WordExpression*, size_t> word_depths;
+    std::unordered_map<const WordExpression*, size_t> word_owners;
+    std::vector<std::pair<const WordExpression*, size_t> > word_stack;
+    for (size_t var_index = 0; var_index < state.GetVariableCount(); ++var_index)
+    {
+        VarStatistics var_statistics = { 0, 0, 0.0, 0, 0 };
+        if (state.HasWordExpression(var_index))
+        {
+            auto enter = [&](const WordExpression* node)
+            {
+                auto owner = word_owners.insert(std::make_pair(node, var_index));
+                if (!owner.second && owner.first->second == var_index)
+                {
+                    return;
+                }
+                if (owner.second)
+                {
+                    ++result.unique_word_node_count;
+                    result.byte_count += sizeof(WordExpression);
+                }
+                owner.first->second = var_index;
+                ++var_statistics.word_node_count;
+                word_stack.push_back(std::make_pair(node, 0));
+            };
+            const std::shared_ptr<WordExpression> root = state.GetWordExpression(var_index);
+            enter(root.get());
+            while (!word_stack.empty())
+            {
+                const WordExpression* node = word_stack.back().first;
+                const size_t next = word_stack.back().second;
+                if (next < node->GetOperandCount())
+                {
+                    ++word_stack.back().second;
+                    enter(node->GetOperand(next).get());
+                    continue;
+                }
+                size_t depth = 0;
+                for (size_t i = 0; i < node->GetOperandCount(); ++i)
+                {
+                    depth = std::max(depth, word_depths[node->GetOperand(i).get()] + 1);
+                }
+                word_depths[node] = depth;
+                word_stack.pop_back();
+            }
+            var_statistics.word_depth = word_depths[root.get()];
+            result.variables.push_back(var_statistics);
+            continue;
+        }
+        auto enter = [&](const IBitExpression* node)
+        {
+            auto owner = owners.insert(std::make_pair(node, var_index));
+            if (!owner.second && owner.first->second == var_index)
+            {
+                return;
+            }
+            if (owner.second)
+            {
+                ++result.unique_node_count;
+                result.byte_count += GetNodeBytes(node);
+            }
+            owner.first->second = var_index;
+            ++var_statistics.node_count;
+            stack.push_back(std::make_pair(node, 0));
+        };
+        for (size_t bit_number = 0; bit_number < state.GetBitCount(); ++bit_number)
+        {
+            const std::shared_ptr<IBitExpression> root = state.GetBitExpression(BitExpressionStates::GetBitIndex(var_index, bit_number));
+            enter(root.get());
+            while (!stack.empty())
+            {
+                const IBitExpression* node = stack.back().first;
+                const size_t next = stack.back().second;
+                if (next < node->GetOperandCount())
+                {
+                    ++stack.back().second;
+                    enter(node->GetOperand(next).get());
+                    continue;
+                }
+                size_t depth = 0;
+                for (size_t i = 0; i < node->GetOperandCount(); ++i)
+                {
+                    depth = std::max(depth, depths[node->GetOperand(i).get()] + 1);
+                }
+                depths[node] = depth;
+                stack.pop_back();
+            }
+            const size_t depth = depths[root.get()];
+            var_statistics.max_depth = std::max(var_statistics.max_depth, depth);
+            var_statistics.average_depth += static_cast<double>(depth) / state.GetBitCount();
+        }
+        result.variables.push_back(var_statistics);
+    }
+    return result;
+}
+
+void ExecutionProfile::Record(size_t statement_index, const std::string& label, const BitExpressionStates& state)
+{
+    Step step;
+    step.statement_index = statement_index;
+    step.label = label;
+    step.section = label.empty() && !steps.empty() ? steps.back().section : label;
+    step.statistics = BitExpressionStatistics::Collect(state);
+    steps.push_back(step);
+}
+
+void ExecutionProfile::WriteCsv(std::ostream& output, const BitExpressionStates& info) const
+{
+    output << "step,statement,label,section,live_nodes,unique_nodes,unique_word_nodes,bytes,variable,nodes,max_depth,average_depth,word_nodes,word_depth\n";
+    for (size_t step_index = 0; step_index < steps.size(); ++step_index)
+    {
+        const Step& step = steps[step_index];
+        const BitExpressionStatistics& statistics = step.statistics;
+        for (size_t var_index = 0; var_index < statistics.variables.size(); ++var_index)
+        {
+            const VarStatistics& var_statistics = statistics.variables[var_index];
+            output << step_index << "," << step.statement_index << "," << step.label << "," << step.section << ",";
+            output << statistics.live_node_count << "," << statistics.unique_node_count << "," << statistics.unique_word_node_count << "," << statistics.byte_count << ",";
+            output << info.GetVarName(var_index) << "," << var_statistics.node_count << "," << var_statistics.max_depth << "," << var_statistics.average_depth << ",";
+            output << var_statistics.word_node_count << "," << var_statistics.word_depth << "\n";
+        }
+    }
+}
+
+void ExecutionProfile::WriteJson(std::ostream& output, const BitExpressionStates& info) const
+{
+    output << "[\n";
+    for (size_t step_index = 0; step_index < steps.size(); ++step_index)
+    {
+        const Step& step = steps[step_index];
+        const BitExpressionStatistics& statistics = step.statistics;
+        output << "  {\"step\": " << step_index << ", \"statement\": " << step.statement_index << ", \"label\": ";
+        WriteJsonString(output, step.label);
+        output << ", \"section\": ";
+        WriteJsonString(output, step.section);
+        output << ", \"live_nodes\": " << statistics.live_node_count << ", \"unique_nodes\": " << statistics.unique_node_count;
+        output << ", \"unique_word_nodes\": " << statistics.unique_word_node_count;
+        output << ", \"bytes\": " << statistics.byte_count << ", \"variables\": [";
+        for (size_t var_index = 0; var_index < statistics.variables.size(); ++var_index)
+        {
+            const VarStatistics& var_statistics = statistics.variables[var_index];
+            output << (var_index ? ", " : "") << "{\"name\": ";
+            WriteJsonString(output, info.GetVarName(var_index));
+            output << ", \"nodes\": " << var_statistics.node_count << ", \"max_depth\": " << var_statistics.max_depth;
+            output << ", \"average_depth\": " << var_statistics.average_depth << ", \"word_nodes\": " << var_statistics.word_node_count;
+            output << ", \"word_depth\": " << var_statistics.word_depth << "}";
+        }
+        output << "]}" << (step_index + 1 < steps.size() ? "," : "") << "\n";
+    }
+    output << "]\n";
+}
@@ -0,0 +1,76 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "BitExpressions.h"
+
+struct VarStatistics
+{
+    // Distinct nodes reachable from the bits of the variable
+    size_t node_count;
+    size_t max_depth;
+    double average_depth;
+    // Terms of a word expression the variable holds; its bit counts above are then zero
+    size_t word_node_count;
+    size_t word_depth;
+};
+
+// Size of the expressions held by a state; engine handles count as leaves. Variables holding a word
+// expression are measured in word terms, so collecting never forces bit-blasting
+struct BitExpressionStatistics
+{
+    static BitExpressionStatistics Collect(const BitExpressionStates& state);
+
+    // Nodes alive in the process-wide expression table
+    size_t live_node_count;
+    // Distinct nodes reachable from any variable of the state
+    size_t unique_node_count;
+    size_t unique_word_node_count;
+    // Estimated memory held by the unique nodes and word terms
+    size_t byte_count;
+    std::vector<VarStatistics> variables;
+};
+
+// Statistics recorded after each executed statement; section is the last label passed
+struct ExecutionProfile
+{
+    struct Step
+    {
+        size_t statement_index;
+        std::string label;
+        std::string section;
+        BitExpressionStatistics statistics;
+    };
+
+    void Record(size_t statement_index, const std::string& label, const BitExpressionStates& state);
+    // One row per step and variable
+    void WriteCsv(std::ostream& output, const BitExpressionStates& info) const;
+    void WriteJson(std::ostream& output, const BitExpressionStates& info) const;
+
+    std::vector<Step> steps;
+};
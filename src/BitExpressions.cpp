@@ -19,27 +19,49 @@
  *
  */
 
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
 #include "BitExpressions.h"
+#include "WordExpressions.h"
+
+static std::atomic<uint64_t> next_states_epoch(1);
+
+BitExpressionStates::BitExpressionStates(size_t bit_count_) : bit_count(bit_count_), epoch(0)
+{
+    if (!bit_count || bit_count > max_bit_count)
+        throw std::runtime_error("BitExpressionStates::BitExpressionStates(): word width is not supported");
+
+    Touch();
+}
+
+size_t BitExpressionStates::GetBitCount() const
+{
+    return bit_count;
+}
+
+BitExpressionStates::work_type BitExpressionStates::GetWordMask() const
+{
+    return bit_count == max_bit_count ? ~static_cast<work_type>(0) : (static_cast<work_type>(1) << bit_count) - 1;
+}
 
 size_t BitExpressionStates::GetBitIndex(size_t var_index, size_t bit_number)
 {
-    return var_index * bit_count + bit_number;
+    return var_index * max_bit_count + bit_number;
 }
 
 bool BitExpressionStates::ExtractBit(work_type value, size_t bit_number)
 {
-    const work_type mask = 1 << bit_number;
-    return (value & mask) == mask;
+    return ((value >> bit_number) & 1) != 0;
 }
 
 size_t BitExpressionStates::GetVarIndex(const std::string& name) const
 {
-    for (size_t i = 0; i < names.size(); ++i)
+    auto found = name_indexes.find(name);
+    if (found != name_indexes.end())
     {
-        if (name == names[i])
-        {
-            return i;
-        }
+        return found->second;
     }
     throw std::runtime_error("BitExpressionStates::GetVarIndex(): variable name was not found");
 }
@@ -54,29 +76,31 @@ size_t BitExpressionStates::GetVarIndex(const std::string& name, size_t index) c
     throw std::runtime_error("BitExpressionStates::GetVarIndex(): variable name was not found");
 }
 
-std::string BitExpressionStates::GetVarName(size_t var_index) const
+const std::string& BitExpressionStates::GetVarName(size_t var_index) const
 {
-    const std::string name = names.at(var_index);
-    if (array_sizes.at(var_index))
-    {
-        const size_t array_index = var_index - array_starts.at(var_index);
-        return name + "[" + std::to_string(array_index) + "]";
-    }
-    return name;
+    return display_names.at(var_index);
 }
 
 size_t BitExpressionStates::AddVariable(const std::string& name, bool constant, work_type initial_value)
 {
     const size_t var_index = input_variables.size();
-    input_variables.push_back(initial_value);
+    input_variables.push_back(initial_value & GetWordMask());
     array_sizes.push_back(0);
     array_starts.push_back(0);
     names.push_back(name);
+    display_names.push_back(name);
+    name_indexes.insert(std::make_pair(name, var_index));
+    std::shared_ptr<var_expressions_type> var_expressions = std::make_shared<var_expressions_type>();
+    var_expressions->reserve(bit_count);
     for (size_t bit_number = 0; bit_number < bit_count; ++bit_number)
     {
-        input_bit_constants.push_back(constant);
-        bit_expressions.push_back(std::make_shared<VariableBitExpression>(var_index, bit_number));
+        var_expressions->push_back(engine ? engine->Variable(var_index, bit_number) : variable_bit(var_index, bit_number));
     }
+    input_constant_masks.push_back(constant ? GetWordMask() : 0);
+    dirty_flags.resize(dirty_flags.size() + max_bit_count, false);
+    bit_expressions.push_back(var_expressions);
+    word_expressions.push_back(nullptr);
+    Touch();
     return var_index;
 }
 
@@ -88,6 +112,7 @@ size_t BitExpressionStates::AddArray(const std::string& name, bool constant, siz
         AddVariable(name, constant, initial_value);
         array_sizes.back() = size;
         array_starts.back() = start_index;
+        display_names.back() = name + "[" + std::to_string(i) + "]";
     }
     return start_index;
 }
@@ -99,29 +124,18 @@ size_t BitExpressionStates::GetVariableCount() const
 
 void BitExpressionStates::SetInputVarConstant(size_t var_index, bool constant)
 {
-    for (size_t bit_number = 0; bit_number < bit_count; ++bit_number)
-    {
-        const size_t bit_index = GetBitIndex(var_index, bit_number);
-        input_bit_constants.at(bit_index) = constant;
-    }
+    SetInputFreeMask(var_index, constant ? 0 : GetWordMask());
 }
 
 bool BitExpressionStates::IsInputVarConstant(size_t var_index) const
 {
-    for (size_t bit_number = 0; bit_number < bit_count; ++bit_number)
-    {
-        const size_t bit_index = GetBitIndex(var_index, bit_number);
-        if (!input_bit_constants.at(bit_index))
-        {
-            return false;
-        }
-    }
-    return true;
+    return input_constant_masks.at(var_index) == GetWordMask();
 }
 
 void BitExpressionStates::SetInputVarValue(size_t var_index, BitExpressionStates::work_type value)
 {
-    input_variables.at(var_index) = value;
+    input_variables.at(var_index) = value & GetWordMask();
+    Touch();
 }
 
 BitExpressionStates::work_type BitExpressionStates::GetInputVarValue(size_t var_index) const
@@ -131,19 +145,74 @@ BitExpressionStates::work_type BitExpressionStates::GetInputVarValue(size_t var_
 
 void BitExpressionStates::SetInputBitConstant(size_t bit_index, bool constant)
 {
-    input_bit_constants.at(bit_index) = constant;
+    const size_t var_index = bit_index / max_bit_count;
+    const work_type mask = static_cast<work_type>(1) << (bit_index % max_bit_count);
+    SetInputFreeMask(var_index, constant ? GetInputFreeMask(var_index) & ~mask : GetInputFreeMask(var_index) | mask);
 }
 
 bool BitExpressionStates::IsInputBitConstant(size_t bit_index) const
 {
-    return input_bit_constants.at(bit_index);
+    return ExtractBit(input_constant_masks.at(bit_index / max_bit_count), bit_index % max_bit_count);
+}
+
+void BitExpressionStates::SetInputFreeMask(size_t var_index, work_type free_mask)
+{
+    input_constant_masks.at(var_index) = ~free_mask & GetWordMask();
+    Touch();
+}
+
+BitExpressionStates::work_type BitExpressionStates::GetInputFreeMask(size_t var_index) const
+{
+    return ~input_constant_masks.at(var_index) & GetWordMask();
+}
+
+void BitExpressionStates::SetInputFreeMasks(size_t first_var_index, size_t var_count, work_type free_mask)
+{
+    if (first_var_index + var_count > input_constant_masks.size())
+        throw std::runtime_error("BitExpressionStates::SetInputFreeMasks(): variable range is out of range");
+
+    std::fill_n(input_constant_masks.begin() + first_var_index, var_count, ~free_mask & GetWordMask());
+    Touch();
+}
+
+bool BitExpressionStates::AreInputVarsConstant(size_t first_var_index, size_t var_count) const
+{
+    if (first_var_index + var_count > input_constant_masks.size())
+        throw std::runtime_error("BitExpressionStates::AreInputVarsConstant(): variable range is out of range");
+
+    const work_type word_mask = GetWordMask();
+    work_type constant = word_mask;
+    for (size_t var_index = first_var_index; var_index < first_var_index + var_count; ++var_index)
+    {
+        constant &= input_constant_masks[var_index];
+    }
+    return constant == word_mask;
+}
+
+size_t BitExpressionStates::GetFreeBitCount(size_t first_var_index, size_t var_count) const
+{
+    if (first_var_index + var_count > input_constant_masks.size())
+        throw std::runtime_error("BitExpressionStates::GetFreeBitCount(): variable range is out of range");
+
+    const work_type word_mask = GetWordMask();
+    size_t result = 0;
+    for (size_t var_index = first_var_index; var_index < first_var_index + var_count; ++var_index)
+    {
+        result += __builtin_popcountll(~input_constant_masks[var_index] & word_mask);
+    }
+    return result;
+}
+
+size_t BitExpressionStates::GetFreeBitCount() const
+{
+    return GetFreeBitCount(0, input_constant_masks.size());
 }
 
 void BitExpressionStates::SetInputBitValue(size_t bit_index, bool value)
 {
-    const size_t var_index = bit_index / bit_count;
-    const size_t bit_number = bit_index % bit_count;
-    const work_type mask = 1 << bit_number;
+    const size_t var_index = bit_index / max_bit_count;
+    const size_t bit_number = bit_index % max_bit_count;
+    const work_type mask = static_cast<work_type>(1) << bit_number;
     if (value)
     {
         input_variables.at(var_index) |= mask;
@@ -152,41 +221,102 @@ void BitExpressionStates::SetInputBitValue(size_t bit_index, bool value)
     {
         input_variables.at(var_index) ^= mask;
     }
+    Touch();
 }
 
 bool BitExpressionStates::GetInputBitValue(size_t bit_index) const
 {
-    const size_t var_index = bit_index / bit_count;
-    const size_t bit_number = bit_index % bit_count;
+    const size_t var_index = bit_index / max_bit_count;
+    const size_t bit_number = bit_index % max_bit_count;
     return ExtractBit(input_variables.at(var_index), bit_number);
 }
 
 void BitExpressionStates::SetBitExpression(size_t bit_index, const std::shared_ptr<IBitExpression>& expresssion)
 {
-    bit_expressions.at(bit_index) = expresssion;
+    BlastWordExpression(bit_index / max_bit_count);
+    if (!GetBitExpression(bit_index)->Equals(expresssion))
+    {
+        GetWritableBitExpression(bit_index) = expresssion;
+        MarkDirty(bit_index);
+    }
 }
 
 std::shared_ptr<IBitExpression> BitExpressionStates::GetBitExpression(size_t bit_index) const
 {
-    return bit_expressions.at(bit_index);
+    const size_t var_index = bit_index / max_bit_count;
+    if (word_expressions.at(var_index))
+    {
+        return word_expressions[var_index]->GetBit(bit_index % max_bit_count);
+    }
+    return bit_expressions[var_index]->at(bit_index % max_bit_count);
+}
+
+void BitExpressionStates::SetWordExpression(size_t var_index, const std::shared_ptr<WordExpression>& expression)
+{
+    if (expression->GetKind() == WordExpressionKind::Bits)
+    {
+        for (size_t bit_number = 0; bit_number < bit_count; ++bit_number)
+        {
+            SetBitExpression(GetBitIndex(var_index, bit_number), expression->GetBit(bit_number));
+        }
+    }
+    else
+    {
+        word_expressions.at(var_index) = expression;
+    }
+}
+
+std::shared_ptr<WordExpression> BitExpressionStates::GetWordExpression(size_t var_index) const
+{
+    if (word_expressions.at(var_index))
+    {
+        return word_expressions[var_index];
+    }
+    WordExpression::bits_type bits;
+    bits.reserve(bit_count);
+    work_type value = 0;
+    bool constant = true;
+    for (size_t bit_number = 0; bit_number < bit_count; ++bit_number)
+    {
+        const std::shared_ptr<IBitExpression>& bit = bit_expressions[var_index]->at(bit_number);
+        if (constant && bit->Constant(*this))
+        {
+            value |= static_cast<work_type>(bit->Calculate(*this) ? 1 : 0) << bit_number;
+        }
+        else
+        {
+            constant = false;
+        }
+        bits.push_back(bit);
+    }
+    return constant ? word_const(value, bit_count) : word_bits(bits);
+}
+
+bool BitExpressionStates::HasWordExpression(size_t var_index) const
+{
+    return word_expressions.at(var_index) != nullptr;
 }
 
 bool BitExpressionStates::IsCurrentBitConstant(size_t bit_index) const
 {
-    return bit_expressions.at(bit_index)->Constant(*this);
+    return GetBitExpression(bit_index)->Constant(*this);
 }
 
 bool BitExpressionStates::GetCurrentBitValue(size_t bit_index) const
 {
-    return bit_expressions.at(bit_index)->Calculate(*this);
+    return GetBitExpression(bit_index)->Calculate(*this);
 }
 
 bool BitExpressionStates::IsCurrentVarConstant(size_t var_index) const
 {
+    if (word_expressions.at(var_index) && word_expressions[var_index]->IsConstant())
+    {
+        return true;
+    }
     for (size_t bit_number = 0; bit_number < bit_count; ++bit_number)
     {
         const size_t bit_index = GetBitIndex(var_index, bit_number);
-        if (!bit_expressions.at(bit_index)->Constant(*this))
+        if (!GetBitExpression(bit_index)->Constant(*this))
         {
             return false;
         }
@@ -199,16 +329,24 @@ BitExpressionStates::work_type BitExpressionStates::GetCurrentVarValue(size_t va
     if (!IsCurrentVarConstant(var_index))
         throw std::runtime_error("BitExpressionStates::GetCurrentVarValue(): variable is not constant");
 
+    if (word_expressions[var_index] && word_expressions[var_index]->IsConstant())
+    {
+        return word_expressions[var_index]->GetValue();
+    }
     return GetOutputVarValue(var_index);
 }
 
 BitExpressionStates::work_type BitExpressionStates::GetOutputVarValue(size_t var_index) const
 {
+    if (word_expressions.at(var_index) && word_expressions[var_index]->IsConstant())
+    {
+        return word_expressions[var_index]->GetValue();
+    }
     work_type result = 0;
     for (size_t bit_number = 0; bit_number < bit_count; ++bit_number)
     {
         const size_t bit_index = GetBitIndex(var_index, bit_number);
-        const work_type bit_value = bit_expressions.at(bit_index)->Calculate(*this) ? 1 : 0;
+        const work_type bit_value = GetBitExpression(bit_index)->Calculate(*this) ? 1 : 0;
         const work_type mask = bit_value << bit_number;
         result |= mask;
     }
@@ -217,15 +355,50 @@ BitExpressionStates::work_type BitExpressionStates::GetOutputVarValue(size_t var
 
 void BitExpressionStates::Optimize()
 {
-    for(size_t i=0; i<bit_expressions.size(); ++i)
+    std::vector<size_t> optimized_bits;
+    optimized_bits.swap(dirty_bits);
+    for (size_t i = 0; i < optimized_bits.size(); ++i)
+    {
+        const size_t bit_index = optimized_bits[i];
+        dirty_flags[bit_index] = false;
+        if (word_expressions[bit_index / max_bit_count])
+        {
+            continue;
+        }
+        std::shared_ptr<IBitExpression> expression = GetBitExpression(bit_index);
+        expression->Optimize(expression, *this);
+        if (!GetBitExpression(bit_index)->Equals(expression))
+        {
+            GetWritableBitExpression(bit_index) = expression;
+        }
+    }
+}
+
+void BitExpressionStates::SetEngine(const std::shared_ptr<IBitExpressionEngine>& engine_)
+{
+    engine = engine_;
+    if (engine)
     {
-        bit_expressions[i]->Optimize(bit_expressions[i], *this);
+        for (size_t var_index = 0; var_index < input_variables.size(); ++var_index)
+        {
+            for (size_t bit_number = 0; bit_number < bit_count; ++bit_number)
+            {
+                const size_t bit_index = GetBitIndex(var_index, bit_number);
+                SetBitExpression(bit_index, engine->Import(GetBitExpression(bit_index)));
+            }
+        }
     }
 }
 
+std::shared_ptr<IBitExpressionEngine> BitExpressionStates::GetEngine() const
+{
+    return engine;
+}
+
 void BitExpressionStates::CopyInputVarValues(const BitExpressionStates& from)
 {
     input_variables = from.input_variables;
+    Touch();
 }
 
 void BitExpressionStates::CopyNames(const BitExpressionStates& from)
@@ -233,445 +406,1216 @@ void BitExpressionStates::CopyNames(const BitExpressionStates& from)
     array_sizes = from.array_sizes;
     array_starts = from.array_starts;
     names = from.names;
+    display_names = from.display_names;
+    name_indexes = from.name_indexes;
 }
 
 void BitExpressionStates::CopyInputConstants(const BitExpressionStates& from)
 {
-    input_bit_constants = from.input_bit_constants;
+    input_constant_masks = from.input_constant_masks;
+    Touch();
 }
 
 void BitExpressionStates::CopyBitExpressions(const BitExpressionStates& from)
 {
-    bit_expressions.clear();
-    for (size_t i = 0; i<from.bit_expressions.size(); ++i)
+    engine = from.engine;
+    bit_expressions = from.bit_expressions;
+    word_expressions = from.word_expressions;
+    dirty_bits = from.dirty_bits;
+    dirty_flags = from.dirty_flags;
+}
+
+uint64_t BitExpressionStates::GetEpoch() const
+{
+    return epoch;
+}
+
+size_t BitExpressionStates::GetDirtyBitCount() const
+{
+    return dirty_bits.size();
+}
+
+void BitExpressionStates::Touch()
+{
+    do
+    {
+        epoch = next_states_epoch++;
+    }
+    while (epoch == 0);
+    for (size_t var_index = 0; var_index < dirty_flags.size() / max_bit_count; ++var_index)
+    {
+        for (size_t bit_number = 0; bit_number < bit_count; ++bit_number)
+        {
+            MarkDirty(GetBitIndex(var_index, bit_number));
+        }
+    }
+}
+
+void BitExpressionStates::MarkDirty(size_t bit_index)
+{
+    if (!dirty_flags[bit_index])
+    {
+        dirty_flags[bit_index] = true;
+        dirty_bits.push_back(bit_index);
+    }
+}
+
+void BitExpressionStates::BlastWordExpression(size_t var_index)
+{
+    std::shared_ptr<WordExpression> expression;
+    expression.swap(word_expressions.at(var_index));
+    if (expression)
+    {
+        for (size_t bit_number = 0; bit_number < bit_count; ++bit_number)
+        {
+            const size_t bit_index = GetBitIndex(var_index, bit_number);
+            GetWritableBitExpression(bit_index) = expression->GetBit(bit_number);
+            MarkDirty(bit_index);
+        }
+    }
+}
+
+std::shared_ptr<IBitExpression>& BitExpressionStates::GetWritableBitExpression(size_t bit_index)
+{
+    std::shared_ptr<var_expressions_type>& var_expressions = bit_expressions.at(bit_index / max_bit_count);
+    if (var_expressions.use_count() > 1)
     {
-        bit_expressions.push_back(from.bit_expressions[i]->DeepCopy());
+        // Pairs with the release by which another thread dropped its share of the chunk
+        std::atomic_thread_fence(std::memory_order_acquire);
+        var_expressions = std::make_shared<var_expressions_type>(*var_expressions);
     }
+    return var_expressions->at(bit_index % max_bit_count);
 }
 
 void BitExpressionStates::Copy(const BitExpressionStates& from)
 {
+    if (bit_count != from.bit_count)
+        throw std::runtime_error("BitExpressionStates::Copy(): word widths differ");
+
     CopyInputVarValues(from);
     CopyNames(from);
     CopyInputConstants(from);
     CopyBitExpressions(from);
+    epoch = from.epoch;
 }
 
-ConstBitExpression::ConstBitExpression(bool value_) : value(value_)
+BitExpressionKey::BitExpressionKey(BitExpressionKind kind_, uint32_t first_, uint32_t second_) : kind(kind_), first(first_), second(second_)
 {
 }
 
-std::string ConstBitExpression::ToString(const BitExpressionStates& info) const
+bool BitExpressionKey::operator==(const BitExpressionKey& other) const
 {
-    return value ? "1" : "0";
+    return kind == other.kind && first == other.first && second == other.second;
 }
 
-bool ConstBitExpression::Constant(const BitExpressionStates& input) const
+size_t BitExpressionKeyHash::operator()(const BitExpressionKey& key) const
 {
-    return true;
+    uint64_t result = static_cast<uint64_t>(key.first) << 32 | key.second;
+    result = (result ^ static_cast<uint64_t>(key.kind)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(result ^ (result >> 32));
 }
 
-bool ConstBitExpression::Calculate(const BitExpressionStates& input) const
+bool BitExpressionFingerprint::operator==(const BitExpressionFingerprint& other) const
 {
-    return value;
+    return low == other.low && high == other.high;
 }
 
-int ConstBitExpression::Priority() const
+BitExpressionFingerprint& BitExpressionFingerprint::operator^=(const BitExpressionFingerprint& other)
 {
-    return 4;
+    low ^= other.low;
+    high ^= other.high;
+    return *this;
 }
 
-std::shared_ptr<IBitExpression> ConstBitExpression::DeepCopy() const
+bool BitExpressionFingerprint::IsEmpty() const
 {
-    return std::make_shared<ConstBitExpression>(value);
+    return !low && !high;
 }
 
-bool ConstBitExpression::Equals(const std::shared_ptr<IBitExpression>& other_) const
-{
-    ConstBitExpression* other = dynamic_cast<ConstBitExpression*>(other_.get());
-    if (other)
-    {
-        return value == other->value;
-    }
-    return false;
-}
+static const uint64_t low_id_salt = 0x9E3779B97F4A7C15ull;
+static const uint64_t high_id_salt = 0xD1B54A32D192ED03ull;
 
-void ConstBitExpression::Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input)
+static uint64_t MixId(uint64_t value)
 {
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
 }
 
-VariableBitExpression::VariableBitExpression(size_t var_index_, size_t bit_number_) : var_index(var_index_), bit_number(bit_number_)
+static uint64_t UnmixId(uint64_t value)
 {
+    value = (value ^ (value >> 31) ^ (value >> 62)) * 0x319642B2D24D8EC3ull;
+    value = (value ^ (value >> 27) ^ (value >> 54)) * 0x96DE1B173F119089ull;
+    return value ^ (value >> 30) ^ (value >> 60);
 }
 
-std::string VariableBitExpression::ToString(const BitExpressionStates& info) const
+// Operands other than Xor nodes hash by id; MixId is invertible, so a fingerprint left with a
+// single operand leads back to its id
+static BitExpressionFingerprint GetIdFingerprint(uint64_t id)
 {
-    return info.GetVarName(var_index) + "." + std::to_string(bit_number);
+    const BitExpressionFingerprint result = { MixId(id ^ low_id_salt), MixId(id ^ high_id_salt) };
+    return result;
 }
 
-bool VariableBitExpression::Constant(const BitExpressionStates& input) const
+static BitExpressionFingerprint GetFingerprint(const IBitExpression* operand)
 {
-    return input.IsInputBitConstant(BitExpressionStates::GetBitIndex(var_index, bit_number));
+    if (operand->GetKind() == BitExpressionKind::Xor)
+    {
+        return static_cast<const XorBitExpression*>(operand)->GetFingerprint();
+    }
+    return GetIdFingerprint(operand->GetId());
 }
 
-bool VariableBitExpression::Calculate(const BitExpressionStates& input) const
+// Collects the operands of the roots that are not Xor nodes, expanding nested Xor nodes. Every node
+// is visited once, parents before operands, so an operand reached an even number of times cancels
+static void ExpandXor(const std::vector<const IBitExpression*>& roots, std::vector<const IBitExpression*>& leaves)
 {
-    return input.GetInputBitValue(BitExpressionStates::GetBitIndex(var_index, bit_number));
+    std::unordered_map<const IBitExpression*, bool> odd;
+    std::vector<const IBitExpression*> order;
+    std::vector<std::pair<const IBitExpression*, size_t> > frames;
+    for (size_t i = 0; i < roots.size(); ++i)
+    {
+        if (!odd.count(roots[i]))
+        {
+            frames.push_back(std::make_pair(roots[i], 0));
+            odd[roots[i]] = false;
+        }
+        while (!frames.empty())
+        {
+            const IBitExpression* node = frames.back().first;
+            if (node->GetKind() == BitExpressionKind::Xor && frames.back().second < node->GetOperandCount())
+            {
+                const IBitExpression* operand = node->GetOperand(frames.back().second++).get();
+                if (!odd.count(operand))
+                {
+                    odd[operand] = false;
+                    frames.push_back(std::make_pair(operand, 0));
+                }
+                continue;
+            }
+            order.push_back(node);
+            frames.pop_back();
+        }
+        odd[roots[i]] = !odd[roots[i]];
+    }
+    for (size_t i = order.size(); i-- > 0;)
+    {
+        const IBitExpression* node = order[i];
+        if (node->GetKind() != BitExpressionKind::Xor)
+        {
+            if (odd[node])
+            {
+                leaves.push_back(node);
+            }
+        }
+        else if (odd[node])
+        {
+            for (size_t j = 0; j < node->GetOperandCount(); ++j)
+            {
+                bool& operand_odd = odd[node->GetOperand(j).get()];
+                operand_odd = !operand_odd;
+            }
+        }
+    }
+    std::sort(leaves.begin(), leaves.end(), [](const IBitExpression* left, const IBitExpression* right) { return left->GetId() < right->GetId(); });
 }
 
-int VariableBitExpression::Priority() const
+static void ExpandXor(const BitExpressionTable::operands_type& operands, std::vector<const IBitExpression*>& leaves)
 {
-    return 4;
+    std::vector<const IBitExpression*> roots;
+    roots.reserve(operands.size());
+    for (size_t i = 0; i < operands.size(); ++i)
+    {
+        roots.push_back(operands[i].get());
+    }
+    ExpandXor(roots, leaves);
 }
 
-std::shared_ptr<IBitExpression> VariableBitExpression::DeepCopy() const
+static bool HasOperands(const IBitExpression* node, const BitExpressionTable::operands_type& operands)
 {
-    return std::make_shared<VariableBitExpression>(var_index, bit_number);
+    if (node->GetOperandCount() != operands.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < operands.size(); ++i)
+    {
+        if (node->GetOperand(i).get() != operands[i].get())
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
-bool VariableBitExpression::Equals(const std::shared_ptr<IBitExpression>& other_) const
+// Another thread may have dropped the last owner of a node that is not erased yet. Its destructors
+// only run after the erase, which waits for the table lock, so the node stays whole while a lookup
+// holding the lock reads it; it is just not returned
+static std::shared_ptr<IBitExpression> Share(IBitExpression* expression)
 {
-    VariableBitExpression* other = dynamic_cast<VariableBitExpression*>(other_.get());
-    if (other)
+    try
     {
-        return var_index == other->var_index && bit_number == other->bit_number;
+        return expression->shared_from_this();
+    }
+    catch (const std::bad_weak_ptr&)
+    {
+        return std::shared_ptr<IBitExpression>();
     }
-    return false;
 }
 
-void VariableBitExpression::Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input)
+std::shared_ptr<IBitExpression> BitExpressionTable::Find(const BitExpressionKey& key)
 {
-    if (Constant(input))
+    auto range = GetNodes().equal_range(key);
+    for (auto found = range.first; found != range.second; ++found)
     {
-        output = const_bool(Calculate(input));
+        std::shared_ptr<IBitExpression> result = Share(found->second);
+        if (result)
+        {
+            return result;
+        }
     }
+    return std::shared_ptr<IBitExpression>();
 }
 
-NegBitExpression::NegBitExpression(const std::shared_ptr<IBitExpression>& argument_) : argument(argument_)
+std::shared_ptr<IBitExpression> BitExpressionTable::Find(const BitExpressionKey& key, const operands_type& operands)
 {
+    auto range = GetNodes().equal_range(key);
+    for (auto found = range.first; found != range.second; ++found)
+    {
+        if (HasOperands(found->second, operands))
+        {
+            std::shared_ptr<IBitExpression> result = Share(found->second);
+            if (result)
+            {
+                return result;
+            }
+        }
+    }
+    return std::shared_ptr<IBitExpression>();
 }
 
-std::string NegBitExpression::ToString(const BitExpressionStates& info) const
+std::shared_ptr<IBitExpression> BitExpressionTable::InternXor(const BitExpressionFingerprint& fingerprint, const operands_type& operands)
 {
-    if (argument->Priority() < Priority())
+    const BitExpressionKey key(BitExpressionKind::Xor, static_cast<uint32_t>(fingerprint.low), static_cast<uint32_t>(fingerprint.low >> 32));
+    std::lock_guard<std::mutex> lock(GetMutex());
+    // Expanded only when a node with the same fingerprint is not built from the same operands
+    std::vector<const IBitExpression*> leaves;
+    bool expanded = false;
+    std::shared_ptr<IBitExpression> result;
+    auto range = GetNodes().equal_range(key);
+    for (auto found = range.first; found != range.second && !result; ++found)
+    {
+        const IBitExpression* node = found->second;
+        if (static_cast<const XorBitExpression*>(node)->GetFingerprint() == fingerprint)
+        {
+            bool equal = HasOperands(node, operands);
+            if (!equal)
+            {
+                if (!expanded)
+                {
+                    ExpandXor(operands, leaves);
+                    expanded = true;
+                }
+                std::vector<const IBitExpression*> node_leaves;
+                ExpandXor(std::vector<const IBitExpression*>(1, node), node_leaves);
+                equal = node_leaves == leaves;
+            }
+            if (equal)
+            {
+                result = Share(found->second);
+            }
+        }
+    }
+    const uint64_t id = UnmixId(fingerprint.low) ^ low_id_salt;
+    const std::vector<IBitExpression*>& nodes_by_id = GetNodesById();
+    if (!result && id < nodes_by_id.size() && nodes_by_id[id] && GetIdFingerprint(id) == fingerprint)
     {
-        return "!(" + argument->ToString(info) + ")";
+        const BitExpressionKind kind = nodes_by_id[id]->GetKind();
+        if (kind != BitExpressionKind::Const && kind != BitExpressionKind::Neg && kind != BitExpressionKind::Xor)
+        {
+            if (!expanded)
+            {
+                ExpandXor(operands, leaves);
+                expanded = true;
+            }
+            if (leaves.size() == 1 && leaves[0] == nodes_by_id[id])
+            {
+                result = Share(nodes_by_id[id]);
+            }
+        }
     }
-    else
+    if (!result)
     {
-        return "!" + argument->ToString(info);
+        result = std::allocate_shared<XorBitExpression>(BitExpressionNodeAllocator<XorBitExpression>(), operands, fingerprint);
+        Insert(result.get());
     }
+    return result;
 }
 
-bool NegBitExpression::Constant(const BitExpressionStates& input) const
+void BitExpressionTable::Insert(IBitExpression* expression)
 {
-    return argument->Constant(input);
+    GetNodes().insert(std::make_pair(expression->GetKey(), expression));
 }
 
-bool NegBitExpression::Calculate(const BitExpressionStates& input) const
+void BitExpressionTable::Erase(const IBitExpression* expression)
 {
-    return !argument->Calculate(input);
+    std::lock_guard<std::mutex> lock(GetMutex());
+    nodes_type& nodes = GetNodes();
+    auto range = nodes.equal_range(expression->GetKey());
+    for (auto found = range.first; found != range.second; ++found)
+    {
+        if (found->second == expression)
+        {
+            nodes.erase(found);
+            GetNodesById()[expression->GetId()] = nullptr;
+            GetFreeIds().push_back(expression->GetId());
+            return;
+        }
+    }
 }
 
-int NegBitExpression::Priority() const
+size_t BitExpressionTable::GetNodeCount()
 {
-    return 3;
+    std::lock_guard<std::mutex> lock(GetMutex());
+    return GetNodes().size();
 }
 
-std::shared_ptr<IBitExpression> NegBitExpression::DeepCopy() const
+BitExpressionTable::nodes_type& BitExpressionTable::GetNodes()
 {
-    return std::make_shared<NegBitExpression>(argument->DeepCopy());
+    // Never destroyed: expressions held by static objects may outlive any static table
+    static nodes_type* nodes = new nodes_type;
+    return *nodes;
 }
 
-bool NegBitExpression::Equals(const std::shared_ptr<IBitExpression>& other_) const
+std::mutex& BitExpressionTable::GetMutex()
 {
-    NegBitExpression* other = dynamic_cast<NegBitExpression*>(other_.get());
-    if (other)
-    {
-        return argument->Equals(other->argument);
-    }
-    return false;
+    static std::mutex* mutex = new std::mutex;
+    return *mutex;
 }
 
-void NegBitExpression::Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input)
+// Ids of erased nodes are reused, so only the live nodes have to fit in 32 bits
+uint32_t BitExpressionTable::TakeId(IBitExpression* expression)
 {
-    argument->Optimize(argument, input);
-    if (Constant(input))
+    std::vector<uint32_t>& free_ids = GetFreeIds();
+    std::vector<IBitExpression*>& nodes_by_id = GetNodesById();
+    if (!free_ids.empty())
     {
-        output = std::make_shared<ConstBitExpression>(Calculate(input));
+        const uint32_t id = free_ids.back();
+        free_ids.pop_back();
+        nodes_by_id[id] = expression;
+        return id;
     }
-    else
+    if (nodes_by_id.size() + 1 > UINT32_MAX)
     {
-        NegBitExpression* argument2 = dynamic_cast<NegBitExpression*>(argument.get());
-        if (argument2)
-        {
-            output = argument2->argument;
-        }
+        throw std::runtime_error("BitExpressionTable::TakeId(): bit expression ids are exhausted");
     }
+    nodes_by_id.push_back(expression);
+    return static_cast<uint32_t>(nodes_by_id.size() - 1);
 }
 
-std::shared_ptr<IBitExpression> NegBitExpression::GetArgument() const
+std::vector<uint32_t>& BitExpressionTable::GetFreeIds()
 {
-    return argument;
+    static std::vector<uint32_t>* free_ids = new std::vector<uint32_t>;
+    return *free_ids;
 }
 
-OrBitExpression::OrBitExpression(const std::shared_ptr<IBitExpression>& left_, const std::shared_ptr<IBitExpression>& right_) : left(left_), right(right_)
+std::vector<IBitExpression*>& BitExpressionTable::GetNodesById()
 {
+    static std::vector<IBitExpression*>* nodes_by_id = new std::vector<IBitExpression*>;
+    return *nodes_by_id;
 }
 
-std::string OrBitExpression::ToString(const BitExpressionStates& info) const
+IBitExpression::IBitExpression(const BitExpressionKey& key_) : key(key_), id(BitExpressionTable::TakeId(this)), optimized_epoch(0)
 {
-    std::string left_str = left->ToString(info);
-    if (left->Priority() < Priority())
-    {
-        left_str = "(" + left_str + ")";
-    }
-    std::string right_str = right->ToString(info);
-    if (right->Priority() < Priority())
-    {
-        right_str = "(" + right_str + ")";
-    }
-    return left_str + "+" + right_str;
 }
 
-bool OrBitExpression::Constant(const BitExpressionStates& input) const
+IBitExpression::~IBitExpression()
 {
-    return left->Constant(input) && right->Constant(input);
 }
 
-bool OrBitExpression::Calculate(const BitExpressionStates& input) const
+IBitExpressionEngine* IBitExpression::GetEngine() const
 {
-    return left->Calculate(input) || right->Calculate(input);
+    return nullptr;
 }
 
-int OrBitExpression::Priority() const
+bool IBitExpression::Equals(const std::shared_ptr<IBitExpression>& other) const
 {
-    return 0;
+    return other.get() == this;
 }
 
-std::shared_ptr<IBitExpression> OrBitExpression::DeepCopy() const
+bool IBitExpression::IsOptimized(const BitExpressionStates& input) const
 {
-    return std::make_shared<OrBitExpression>(left->DeepCopy(), right->DeepCopy());
+    return optimized_epoch.load(std::memory_order_relaxed) == input.GetEpoch();
 }
 
-bool OrBitExpression::Equals(const std::shared_ptr<IBitExpression>& other_) const
+void IBitExpression::SetOptimized(const BitExpressionStates& input) const
 {
-    OrBitExpression* other = dynamic_cast<OrBitExpression*>(other_.get());
-    if (other)
-    {
-        return left->Equals(other->left) && right->Equals(other->right) || left->Equals(other->right) && right->Equals(other->left);
-    }
-    return false;
+    optimized_epoch.store(input.GetEpoch(), std::memory_order_relaxed);
 }
 
-void OrBitExpression::Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input)
+size_t IBitExpression::GetOperandCount() const
 {
-    left->Optimize(left, input);
-    right->Optimize(right, input);
-    if (Constant(input))
-    {
-        output = std::make_shared<ConstBitExpression>(Calculate(input));
-    }
-    else if (left->Constant(input))
-    {
-        if (left->Calculate(input))
-        {
-            output = std::make_shared<ConstBitExpression>(true);
-        }
-        else
+    return 0;
+}
+
+const std::shared_ptr<IBitExpression>& IBitExpression::GetOperand(size_t) const
+{
+    throw std::runtime_error("IBitExpression::GetOperand(): bit expression has no operands");
+}
+
+BitExpressionKind IBitExpression::GetKind() const
+{
+    return key.kind;
+}
+
+const BitExpressionKey& IBitExpression::GetKey() const
+{
+    return key;
+}
+
+uint32_t IBitExpression::GetId() const
+{
+    return id;
+}
+
+IBitExpressionSink::~IBitExpressionSink()
+{
+}
+
+static std::atomic<uint32_t> next_engine_id(0);
+
+IBitExpressionEngine::IBitExpressionEngine() : engine_id(next_engine_id++)
+{
+}
+
+IBitExpressionEngine::~IBitExpressionEngine()
+{
+}
+
+std::shared_ptr<IBitExpression> IBitExpressionEngine::Import(const std::shared_ptr<IBitExpression>& expression)
+{
+    IBitExpressionEngine* engine = expression->GetEngine();
+    if (engine == this)
+    {
+        return expression;
+    }
+    if (engine)
+        throw std::runtime_error("IBitExpressionEngine::Import(): bit expression belongs to another engine");
+
+    std::unordered_map<const IBitExpression*, std::shared_ptr<IBitExpression> > imported;
+    std::vector<const IBitExpression*> nodes;
+    nodes.push_back(expression.get());
+    while (!nodes.empty())
+    {
+        const IBitExpression* node = nodes.back();
+        if (imported.count(node))
+        {
+            nodes.pop_back();
+            continue;
+        }
+        if (node->GetEngine() == this)
         {
-            output = right;
+            imported[node] = std::const_pointer_cast<IBitExpression>(node->shared_from_this());
+            nodes.pop_back();
+            continue;
         }
+        if (node->GetEngine())
+            throw std::runtime_error("IBitExpressionEngine::Import(): bit expression belongs to another engine");
+
+        bool ready = true;
+        for (size_t i = 0; i < node->GetOperandCount(); ++i)
+        {
+            const IBitExpression* operand = node->GetOperand(i).get();
+            if (!imported.count(operand))
+            {
+                nodes.push_back(operand);
+                ready = false;
+            }
+        }
+        if (!ready)
+        {
+            continue;
+        }
+        const BitExpressionKey& key = node->GetKey();
+        std::shared_ptr<IBitExpression> result;
+        switch (key.kind)
+        {
+        case BitExpressionKind::Const:
+            result = Const(key.first != 0);
+            break;
+        case BitExpressionKind::Variable:
+            result = Variable(key.first, key.second);
+            break;
+        case BitExpressionKind::Neg:
+            result = Neg(imported[node->GetOperand(0).get()]);
+            break;
+        case BitExpressionKind::Or:
+        case BitExpressionKind::And:
+        case BitExpressionKind::Xor:
+            result = imported[node->GetOperand(0).get()];
+            for (size_t i = 1; i < node->GetOperandCount(); ++i)
+            {
+                const std::shared_ptr<IBitExpression>& operand = imported[node->GetOperand(i).get()];
+                result = key.kind == BitExpressionKind::Or ? Or(result, operand) : key.kind == BitExpressionKind::And ? And(result, operand) : Xor(result, operand);
+            }
+            break;
+        default:
+            throw std::runtime_error("IBitExpressionEngine::Import(): unknown bit expression");
+        }
+        imported[node] = result;
+        nodes.pop_back();
+    }
+    return imported[expression.get()];
+}
+
+uint32_t IBitExpressionEngine::GetEngineId() const
+{
+    return engine_id;
+}
+
+static IBitExpressionEngine* SelectEngine(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
+{
+    IBitExpressionEngine* left_engine = left->GetEngine();
+    IBitExpressionEngine* right_engine = right->GetEngine();
+    if (left_engine && right_engine && left_engine != right_engine)
+        throw std::runtime_error("SelectEngine(): bit expressions belong to different engines");
+    return left_engine ? left_engine : right_engine;
+}
+
+ConstBitExpression::ConstBitExpression(bool value_) : IBitExpression(BitExpressionKey(BitExpressionKind::Const, value_ ? 1 : 0, 0)), value(value_)
+{
+}
+
+std::string ConstBitExpression::ToString(const BitExpressionStates& info) const
+{
+    return value ? "1" : "0";
+}
+
+bool ConstBitExpression::Constant(const BitExpressionStates& input) const
+{
+    return true;
+}
+
+bool ConstBitExpression::Calculate(const BitExpressionStates& input) const
+{
+    return value;
+}
+
+int ConstBitExpression::Priority() const
+{
+    return 4;
+}
+
+void ConstBitExpression::Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) const
+{
+}
+
+VariableBitExpression::VariableBitExpression(size_t var_index_, size_t bit_number_)
+    : IBitExpression(BitExpressionKey(BitExpressionKind::Variable, static_cast<uint32_t>(var_index_), static_cast<uint32_t>(bit_number_))), var_index(var_index_), bit_number(bit_number_)
+{
+}
+
+std::string VariableBitExpression::ToString(const BitExpressionStates& info) const
+{
+    return info.GetVarName(var_index) + "." + std::to_string(bit_number);
+}
+
+bool VariableBitExpression::Constant(const BitExpressionStates& input) const
+{
+    return input.IsInputBitConstant(BitExpressionStates::GetBitIndex(var_index, bit_number));
+}
+
+bool VariableBitExpression::Calculate(const BitExpressionStates& input) const
+{
+    return input.GetInputBitValue(BitExpressionStates::GetBitIndex(var_index, bit_number));
+}
+
+int VariableBitExpression::Priority() const
+{
+    return 4;
+}
+
+void VariableBitExpression::Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) const
+{
+    if (Constant(input))
+    {
+        output = const_bool(Calculate(input));
     }
-    else if (right->Constant(input))
+}
+
+// Explicit stacks are pooled per thread so traversals allocate nothing once warm and may nest safely
+template<typename T>
+struct TraversalStack
+{
+    TraversalStack() : items(Acquire())
+    {
+    }
+
+    ~TraversalStack()
     {
-        if (right->Calculate(input))
+        items->clear();
+        Pool* pool = GetPool();
+        if (pool)
         {
-            output = std::make_shared<ConstBitExpression>(true);
+            pool->stacks.push_back(items);
         }
         else
         {
-            output = left;
+            delete items;
         }
     }
-    else
+
+    std::vector<T>& operator*()
     {
-        if (left->Equals(right))
+        return *items;
+    }
+private:
+    struct Pool
+    {
+        ~Pool()
         {
-            output = left;
+            for (size_t i = 0; i < stacks.size(); ++i)
+            {
+                delete stacks[i];
+            }
+            stacks.clear();
+            destroyed = true;
         }
-        else
+
+        std::vector<std::vector<T>*> stacks;
+    };
+
+    // Expressions released by other thread-local destructors may still traverse after the pool is gone
+    static Pool* GetPool()
+    {
+        static thread_local Pool pool;
+        return destroyed ? nullptr : &pool;
+    }
+
+    static std::vector<T>* Acquire()
+    {
+        Pool* pool = GetPool();
+        if (!pool || pool->stacks.empty())
+        {
+            return new std::vector<T>;
+        }
+        std::vector<T>* result = pool->stacks.back();
+        pool->stacks.pop_back();
+        return result;
+    }
+
+    static thread_local bool destroyed;
+
+    std::vector<T>* items;
+};
+
+template<typename T>
+thread_local bool TraversalStack<T>::destroyed = false;
+
+struct OperatorFrame
+{
+    const OperatorBitExpression* node;
+    size_t next;
+};
+
+struct OptimizeFrame
+{
+    const OperatorBitExpression* node;
+    const std::shared_ptr<IBitExpression>* owner;
+    size_t next;
+};
+
+static const size_t max_release_depth = 256;
+static thread_local size_t release_depth = 0;
+static thread_local std::vector<std::shared_ptr<IBitExpression> >* released = nullptr;
+
+// Destructors release operands directly up to max_release_depth nested levels; deeper operands are
+// queued and destroyed by the outermost release of the same thread, so long operand chains do not
+// exhaust the call stack
+static void ReleaseOperand(std::shared_ptr<IBitExpression>& operand)
+{
+    if (release_depth >= max_release_depth)
+    {
+        if (operand.use_count() == 1)
+        {
+            if (!released)
+            {
+                released = new std::vector<std::shared_ptr<IBitExpression> >;
+            }
+            released->push_back(std::move(operand));
+        }
+        return;
+    }
+    ++release_depth;
+    operand.reset();
+    if (release_depth == 1 && released)
+    {
+        while (!released->empty())
+        {
+            std::shared_ptr<IBitExpression> expression = std::move(released->back());
+            released->pop_back();
+            expression.reset();
+        }
+        delete released;
+        released = nullptr;
+    }
+    --release_depth;
+}
+
+OperatorBitExpression::OperatorBitExpression(const BitExpressionKey& key)
+    : IBitExpression(key), constant_memo(0), calculate_memo(0)
+{
+}
+
+std::string OperatorBitExpression::ToString(const BitExpressionStates& info) const
+{
+    TraversalStack<OperatorFrame> frame_stack;
+    TraversalStack<std::string> string_stack;
+    std::vector<OperatorFrame>& frames = *frame_stack;
+    std::vector<std::string>& strings = *string_stack;
+    OperatorFrame root = { this, 0 };
+    frames.push_back(root);
+    while (!frames.empty())
+    {
+        const OperatorBitExpression* node = frames.back().node;
+        const size_t count = node->GetOperandCount();
+        if (frames.back().next < count)
         {
-            NegBitExpression* argument2 = dynamic_cast<NegBitExpression*>(left.get());
-            if (argument2 && argument2->GetArgument()->Equals(right))
+            const IBitExpression* operand = node->GetOperand(frames.back().next++).get();
+            const OperatorBitExpression* operator_operand = AsOperator(operand);
+            if (operator_operand)
             {
-                output = std::make_shared<ConstBitExpression>(true);
+                OperatorFrame frame = { operator_operand, 0 };
+                frames.push_back(frame);
             }
             else
             {
-                argument2 = dynamic_cast<NegBitExpression*>(right.get());
-                if (argument2 && argument2->GetArgument()->Equals(left))
-                {
-                    output = std::make_shared<ConstBitExpression>(true);
-                }
+                strings.push_back(operand->ToString(info));
+            }
+            continue;
+        }
+        std::string text = node->Format(strings.data() + strings.size() - count);
+        strings.resize(strings.size() - count);
+        strings.push_back(std::move(text));
+        frames.pop_back();
+    }
+    return strings.back();
+}
+
+bool OperatorBitExpression::Constant(const BitExpressionStates& input) const
+{
+    const uint64_t epoch = input.GetEpoch();
+    bool value;
+    if (ReadMemo(constant_memo, epoch, value))
+    {
+        return value;
+    }
+    if (OperandsReady(&OperatorBitExpression::constant_memo, epoch))
+    {
+        value = ConstantOperands(input);
+        constant_memo.store(MakeMemo(epoch, value), std::memory_order_relaxed);
+        return value;
+    }
+    TraversalStack<const OperatorBitExpression*> node_stack;
+    std::vector<const OperatorBitExpression*>& nodes = *node_stack;
+    nodes.push_back(this);
+    while (!nodes.empty())
+    {
+        const OperatorBitExpression* node = nodes.back();
+        if (ReadMemo(node->constant_memo, epoch, value))
+        {
+            nodes.pop_back();
+            continue;
+        }
+        bool ready = true;
+        for (size_t i = 0; i < node->GetOperandCount(); ++i)
+        {
+            const OperatorBitExpression* operand = AsOperator(node->GetOperand(i).get());
+            if (operand && !ReadMemo(operand->constant_memo, epoch, value))
+            {
+                nodes.push_back(operand);
+                ready = false;
+            }
+        }
+        if (!ready)
+        {
+            continue;
+        }
+        node->constant_memo.store(MakeMemo(epoch, node->ConstantOperands(input)), std::memory_order_relaxed);
+        nodes.pop_back();
+    }
+    // Another thread may have overwritten the memo meanwhile; the operands are memoized by now
+    return ReadMemo(constant_memo, epoch, value) ? value : ConstantOperands(input);
+}
+
+bool OperatorBitExpression::Calculate(const BitExpressionStates& input) const
+{
+    const uint64_t epoch = input.GetEpoch();
+    bool value;
+    if (ReadMemo(calculate_memo, epoch, value))
+    {
+        return value;
+    }
+    if (OperandsReady(&OperatorBitExpression::calculate_memo, epoch))
+    {
+        value = Evaluate(input);
+        calculate_memo.store(MakeMemo(epoch, value), std::memory_order_relaxed);
+        return value;
+    }
+    TraversalStack<const OperatorBitExpression*> node_stack;
+    std::vector<const OperatorBitExpression*>& nodes = *node_stack;
+    nodes.push_back(this);
+    while (!nodes.empty())
+    {
+        const OperatorBitExpression* node = nodes.back();
+        if (ReadMemo(node->calculate_memo, epoch, value))
+        {
+            nodes.pop_back();
+            continue;
+        }
+        bool ready = true;
+        for (size_t i = 0; i < node->GetOperandCount(); ++i)
+        {
+            const OperatorBitExpression* operand = AsOperator(node->GetOperand(i).get());
+            if (operand && !ReadMemo(operand->calculate_memo, epoch, value))
+            {
+                nodes.push_back(operand);
+                ready = false;
+            }
+        }
+        if (!ready)
+        {
+            continue;
+        }
+        node->calculate_memo.store(MakeMemo(epoch, node->Evaluate(input)), std::memory_order_relaxed);
+        nodes.pop_back();
+    }
+    // Another thread may have overwritten the memo meanwhile; the operands are memoized by now
+    return ReadMemo(calculate_memo, epoch, value) ? value : Evaluate(input);
+}
+
+void OperatorBitExpression::Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) const
+{
+    if (IsOptimized(input))
+    {
+        return;
+    }
+    TraversalStack<OptimizeFrame> frame_stack;
+    TraversalStack<std::shared_ptr<IBitExpression> > result_stack;
+    std::vector<OptimizeFrame>& frames = *frame_stack;
+    std::vector<std::shared_ptr<IBitExpression> >& results = *result_stack;
+    OptimizeFrame root = { this, &output, 0 };
+    frames.push_back(root);
+    while (!frames.empty())
+    {
+        const OperatorBitExpression* node = frames.back().node;
+        const size_t count = node->GetOperandCount();
+        if (frames.back().next < count)
+        {
+            const std::shared_ptr<IBitExpression>& operand = node->GetOperand(frames.back().next++);
+            const OperatorBitExpression* operator_operand = AsOperator(operand.get());
+            if (operator_operand && !operator_operand->IsOptimized(input))
+            {
+                OptimizeFrame frame = { operator_operand, &operand, 0 };
+                frames.push_back(frame);
+            }
+            else
+            {
+                results.push_back(operand);
+                operand->Optimize(results.back(), input);
             }
+            continue;
         }
+        std::shared_ptr<IBitExpression> result;
+        node->Rebuild(result, results.data() + results.size() - count, input);
+        if (!result || result.get() == node)
+        {
+            result = *frames.back().owner;
+            node->SetOptimized(input);
+        }
+        results.resize(results.size() - count);
+        results.push_back(result);
+        frames.pop_back();
     }
+    output = results.back();
 }
 
-std::shared_ptr<IBitExpression> OrBitExpression::GetLeftArgument() const
+uint64_t OperatorBitExpression::MakeMemo(uint64_t epoch, bool value)
 {
-    return left;
+    return epoch << 1 | (value ? 1 : 0);
 }
 
-std::shared_ptr<IBitExpression> OrBitExpression::GetRightArgument() const
+bool OperatorBitExpression::ReadMemo(const std::atomic<uint64_t>& memo, uint64_t epoch, bool& value)
 {
-    return right;
+    const uint64_t word = memo.load(std::memory_order_relaxed);
+    if (word >> 1 != epoch)
+    {
+        return false;
+    }
+    value = (word & 1) != 0;
+    return true;
 }
 
-AndBitExpression::AndBitExpression(const std::shared_ptr<IBitExpression>& left_, const std::shared_ptr<IBitExpression>& right_) : left(left_), right(right_)
+bool OperatorBitExpression::OperandsReady(std::atomic<uint64_t> OperatorBitExpression::* memo, uint64_t epoch) const
 {
+    bool value;
+    for (size_t i = 0; i < GetOperandCount(); ++i)
+    {
+        const OperatorBitExpression* operand = AsOperator(GetOperand(i).get());
+        if (operand && !ReadMemo(operand->*memo, epoch, value))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OperatorBitExpression::ConstantOperands(const BitExpressionStates& input) const
+{
+    for (size_t i = 0; i < GetOperandCount(); ++i)
+    {
+        const IBitExpression* operand = GetOperand(i).get();
+        const OperatorBitExpression* operator_operand = AsOperator(operand);
+        bool constant;
+        if (!operator_operand || !ReadMemo(operator_operand->constant_memo, input.GetEpoch(), constant))
+        {
+            constant = operand->Constant(input);
+        }
+        if (!constant)
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
-std::string AndBitExpression::ToString(const BitExpressionStates& info) const
+bool OperatorBitExpression::GetOperandValue(size_t index, const BitExpressionStates& input) const
 {
-    std::string left_str = left->ToString(info);
-    if (left->Priority() < Priority())
+    const IBitExpression* operand = GetOperand(index).get();
+    const OperatorBitExpression* operator_operand = AsOperator(operand);
+    bool value;
+    if (operator_operand && ReadMemo(operator_operand->calculate_memo, input.GetEpoch(), value))
     {
-        left_str = "(" + left_str + ")";
+        return value;
     }
-    std::string right_str = right->ToString(info);
-    if (right->Priority() < Priority())
+    return operand->Calculate(input);
+}
+
+const OperatorBitExpression* OperatorBitExpression::AsOperator(const IBitExpression* expression)
+{
+    switch (expression->GetKind())
     {
-        right_str = "(" + right_str + ")";
+    case BitExpressionKind::Neg:
+    case BitExpressionKind::Or:
+    case BitExpressionKind::And:
+    case BitExpressionKind::Xor:
+        return static_cast<const OperatorBitExpression*>(expression);
+    default:
+        return nullptr;
     }
-    return left_str + "*" + right_str;
 }
 
-bool AndBitExpression::Constant(const BitExpressionStates& input) const
+NegBitExpression::NegBitExpression(const std::shared_ptr<IBitExpression>& argument_)
+    : OperatorBitExpression(BitExpressionKey(BitExpressionKind::Neg, argument_->GetId(), 0)), argument(argument_)
 {
-    return left->Constant(input) && right->Constant(input);
 }
 
-bool AndBitExpression::Calculate(const BitExpressionStates& input) const
+NegBitExpression::~NegBitExpression()
 {
-    return left->Calculate(input) && right->Calculate(input);
+    ReleaseOperand(argument);
 }
 
-int AndBitExpression::Priority() const
+int NegBitExpression::Priority() const
 {
-    return 2;
+    return 3;
 }
 
-std::shared_ptr<IBitExpression> AndBitExpression::DeepCopy() const
+size_t NegBitExpression::GetOperandCount() const
 {
-    return std::make_shared<AndBitExpression>(left->DeepCopy(), right->DeepCopy());
+    return 1;
 }
 
-bool AndBitExpression::Equals(const std::shared_ptr<IBitExpression>& other_) const
+const std::shared_ptr<IBitExpression>& NegBitExpression::GetOperand(size_t) const
 {
-    AndBitExpression* other = dynamic_cast<AndBitExpression*>(other_.get());
-    if (other)
+    return argument;
+}
+
+std::shared_ptr<IBitExpression> NegBitExpression::GetArgument() const
+{
+    return argument;
+}
+
+std::string NegBitExpression::Format(const std::string* operand_strings) const
+{
+    if (argument->Priority() < Priority())
     {
-        return left->Equals(other->left) && right->Equals(other->right) || left->Equals(other->right) && right->Equals(other->left);
+        return "!(" + operand_strings[0] + ")";
+    }
+    else
+    {
+        return "!" + operand_strings[0];
     }
-    return false;
 }
 
-void AndBitExpression::Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input)
+bool NegBitExpression::Evaluate(const BitExpressionStates& input) const
 {
-    left->Optimize(left, input);
-    right->Optimize(right, input);
-    if (Constant(input))
+    return !GetOperandValue(0, input);
+}
+
+void NegBitExpression::Rebuild(std::shared_ptr<IBitExpression>& output, const std::shared_ptr<IBitExpression>* operands, const BitExpressionStates& input) const
+{
+    const std::shared_ptr<IBitExpression>& new_argument = operands[0];
+    if (new_argument->Constant(input))
     {
-        output = std::make_shared<ConstBitExpression>(Calculate(input));
+        output = const_bool(!new_argument->Calculate(input));
     }
-    else if (left->Constant(input))
+    else
     {
-        if (!left->Calculate(input))
+        NegBitExpression* argument2 = dynamic_cast<NegBitExpression*>(new_argument.get());
+        if (argument2)
         {
-            output = std::make_shared<ConstBitExpression>(false);
+            output = argument2->argument;
         }
-        else
+        else if (!new_argument->Equals(argument))
         {
-            output = right;
+            output = ~new_argument;
         }
     }
-    else if (right->Constant(input))
+}
+
+AssociativeBitExpression::AssociativeBitExpression(const BitExpressionKey& key, const BitExpressionTable::operands_type& operands_)
+    : OperatorBitExpression(key), operands(operands_.begin(), operands_.end())
+{
+}
+
+AssociativeBitExpression::~AssociativeBitExpression()
+{
+    for (size_t i = 0; i < operands.size(); ++i)
+    {
+        ReleaseOperand(operands[i]);
+    }
+}
+
+size_t AssociativeBitExpression::GetOperandCount() const
+{
+    return operands.size();
+}
+
+const std::shared_ptr<IBitExpression>& AssociativeBitExpression::GetOperand(size_t index) const
+{
+    return operands[index];
+}
+
+BitExpressionKey AssociativeBitExpression::MakeKey(BitExpressionKind kind, const BitExpressionTable::operands_type& operands)
+{
+    uint64_t hash = 0;
+    for (size_t i = 0; i < operands.size(); ++i)
+    {
+        hash = (hash ^ operands[i]->GetId()) * 0x9E3779B97F4A7C15ull;
+    }
+    return BitExpressionKey(kind, static_cast<uint32_t>(hash ^ (hash >> 32)), static_cast<uint32_t>(operands.size()));
+}
+
+std::string AssociativeBitExpression::Format(const std::string* operand_strings) const
+{
+    std::string result;
+    for (size_t i = 0; i < operands.size(); ++i)
     {
-        if (!right->Calculate(input))
+        if (i)
         {
-            output = std::make_shared<ConstBitExpression>(false);
+            result += GetSymbol();
+        }
+        if (operands[i]->Priority() < Priority())
+        {
+            result += "(" + operand_strings[i] + ")";
         }
         else
         {
-            output = left;
+            result += operand_strings[i];
         }
     }
-    else
+    return result;
+}
+
+void AssociativeBitExpression::Rebuild(std::shared_ptr<IBitExpression>& output, const std::shared_ptr<IBitExpression>* new_operands, const BitExpressionStates& input) const
+{
+    bool changed = false;
+    for (size_t i = 0; i < operands.size() && !changed; ++i)
     {
-        if (left->Equals(right))
+        changed = !new_operands[i]->Equals(operands[i]) || new_operands[i]->Constant(input);
+    }
+    if (!changed)
+    {
+        return;
+    }
+    BitExpressionTable::operands_type rebuilt(new_operands, new_operands + operands.size());
+    for (size_t i = 0; i < rebuilt.size(); ++i)
+    {
+        if (rebuilt[i]->Constant(input))
         {
-            output = left;
+            rebuilt[i] = const_bool(rebuilt[i]->Calculate(input));
         }
-        else
+    }
+    output = associative_bits(GetKind(), rebuilt);
+}
+
+OrBitExpression::OrBitExpression(const BitExpressionTable::operands_type& operands)
+    : AssociativeBitExpression(MakeKey(BitExpressionKind::Or, operands), operands)
+{
+}
+
+int OrBitExpression::Priority() const
+{
+    return 0;
+}
+
+bool OrBitExpression::Evaluate(const BitExpressionStates& input) const
+{
+    for (size_t i = 0; i < GetOperandCount(); ++i)
+    {
+        if (GetOperandValue(i, input))
         {
-            NegBitExpression* argument2 = dynamic_cast<NegBitExpression*>(left.get());
-            if (argument2 && argument2->GetArgument()->Equals(right))
-            {
-                output = std::make_shared<ConstBitExpression>(false);
-            }
-            else
-            {
-                argument2 = dynamic_cast<NegBitExpression*>(right.get());
-                if (argument2 && argument2->GetArgument()->Equals(left))
-                {
-                    output = std::make_shared<ConstBitExpression>(false);
-                }
-            }
+            return true;
         }
     }
+    return false;
 }
 
-std::shared_ptr<IBitExpression> AndBitExpression::GetLeftArgument() const
+const char* OrBitExpression::GetSymbol() const
 {
-    return left;
+    return "+";
 }
 
-std::shared_ptr<IBitExpression> AndBitExpression::GetRightArgument() const
+AndBitExpression::AndBitExpression(const BitExpressionTable::operands_type& operands)
+    : AssociativeBitExpression(MakeKey(BitExpressionKind::And, operands), operands)
 {
-    return right;
 }
 
-XorBitExpression::XorBitExpression(const std::shared_ptr<IBitExpression>& left_, const std::shared_ptr<IBitExpression>& right_) : left(left_), right(right_)
+int AndBitExpression::Priority() const
 {
+    return 2;
 }
 
-std::string XorBitExpression::ToString(const BitExpressionStates& info) const
+bool AndBitExpression::Evaluate(const BitExpressionStates& input) const
 {
-    std::string left_str = left->ToString(info);
-    if (left->Priority() < Priority())
+    for (size_t i = 0; i < GetOperandCount(); ++i)
     {
-        left_str = "(" + left_str + ")";
-    }
-    std::string right_str = right->ToString(info);
-    if (right->Priority() < Priority())
-    {
-        right_str = "(" + right_str + ")";
+        if (!GetOperandValue(i, input))
+        {
+            return false;
+        }
     }
-    return left_str + "^" + right_str;
+    return true;
 }
 
-bool XorBitExpression::Constant(const BitExpressionStates& input) const
+const char* AndBitExpression::GetSymbol() const
 {
-    return left->Constant(input) && right->Constant(input);
+    return "*";
 }
 
-bool XorBitExpression::Calculate(const BitExpressionStates& input) const
+XorBitExpression::XorBitExpression(const BitExpressionTable::operands_type& operands, const BitExpressionFingerprint& fingerprint_)
+    : AssociativeBitExpression(BitExpressionKey(BitExpressionKind::Xor, static_cast<uint32_t>(fingerprint_.low), static_cast<uint32_t>(fingerprint_.low >> 32)), operands),
+    fingerprint(fingerprint_)
 {
-    const bool left_value = left->Calculate(input);
-    const bool right_value = right->Calculate(input);
-    return (left_value || right_value) && (!(left_value && right_value));
 }
 
 int XorBitExpression::Priority() const
@@ -679,100 +1623,240 @@ int XorBitExpression::Priority() const
     return 1;
 }
 
-std::shared_ptr<IBitExpression> XorBitExpression::DeepCopy() const
+const BitExpressionFingerprint& XorBitExpression::GetFingerprint() const
 {
-    return std::make_shared<XorBitExpression>(left->DeepCopy(), right->DeepCopy());
+    return fingerprint;
 }
 
-bool XorBitExpression::Equals(const std::shared_ptr<IBitExpression>& other_) const
+bool XorBitExpression::Evaluate(const BitExpressionStates& input) const
 {
-    XorBitExpression* other = dynamic_cast<XorBitExpression*>(other_.get());
-    if (other)
+    bool result = false;
+    for (size_t i = 0; i < GetOperandCount(); ++i)
     {
-        return left->Equals(other->left) && right->Equals(other->right) || left->Equals(other->right) && right->Equals(other->left);
+        result = result != GetOperandValue(i, input);
     }
-    return false;
+    return result;
 }
 
-void XorBitExpression::Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input)
+const char* XorBitExpression::GetSymbol() const
 {
-    left->Optimize(left, input);
-    right->Optimize(right, input);
-    if (Constant(input))
+    return "^";
+}
+
+std::shared_ptr<IBitExpression> const_bool(bool value)
+{
+    return BitExpressionTable::Intern<ConstBitExpression>(BitExpressionKey(BitExpressionKind::Const, value ? 1 : 0, 0), value);
+}
+
+std::shared_ptr<IBitExpression> variable_bit(size_t var_index, size_t bit_number)
+{
+    return BitExpressionTable::Intern<VariableBitExpression>(BitExpressionKey(BitExpressionKind::Variable, static_cast<uint32_t>(var_index), static_cast<uint32_t>(bit_number)), var_index, bit_number);
+}
+
+static bool IdLess(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
+{
+    return left->GetId() < right->GetId();
+}
+
+// Nested Xor nodes are merged into their parent only while it stays this small. Larger sets keep
+// them as operands, so sums accumulated over many rounds stay shared instead of being copied into
+// every node; they are still matched by their expanded operand sets, so the same set gives the same node
+static const size_t max_flattened_xor_operands = 64;
+
+std::shared_ptr<IBitExpression> associative_bits(BitExpressionKind kind, const BitExpressionTable::operands_type& operands)
+{
+    if (kind != BitExpressionKind::Or && kind != BitExpressionKind::And && kind != BitExpressionKind::Xor)
+        throw std::runtime_error("associative_bits(): bit expression kind is not associative");
+
+    IBitExpressionEngine* engine = nullptr;
+    for (size_t i = 0; i < operands.size(); ++i)
     {
-        output = std::make_shared<ConstBitExpression>(Calculate(input));
+        IBitExpressionEngine* operand_engine = operands[i]->GetEngine();
+        if (engine && operand_engine && engine != operand_engine)
+            throw std::runtime_error("associative_bits(): bit expressions belong to different engines");
+        engine = engine ? engine : operand_engine;
     }
-    else if (left->Equals(right))
+    const bool is_xor = kind == BitExpressionKind::Xor;
+    const bool absorbing = kind == BitExpressionKind::Or;
+    if (engine)
     {
-        output = std::make_shared<ConstBitExpression>(false);
+        if (operands.empty())
+        {
+            return engine->Const(is_xor ? false : !absorbing);
+        }
+        std::shared_ptr<IBitExpression> result = operands[0];
+        for (size_t i = 1; i < operands.size(); ++i)
+        {
+            result = is_xor ? engine->Xor(result, operands[i]) : absorbing ? engine->Or(result, operands[i]) : engine->And(result, operands[i]);
+        }
+        return result;
     }
-    else
+
+    // Operand lists of merged nodes are already sorted runs; only the loose operands are sorted, then
+    // the runs are merged in linear time
+    TraversalStack<std::shared_ptr<IBitExpression> > flat_stack;
+    std::vector<std::shared_ptr<IBitExpression> >& flat = *flat_stack;
+    TraversalStack<std::shared_ptr<IBitExpression> > loose_stack;
+    std::vector<std::shared_ptr<IBitExpression> >& loose = *loose_stack;
+    TraversalStack<size_t> run_stack;
+    std::vector<size_t>& run_ends = *run_stack;
+    bool negated = false;
+    for (size_t i = 0; i < operands.size(); ++i)
     {
-        NegBitExpression* argument2 = dynamic_cast<NegBitExpression*>(left.get());
-        if (argument2 && argument2->GetArgument()->Equals(right))
+        const std::shared_ptr<IBitExpression>* operand = &operands[i];
+        while (is_xor && (*operand)->GetKind() == BitExpressionKind::Neg)
         {
-            output = std::make_shared<ConstBitExpression>(true);
+            negated = !negated;
+            operand = &(*operand)->GetOperand(0);
         }
-        else
+        const IBitExpression* node = operand->get();
+        if (node->GetKind() == BitExpressionKind::Const)
         {
-            argument2 = dynamic_cast<NegBitExpression*>(right.get());
-            if (argument2 && argument2->GetArgument()->Equals(left))
+            const bool value = node->GetKey().first != 0;
+            if (is_xor)
             {
-                output = std::make_shared<ConstBitExpression>(true);
+                negated = negated != value;
             }
-            else if (left->Constant(input) && !left->Calculate(input))
+            else if (value == absorbing)
             {
-                output = right;
+                return const_bool(absorbing);
             }
-            else if (right->Constant(input) && !right->Calculate(input))
+        }
+        else if (node->GetKind() == kind && (!is_xor || flat.size() + node->GetOperandCount() <= max_flattened_xor_operands))
+        {
+            for (size_t j = 0; j < node->GetOperandCount(); ++j)
+            {
+                flat.push_back(node->GetOperand(j));
+            }
+            run_ends.push_back(flat.size());
+        }
+        else
+        {
+            loose.push_back(*operand);
+        }
+    }
+    std::sort(loose.begin(), loose.end(), IdLess);
+    flat.insert(flat.end(), loose.begin(), loose.end());
+    run_ends.push_back(flat.size());
+    while (run_ends.size() > 1)
+    {
+        size_t merged = 0;
+        size_t begin = 0;
+        for (size_t i = 0; i < run_ends.size(); i += 2)
+        {
+            if (i + 1 < run_ends.size())
             {
-                output = left;
+                std::inplace_merge(flat.begin() + begin, flat.begin() + run_ends[i], flat.begin() + run_ends[i + 1], IdLess);
+                begin = run_ends[i + 1];
             }
-            else if (left->Constant(input) && left->Calculate(input))
+            else
             {
-                output = std::make_shared<NegBitExpression>(right);
+                begin = run_ends[i];
             }
-            else if (right->Constant(input) && right->Calculate(input))
+            run_ends[merged++] = begin;
+        }
+        run_ends.resize(merged);
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < flat.size();)
+    {
+        size_t j = i + 1;
+        while (j < flat.size() && flat[j].get() == flat[i].get())
+        {
+            ++j;
+        }
+        if (!is_xor || (j - i) % 2)
+        {
+            flat[count++] = flat[i];
+        }
+        i = j;
+    }
+    flat.resize(count);
+    if (!is_xor)
+    {
+        for (size_t i = 0; i < flat.size(); ++i)
+        {
+            if (flat[i]->GetKind() == BitExpressionKind::Neg && std::binary_search(flat.begin(), flat.end(), flat[i]->GetOperand(0), IdLess))
             {
-                output = std::make_shared<NegBitExpression>(left);
+                return const_bool(absorbing);
             }
         }
     }
-}
-
-std::shared_ptr<IBitExpression> XorBitExpression::GetLeftArgument() const
-{
-    return left;
-}
-
-std::shared_ptr<IBitExpression> XorBitExpression::GetRightArgument() const
-{
-    return right;
-}
 
-std::shared_ptr<IBitExpression> const_bool(bool value)
-{
-    return std::make_shared<ConstBitExpression>(value);
+    std::shared_ptr<IBitExpression> result;
+    if (flat.empty())
+    {
+        result = const_bool(is_xor ? false : !absorbing);
+    }
+    else if (flat.size() == 1)
+    {
+        result = flat[0];
+    }
+    else if (is_xor)
+    {
+        // Nested Xor nodes may still cancel each other's operands
+        BitExpressionFingerprint fingerprint = { 0, 0 };
+        for (size_t i = 0; i < flat.size(); ++i)
+        {
+            fingerprint ^= GetFingerprint(flat[i].get());
+        }
+        std::vector<const IBitExpression*> leaves;
+        if (fingerprint.IsEmpty())
+        {
+            ExpandXor(flat, leaves);
+        }
+        result = fingerprint.IsEmpty() && leaves.empty() ? const_bool(false) : BitExpressionTable::InternXor(fingerprint, flat);
+    }
+    else
+    {
+        const BitExpressionKey key = AssociativeBitExpression::MakeKey(kind, flat);
+        result = absorbing ? BitExpressionTable::InternOperands<OrBitExpression>(key, flat) : BitExpressionTable::InternOperands<AndBitExpression>(key, flat);
+    }
+    return negated ? ~result : result;
 }
 
 std::shared_ptr<IBitExpression> operator&(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
 {
-    return std::make_shared<AndBitExpression>(left, right);
+    if (IBitExpressionEngine* engine = SelectEngine(left, right))
+    {
+        return engine->And(left, right);
+    }
+    return associative_bits(BitExpressionKind::And, BitExpressionTable::operands_type{ left, right });
 }
 
 std::shared_ptr<IBitExpression> operator|(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
 {
-    return std::make_shared<OrBitExpression>(left, right);
+    if (IBitExpressionEngine* engine = SelectEngine(left, right))
+    {
+        return engine->Or(left, right);
+    }
+    return associative_bits(BitExpressionKind::Or, BitExpressionTable::operands_type{ left, right });
 }
 
 std::shared_ptr<IBitExpression> operator^(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
 {
-    return std::make_shared<XorBitExpression>(left, right);
+    if (IBitExpressionEngine* engine = SelectEngine(left, right))
+    {
+        return engine->Xor(left, right);
+    }
+    return associative_bits(BitExpressionKind::Xor, BitExpressionTable::operands_type{ left, right });
 }
 
 std::shared_ptr<IBitExpression> operator~(const std::shared_ptr<IBitExpression>& argument)
 {
-    return std::make_shared<NegBitExpression>(argument);
+    if (IBitExpressionEngine* engine = argument->GetEngine())
+    {
+        return engine->Neg(argument);
+    }
+    if (argument->GetKind() == BitExpressionKind::Const)
+    {
+        return const_bool(!argument->GetKey().first);
+    }
+    if (argument->GetKind() == BitExpressionKind::Neg)
+    {
+        return argument->GetOperand(0);
+    }
+    return BitExpressionTable::Intern<NegBitExpression>(BitExpressionKey(BitExpressionKind::Neg, argument->GetId(), 0), argument);
 }
 
 std::shared_ptr<IBitExpression> operator!=(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
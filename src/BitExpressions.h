@@ -23,23 +23,37 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <atomic>
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
 struct IBitExpression;
+struct IBitExpressionEngine;
+struct WordExpression;
 
+// Bits are addressed with a fixed stride of max_bit_count per variable whatever the word width,
+// so expressions and engines do not depend on it; BasicBitExpressionStates fixes the width statically
 struct BitExpressionStates
 {
-    typedef uint32_t work_type;
-    static const size_t bit_count = sizeof(BitExpressionStates::work_type) * 8;
+    typedef uint64_t work_type;
+    static const size_t max_bit_count = sizeof(BitExpressionStates::work_type) * 8;
+    static const size_t default_bit_count = 32;
 
     static size_t GetBitIndex(size_t var_index, size_t bit_number);
     static bool ExtractBit(work_type value, size_t bit_number);
 
+    explicit BitExpressionStates(size_t bit_count = default_bit_count);
+
+    size_t GetBitCount() const;
+    work_type GetWordMask() const;
+
     size_t GetVarIndex(const std::string& name) const;
     size_t GetVarIndex(const std::string& name, size_t index) const;
-    std::string GetVarName(size_t var_index) const;
+    const std::string& GetVarName(size_t var_index) const;
 
     size_t AddVariable(const std::string& name, bool constant, work_type initial_value = 0);
     size_t AddArray(const std::string& name, bool constant, size_t size, work_type initial_value = 0);
@@ -52,12 +66,25 @@ struct BitExpressionStates
 
     void SetInputBitConstant(size_t bit_index, bool constant);
     bool IsInputBitConstant(size_t bit_index) const;
+
+    // Masks hold one bit per input bit of a variable; a set bit in a free mask is not constant
+    void SetInputFreeMask(size_t var_index, work_type free_mask);
+    work_type GetInputFreeMask(size_t var_index) const;
+    void SetInputFreeMasks(size_t first_var_index, size_t var_count, work_type free_mask);
+    bool AreInputVarsConstant(size_t first_var_index, size_t var_count) const;
+    size_t GetFreeBitCount(size_t first_var_index, size_t var_count) const;
+    size_t GetFreeBitCount() const;
     void SetInputBitValue(size_t bit_index, bool value);
     bool GetInputBitValue(size_t bit_index) const;
 
     void SetBitExpression(size_t bit_index, const std::shared_ptr<IBitExpression>& expresssion);
     std::shared_ptr<IBitExpression> GetBitExpression(size_t bit_index) const;
 
+    // Variables holding a word term are bit-blasted only when their bits are read or written
+    void SetWordExpression(size_t var_index, const std::shared_ptr<WordExpression>& expression);
+    std::shared_ptr<WordExpression> GetWordExpression(size_t var_index) const;
+    bool HasWordExpression(size_t var_index) const;
+
     bool IsCurrentBitConstant(size_t bit_index) const;
     bool GetCurrentBitValue(size_t bit_index) const;
     bool IsCurrentVarConstant(size_t var_index) const;
@@ -66,29 +93,280 @@ struct BitExpressionStates
 
     void Optimize();
 
+    void SetEngine(const std::shared_ptr<IBitExpressionEngine>& engine);
+    std::shared_ptr<IBitExpressionEngine> GetEngine() const;
+
     void CopyInputVarValues(const BitExpressionStates& from);
     void CopyNames(const BitExpressionStates& from);
     void CopyInputConstants(const BitExpressionStates& from);
     void CopyBitExpressions(const BitExpressionStates& from);
     void Copy(const BitExpressionStates& from);
+
+    // Changes whenever input constants or values change; keys memoized evaluation results. Epochs
+    // are packed into 63 bits of a memo word, which no run can exhaust, so they never repeat
+    uint64_t GetEpoch() const;
+    size_t GetDirtyBitCount() const;
 private:
+    typedef std::vector<std::shared_ptr<IBitExpression> > var_expressions_type;
+
+    void Touch();
+    void MarkDirty(size_t bit_index);
+    void BlastWordExpression(size_t var_index);
+    std::shared_ptr<IBitExpression>& GetWritableBitExpression(size_t bit_index);
+
+    size_t bit_count;
     std::vector<work_type> input_variables;
     std::vector<size_t> array_sizes;
     std::vector<size_t> array_starts;
     std::vector<std::string> names;
-    std::vector<bool> input_bit_constants;
-    std::vector<std::shared_ptr<IBitExpression> > bit_expressions;
+    std::vector<std::string> display_names;
+    std::unordered_map<std::string, size_t> name_indexes;
+    std::vector<work_type> input_constant_masks;
+    // One chunk per variable, shared between copies and cloned on first write
+    std::vector<std::shared_ptr<var_expressions_type> > bit_expressions;
+    std::vector<std::shared_ptr<WordExpression> > word_expressions;
+    std::shared_ptr<IBitExpressionEngine> engine;
+    std::vector<size_t> dirty_bits;
+    std::vector<bool> dirty_flags;
+    uint64_t epoch;
+};
+
+template<typename T>
+struct BasicBitExpressionStates : public BitExpressionStates
+{
+    typedef T work_type;
+    static constexpr size_t bit_count = sizeof(T) * 8;
+
+    BasicBitExpressionStates() : BitExpressionStates(bit_count)
+    {
+    }
+
+    size_t AddVariable(const std::string& name, bool constant, work_type initial_value = 0)
+    {
+        return BitExpressionStates::AddVariable(name, constant, initial_value);
+    }
+    size_t AddArray(const std::string& name, bool constant, size_t size, work_type initial_value = 0)
+    {
+        return BitExpressionStates::AddArray(name, constant, size, initial_value);
+    }
+    void SetInputVarValue(size_t var_index, work_type value)
+    {
+        BitExpressionStates::SetInputVarValue(var_index, value);
+    }
+    work_type GetInputVarValue(size_t var_index) const
+    {
+        return static_cast<work_type>(BitExpressionStates::GetInputVarValue(var_index));
+    }
+    work_type GetCurrentVarValue(size_t var_index) const
+    {
+        return static_cast<work_type>(BitExpressionStates::GetCurrentVarValue(var_index));
+    }
+    work_type GetOutputVarValue(size_t var_index) const
+    {
+        return static_cast<work_type>(BitExpressionStates::GetOutputVarValue(var_index));
+    }
+};
+
+template<typename T>
+constexpr size_t BasicBitExpressionStates<T>::bit_count;
+
+enum class BitExpressionKind : uint32_t
+{
+    Const,
+    Variable,
+    Neg,
+    Or,
+    And,
+    Xor,
+    Handle
+};
+
+struct BitExpressionKey
+{
+    BitExpressionKey(BitExpressionKind kind, uint32_t first, uint32_t second);
+    bool operator==(const BitExpressionKey& other) const;
+
+    BitExpressionKind kind;
+    uint32_t first;
+    uint32_t second;
 };
 
-struct IBitExpression
+struct BitExpressionKeyHash
 {
+    size_t operator()(const BitExpressionKey& key) const;
+};
+
+// Hashes the operand set of an Xor node: the xor of a hash of every operand, which does not depend
+// on how the set was associated and cancels equal operands. Only a key; sets that happen to share a
+// fingerprint are told apart by comparing them
+struct BitExpressionFingerprint
+{
+    bool operator==(const BitExpressionFingerprint& other) const;
+    BitExpressionFingerprint& operator^=(const BitExpressionFingerprint& other);
+    bool IsEmpty() const;
+
+    uint64_t low;
+    uint64_t high;
+};
+
+// Shared by all threads; a node stays listed until its destructor erases it, so lookups skip nodes
+// that have already lost their last owner
+struct BitExpressionTable
+{
+    typedef std::vector<std::shared_ptr<IBitExpression> > operands_type;
+
+    template<typename T, typename... Arguments>
+    static std::shared_ptr<IBitExpression> Intern(const BitExpressionKey& key, Arguments&&... arguments);
+    // Operand lists only hash into the key, so nodes are also matched by their operands
+    template<typename T>
+    static std::shared_ptr<IBitExpression> InternOperands(const BitExpressionKey& key, const operands_type& operands);
+    // Xor nodes are keyed by fingerprint instead; a fingerprint match is confirmed by comparing the
+    // operand sets with nested Xor nodes expanded, and a set that cancels down to a single operand
+    // gives that operand
+    static std::shared_ptr<IBitExpression> InternXor(const BitExpressionFingerprint& fingerprint, const operands_type& operands);
+    // Called by BitExpressionNodeAllocator; also releases the id of the expression for reuse
+    static void Erase(const IBitExpression* expression);
+    static size_t GetNodeCount();
+private:
+    friend struct IBitExpression;
+    typedef std::unordered_multimap<BitExpressionKey, IBitExpression*, BitExpressionKeyHash> nodes_type;
+    static std::shared_ptr<IBitExpression> Find(const BitExpressionKey& key);
+    static std::shared_ptr<IBitExpression> Find(const BitExpressionKey& key, const operands_type& operands);
+    static void Insert(IBitExpression* expression);
+    static nodes_type& GetNodes();
+    static std::mutex& GetMutex();
+    // Ids order nodes and are folded into the keys of their parents; they are not handles, a node is
+    // only reached through a shared_ptr. Called with the table locked, since every node is
+    // constructed by Intern
+    static uint32_t TakeId(IBitExpression* expression);
+    static std::vector<uint32_t>& GetFreeIds();
+    static std::vector<IBitExpression*>& GetNodesById();
+};
+
+struct IBitExpression : public std::enable_shared_from_this<IBitExpression>
+{
+    virtual ~IBitExpression();
     virtual std::string ToString(const BitExpressionStates& info) const = 0;
     virtual bool Constant(const BitExpressionStates& input) const = 0;
     virtual bool Calculate(const BitExpressionStates& input) const = 0;
     virtual int Priority() const = 0;
-    virtual std::shared_ptr<IBitExpression> DeepCopy() const = 0;
-    virtual bool Equals(const std::shared_ptr<IBitExpression>& other) const = 0;
-    virtual void Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) = 0;
+    virtual void Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) const = 0;
+    virtual IBitExpressionEngine* GetEngine() const;
+    bool Equals(const std::shared_ptr<IBitExpression>& other) const;
+    bool IsOptimized(const BitExpressionStates& input) const;
+    void SetOptimized(const BitExpressionStates& input) const;
+    virtual size_t GetOperandCount() const;
+    virtual const std::shared_ptr<IBitExpression>& GetOperand(size_t index) const;
+    BitExpressionKind GetKind() const;
+    const BitExpressionKey& GetKey() const;
+    uint32_t GetId() const;
+protected:
+    explicit IBitExpression(const BitExpressionKey& key);
+private:
+    BitExpressionKey key;
+    uint32_t id;
+    mutable std::atomic<uint64_t> optimized_epoch;
+};
+
+// Allocates interned nodes; a node leaves the unique table when its last owner drops it, before any
+// of its destructors runs, so a lookup under the table lock only ever reads whole nodes
+template<typename T>
+struct BitExpressionNodeAllocator
+{
+    typedef T value_type;
+
+    BitExpressionNodeAllocator()
+    {
+    }
+    template<typename U>
+    BitExpressionNodeAllocator(const BitExpressionNodeAllocator<U>&)
+    {
+    }
+    T* allocate(size_t count)
+    {
+        return std::allocator<T>().allocate(count);
+    }
+    void deallocate(T* pointer, size_t count)
+    {
+        std::allocator<T>().deallocate(pointer, count);
+    }
+    template<typename U>
+    void destroy(U* pointer)
+    {
+        BitExpressionTable::Erase(pointer);
+        pointer->~U();
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const BitExpressionNodeAllocator<T>&, const BitExpressionNodeAllocator<U>&)
+{
+    return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const BitExpressionNodeAllocator<T>&, const BitExpressionNodeAllocator<U>&)
+{
+    return false;
+}
+
+template<typename T, typename... Arguments>
+std::shared_ptr<IBitExpression> BitExpressionTable::Intern(const BitExpressionKey& key, Arguments&&... arguments)
+{
+    std::lock_guard<std::mutex> lock(GetMutex());
+    std::shared_ptr<IBitExpression> result = Find(key);
+    if (!result)
+    {
+        result = std::allocate_shared<T>(BitExpressionNodeAllocator<T>(), std::forward<Arguments>(arguments)...);
+        Insert(result.get());
+    }
+    return result;
+}
+
+template<typename T>
+std::shared_ptr<IBitExpression> BitExpressionTable::InternOperands(const BitExpressionKey& key, const operands_type& operands)
+{
+    std::lock_guard<std::mutex> lock(GetMutex());
+    std::shared_ptr<IBitExpression> result = Find(key, operands);
+    if (!result)
+    {
+        result = std::allocate_shared<T>(BitExpressionNodeAllocator<T>(), operands);
+        Insert(result.get());
+    }
+    return result;
+}
+
+// Receives the cone of an engine expression as plain operations; every call returns a slot that
+// later calls refer to
+struct IBitExpressionSink
+{
+    virtual ~IBitExpressionSink();
+    virtual uint32_t Const(bool value) = 0;
+    virtual uint32_t Variable(size_t var_index, size_t bit_number) = 0;
+    virtual uint32_t Neg(uint32_t argument) = 0;
+    virtual uint32_t Or(uint32_t left, uint32_t right) = 0;
+    virtual uint32_t And(uint32_t left, uint32_t right) = 0;
+    virtual uint32_t Xor(uint32_t left, uint32_t right) = 0;
+};
+
+struct IBitExpressionEngine
+{
+    virtual ~IBitExpressionEngine();
+    virtual std::shared_ptr<IBitExpression> Const(bool value) = 0;
+    virtual std::shared_ptr<IBitExpression> Variable(size_t var_index, size_t bit_number) = 0;
+    virtual std::shared_ptr<IBitExpression> Neg(const std::shared_ptr<IBitExpression>& argument) = 0;
+    virtual std::shared_ptr<IBitExpression> Or(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right) = 0;
+    virtual std::shared_ptr<IBitExpression> And(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right) = 0;
+    virtual std::shared_ptr<IBitExpression> Xor(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right) = 0;
+    virtual std::shared_ptr<IBitExpression> Import(const std::shared_ptr<IBitExpression>& expression);
+    // Emits the cones of expressions of this engine through sink, nodes shared between them once;
+    // slots receives the result of every expression
+    virtual void Export(const std::vector<const IBitExpression*>& expressions, IBitExpressionSink& sink, std::vector<uint32_t>& slots) const = 0;
+    uint32_t GetEngineId() const;
+protected:
+    IBitExpressionEngine();
+private:
+    uint32_t engine_id;
 };
 
 struct ConstBitExpression : public IBitExpression
@@ -98,9 +376,7 @@ struct ConstBitExpression : public IBitExpression
     bool Constant(const BitExpressionStates& input) const;
     bool Calculate(const BitExpressionStates& input) const;
     int Priority() const;
-    std::shared_ptr<IBitExpression> DeepCopy() const;
-    bool Equals(const std::shared_ptr<IBitExpression>& other) const;
-    void Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input);
+    void Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) const;
 private:
     bool value;
 };
@@ -112,78 +388,107 @@ struct VariableBitExpression : public IBitExpression
     bool Constant(const BitExpressionStates& input) const;
     bool Calculate(const BitExpressionStates& input) const;
     int Priority() const;
-    std::shared_ptr<IBitExpression> DeepCopy() const;
-    bool Equals(const std::shared_ptr<IBitExpression>& other) const;
-    void Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input);
+    void Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) const;
 private:
     size_t var_index;
     size_t bit_number;
 };
 
-struct NegBitExpression : public IBitExpression
+// Base of Neg/Or/And/Xor; traverses operands with explicit stacks so expression depth is not limited by the call stack
+struct OperatorBitExpression : public IBitExpression
 {
-    explicit NegBitExpression(const std::shared_ptr<IBitExpression>& argument);
     std::string ToString(const BitExpressionStates& info) const;
     bool Constant(const BitExpressionStates& input) const;
     bool Calculate(const BitExpressionStates& input) const;
+    void Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) const;
+protected:
+    explicit OperatorBitExpression(const BitExpressionKey& key);
+    bool GetOperandValue(size_t index, const BitExpressionStates& input) const;
+    virtual std::string Format(const std::string* operand_strings) const = 0;
+    virtual bool Evaluate(const BitExpressionStates& input) const = 0;
+    // Leaves output empty when the optimized operands do not change this expression
+    virtual void Rebuild(std::shared_ptr<IBitExpression>& output, const std::shared_ptr<IBitExpression>* operands, const BitExpressionStates& input) const = 0;
+private:
+    static const OperatorBitExpression* AsOperator(const IBitExpression* expression);
+    static uint64_t MakeMemo(uint64_t epoch, bool value);
+    static bool ReadMemo(const std::atomic<uint64_t>& memo, uint64_t epoch, bool& value);
+    bool OperandsReady(std::atomic<uint64_t> OperatorBitExpression::* memo, uint64_t epoch) const;
+    bool ConstantOperands(const BitExpressionStates& input) const;
+
+    // Epoch and value share one word, so threads working on different states may overwrite a memo
+    // but never pair one state's epoch with another state's value
+    mutable std::atomic<uint64_t> constant_memo;
+    mutable std::atomic<uint64_t> calculate_memo;
+};
+
+struct NegBitExpression : public OperatorBitExpression
+{
+    explicit NegBitExpression(const std::shared_ptr<IBitExpression>& argument);
+    ~NegBitExpression();
     int Priority() const;
-    std::shared_ptr<IBitExpression> DeepCopy() const;
-    bool Equals(const std::shared_ptr<IBitExpression>& other) const;
-    void Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input);
+    size_t GetOperandCount() const;
+    const std::shared_ptr<IBitExpression>& GetOperand(size_t index) const;
     std::shared_ptr<IBitExpression> GetArgument() const;
+protected:
+    std::string Format(const std::string* operand_strings) const;
+    bool Evaluate(const BitExpressionStates& input) const;
+    void Rebuild(std::shared_ptr<IBitExpression>& output, const std::shared_ptr<IBitExpression>* operands, const BitExpressionStates& input) const;
 private:
     std::shared_ptr<IBitExpression> argument;
 };
 
-struct OrBitExpression : public IBitExpression
+// Base of the associative operators; operands are sorted by id and free of duplicates. And/Or
+// operands are always flattened, Xor operands only while the set stays small
+struct AssociativeBitExpression : public OperatorBitExpression
 {
-    OrBitExpression(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
-    std::string ToString(const BitExpressionStates& info) const;
-    bool Constant(const BitExpressionStates& input) const;
-    bool Calculate(const BitExpressionStates& input) const;
-    int Priority() const;
-    std::shared_ptr<IBitExpression> DeepCopy() const;
-    bool Equals(const std::shared_ptr<IBitExpression>& other) const;
-    void Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input);
-    std::shared_ptr<IBitExpression> GetLeftArgument() const;
-    std::shared_ptr<IBitExpression> GetRightArgument() const;
+    ~AssociativeBitExpression();
+    size_t GetOperandCount() const;
+    const std::shared_ptr<IBitExpression>& GetOperand(size_t index) const;
+    static BitExpressionKey MakeKey(BitExpressionKind kind, const BitExpressionTable::operands_type& operands);
+protected:
+    AssociativeBitExpression(const BitExpressionKey& key, const BitExpressionTable::operands_type& operands);
+    std::string Format(const std::string* operand_strings) const;
+    void Rebuild(std::shared_ptr<IBitExpression>& output, const std::shared_ptr<IBitExpression>* operands, const BitExpressionStates& input) const;
+    virtual const char* GetSymbol() const = 0;
 private:
-    std::shared_ptr<IBitExpression> left, right;
+    std::vector<std::shared_ptr<IBitExpression> > operands;
 };
 
-struct AndBitExpression : public IBitExpression
+struct OrBitExpression : public AssociativeBitExpression
 {
-    AndBitExpression(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
-    std::string ToString(const BitExpressionStates& info) const;
-    bool Constant(const BitExpressionStates& input) const;
-    bool Calculate(const BitExpressionStates& input) const;
+    explicit OrBitExpression(const BitExpressionTable::operands_type& operands);
     int Priority() const;
-    std::shared_ptr<IBitExpression> DeepCopy() const;
-    bool Equals(const std::shared_ptr<IBitExpression>& other) const;
-    void Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input);
-    std::shared_ptr<IBitExpression> GetLeftArgument() const;
-    std::shared_ptr<IBitExpression> GetRightArgument() const;
-private:
-    std::shared_ptr<IBitExpression> left, right;
+protected:
+    bool Evaluate(const BitExpressionStates& input) const;
+    const char* GetSymbol() const;
 };
 
-struct XorBitExpression : public IBitExpression
+struct AndBitExpression : public AssociativeBitExpression
 {
-    XorBitExpression(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
-    std::string ToString(const BitExpressionStates& info) const;
-    bool Constant(const BitExpressionStates& input) const;
-    bool Calculate(const BitExpressionStates& input) const;
+    explicit AndBitExpression(const BitExpressionTable::operands_type& operands);
     int Priority() const;
-    std::shared_ptr<IBitExpression> DeepCopy() const;
-    bool Equals(const std::shared_ptr<IBitExpression>& other) const;
-    void Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input);
-    std::shared_ptr<IBitExpression> GetLeftArgument() const;
-    std::shared_ptr<IBitExpression> GetRightArgument() const;
+protected:
+    bool Evaluate(const BitExpressionStates& input) const;
+    const char* GetSymbol() const;
+};
+
+struct XorBitExpression : public AssociativeBitExpression
+{
+    XorBitExpression(const BitExpressionTable::operands_type& operands, const BitExpressionFingerprint& fingerprint);
+    int Priority() const;
+    const BitExpressionFingerprint& GetFingerprint() const;
+protected:
+    bool Evaluate(const BitExpressionStates& input) const;
+    const char* GetSymbol() const;
 private:
-    std::shared_ptr<IBitExpression> left, right;
+    BitExpressionFingerprint fingerprint;
 };
 
 std::shared_ptr<IBitExpression> const_bool(bool value);
+std::shared_ptr<IBitExpression> variable_bit(size_t var_index, size_t bit_number);
+// Builds the canonical Or, And or Xor of all operands; And/Or drop x*!x, Xor cancels pairs and lifts negations.
+// Equal operand sets give the same node however they are associated
+std::shared_ptr<IBitExpression> associative_bits(BitExpressionKind kind, const BitExpressionTable::operands_type& operands);
 std::shared_ptr<IBitExpression> operator&(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
 std::shared_ptr<IBitExpression> operator|(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
 std::shared_ptr<IBitExpression> operator^(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
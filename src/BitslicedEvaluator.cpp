@@ -0,0 +1,292 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BITSLICED_EVALUATOR_X86
+#include <immintrin.h>
+#endif
+
+#include "BitslicedEvaluator.h"
+
+static const BitslicedEvaluator::lanes_type lane_patterns[] =
+{
+    0xAAAAAAAAAAAAAAAAull,
+    0xCCCCCCCCCCCCCCCCull,
+    0xF0F0F0F0F0F0F0F0ull,
+    0xFF00FF00FF00FF00ull,
+    0xFFFF0000FFFF0000ull,
+    0xFFFFFFFF00000000ull
+};
+
+static const size_t lane_pattern_count = sizeof(lane_patterns) / sizeof(lane_patterns[0]);
+
+static const uint64_t no_batch = ~static_cast<uint64_t>(0);
+
+BitslicedEvaluator::BitslicedEvaluator(const BitExpressionStates& state, const std::vector<size_t>& var_indexes, size_t word_count_)
+    : BitslicedEvaluator(BitBytecode::Compile(state, var_indexes), word_count_)
+{
+}
+
+BitslicedEvaluator::BitslicedEvaluator(const std::shared_ptr<const BitBytecode>& code_, size_t word_count_)
+    : code(code_), word_count(word_count_ ? word_count_ : GetMaxWordCount()), evaluated_batch(no_batch), current_word(0)
+{
+    if ((word_count != 1 && word_count != 4 && word_count != 8) || word_count > GetMaxWordCount())
+        throw std::runtime_error("BitslicedEvaluator::BitslicedEvaluator(): word count is not supported");
+    if (code->inputs.size() >= lane_pattern_count + 64)
+        throw std::runtime_error("BitslicedEvaluator::BitslicedEvaluator(): too many free bits");
+
+    registers.resize(code->register_count * word_count);
+    for (size_t word = 0; word < word_count; ++word)
+    {
+        registers[BitBytecode::true_register * word_count + word] = ~static_cast<lanes_type>(0);
+    }
+}
+
+size_t BitslicedEvaluator::GetMaxWordCount()
+{
+#ifdef BITSLICED_EVALUATOR_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return 8;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return 4;
+    }
+#endif
+    return 1;
+}
+
+size_t BitslicedEvaluator::GetWordCount() const
+{
+    return word_count;
+}
+
+const std::vector<size_t>& BitslicedEvaluator::GetFreeBits() const
+{
+    return code->inputs;
+}
+
+uint64_t BitslicedEvaluator::GetBatchCount() const
+{
+    if (code->inputs.size() <= lane_pattern_count)
+    {
+        return 1;
+    }
+    return static_cast<uint64_t>(1) << (code->inputs.size() - lane_pattern_count);
+}
+
+BitslicedEvaluator::lanes_type BitslicedEvaluator::GetValidLanes() const
+{
+    if (code->inputs.size() >= lane_pattern_count)
+    {
+        return ~static_cast<lanes_type>(0);
+    }
+    return (static_cast<lanes_type>(1) << (1 << code->inputs.size())) - 1;
+}
+
+void BitslicedEvaluator::Evaluate(uint64_t batch)
+{
+    const uint64_t first_batch = batch - batch % word_count;
+    if (first_batch != evaluated_batch)
+    {
+        LoadInputs(first_batch);
+        switch (word_count)
+        {
+        case 8:
+            EvaluateAvx512();
+            break;
+        case 4:
+            EvaluateAvx2();
+            break;
+        default:
+            EvaluateScalar();
+            break;
+        }
+        evaluated_batch = first_batch;
+    }
+    current_word = static_cast<size_t>(batch - first_batch);
+}
+
+BitslicedEvaluator::lanes_type BitslicedEvaluator::GetBitLanes(size_t var_index, size_t bit_number) const
+{
+    return registers[code->GetOutputRegister(var_index, bit_number) * word_count + current_word];
+}
+
+BitExpressionStates::work_type BitslicedEvaluator::GetVarValue(size_t var_index, size_t lane) const
+{
+    BitExpressionStates::work_type result = 0;
+    for (size_t bit_number = 0; bit_number < code->bit_count; ++bit_number)
+    {
+        const BitExpressionStates::work_type bit_value = (GetBitLanes(var_index, bit_number) >> lane) & 1;
+        result |= bit_value << bit_number;
+    }
+    return result;
+}
+
+BitslicedEvaluator::lanes_type BitslicedEvaluator::MatchVarValue(size_t var_index, BitExpressionStates::work_type value) const
+{
+    lanes_type result = GetValidLanes();
+    for (size_t bit_number = 0; bit_number < code->bit_count && result; ++bit_number)
+    {
+        const lanes_type lanes = GetBitLanes(var_index, bit_number);
+        result &= BitExpressionStates::ExtractBit(value, bit_number) ? lanes : ~lanes;
+    }
+    return result;
+}
+
+void BitslicedEvaluator::GetAssignment(uint64_t batch, size_t lane, BitExpressionStates& state) const
+{
+    for (size_t i = 0; i < code->inputs.size(); ++i)
+    {
+        const bool value = i < lane_pattern_count ? ((lane >> i) & 1) != 0 : ((batch >> (i - lane_pattern_count)) & 1) != 0;
+        state.SetInputBitValue(code->inputs[i], value);
+    }
+}
+
+BitslicedEvaluator::lanes_type BitslicedEvaluator::GetVariableLanes(size_t free_bit_number, uint64_t batch)
+{
+    if (free_bit_number < lane_pattern_count)
+    {
+        return lane_patterns[free_bit_number];
+    }
+    return (batch >> (free_bit_number - lane_pattern_count)) & 1 ? ~static_cast<lanes_type>(0) : 0;
+}
+
+void BitslicedEvaluator::LoadInputs(uint64_t first_batch)
+{
+    lanes_type* value = registers.data() + BitBytecode::first_input_register * word_count;
+    for (size_t i = 0; i < code->inputs.size(); ++i)
+    {
+        for (size_t word = 0; word < word_count; ++word)
+        {
+            *value++ = GetVariableLanes(i, first_batch + word);
+        }
+    }
+}
+
+void BitslicedEvaluator::EvaluateScalar()
+{
+    lanes_type* values = registers.data();
+    const std::vector<BitBytecode::Instruction>& instructions = code->instructions;
+    for (size_t i = 0; i < instructions.size(); ++i)
+    {
+        const BitBytecode::Instruction& instruction = instructions[i];
+        lanes_type* value = values + instruction.destination * word_count;
+        const lanes_type* first = values + instruction.first * word_count;
+        const lanes_type* second = values + instruction.second * word_count;
+        for (size_t word = 0; word < word_count; ++word)
+        {
+            switch (instruction.kind)
+            {
+            case BitExpressionKind::Neg:
+                value[word] = ~first[word];
+                break;
+            case BitExpressionKind::Or:
+                value[word] = first[word] | second[word];
+                break;
+            case BitExpressionKind::And:
+                value[word] = first[word] & second[word];
+                break;
+            default:
+                value[word] = first[word] ^ second[word];
+                break;
+            }
+        }
+    }
+}
+
+#ifdef BITSLICED_EVALUATOR_X86
+
+__attribute__((target("avx2")))
+void BitslicedEvaluator::EvaluateAvx2()
+{
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    __m256i* values = reinterpret_cast<__m256i*>(registers.data());
+    const std::vector<BitBytecode::Instruction>& instructions = code->instructions;
+    for (size_t i = 0; i < instructions.size(); ++i)
+    {
+        const BitBytecode::Instruction& instruction = instructions[i];
+        const __m256i first = _mm256_loadu_si256(values + instruction.first);
+        const __m256i second = _mm256_loadu_si256(values + instruction.second);
+        switch (instruction.kind)
+        {
+        case BitExpressionKind::Neg:
+            _mm256_storeu_si256(values + instruction.destination, _mm256_xor_si256(first, ones));
+            break;
+        case BitExpressionKind::Or:
+            _mm256_storeu_si256(values + instruction.destination, _mm256_or_si256(first, second));
+            break;
+        case BitExpressionKind::And:
+            _mm256_storeu_si256(values + instruction.destination, _mm256_and_si256(first, second));
+            break;
+        default:
+            _mm256_storeu_si256(values + instruction.destination, _mm256_xor_si256(first, second));
+            break;
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+void BitslicedEvaluator::EvaluateAvx512()
+{
+    const __m512i ones = _mm512_set1_epi64(-1);
+    __m512i* values = reinterpret_cast<__m512i*>(registers.data());
+    const std::vector<BitBytecode::Instruction>& instructions = code->instructions;
+    for (size_t i = 0; i < instructions.size(); ++i)
+    {
+        const BitBytecode::Instruction& instruction = instructions[i];
+        const __m512i first = _mm512_loadu_si512(values + instruction.first);
+        const __m512i second = _mm512_loadu_si512(values + instruction.second);
+        switch (instruction.kind)
+        {
+        case BitExpressionKind::Neg:
+            _mm512_storeu_si512(values + instruction.destination, _mm512_xor_si512(first, ones));
+            break;
+        case BitExpressionKind::Or:
+            _mm512_storeu_si512(values + instruction.destination, _mm512_or_si512(first, second));
+            break;
+        case BitExpressionKind::And:
+            _mm512_storeu_si512(values + instruction.destination, _mm512_and_si512(first, second));
+            break;
+        default:
+            _mm512_storeu_si512(values + instruction.destination, _mm512_xor_si512(first, second));
+            break;
+        }
+    }
+}
+
+#else
+
+void BitslicedEvaluator::EvaluateAvx2()
+{
+    EvaluateScalar();
+}
+
+void BitslicedEvaluator::EvaluateAvx512()
+{
+    EvaluateScalar();
+}
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "BitBytecode.h"
+#include "BitExpressions.h"
+
+// Evaluates the given variables for lane_count assignments of their free input bits per batch;
+// word_count consecutive batches are computed together by a scalar, AVX2 or AVX-512 kernel
+struct BitslicedEvaluator
+{
+    typedef uint64_t lanes_type;
+    static const size_t lane_count = sizeof(BitslicedEvaluator::lanes_type) * 8;
+
+    BitslicedEvaluator(const BitExpressionStates& state, const std::vector<size_t>& var_indexes, size_t word_count = 0);
+    explicit BitslicedEvaluator(const std::shared_ptr<const BitBytecode>& code, size_t word_count = 0);
+
+    static size_t GetMaxWordCount();
+    size_t GetWordCount() const;
+
+    const std::vector<size_t>& GetFreeBits() const;
+    uint64_t GetBatchCount() const;
+    lanes_type GetValidLanes() const;
+
+    void Evaluate(uint64_t batch);
+    lanes_type GetBitLanes(size_t var_index, size_t bit_number) const;
+    BitExpressionStates::work_type GetVarValue(size_t var_index, size_t lane) const;
+    lanes_type MatchVarValue(size_t var_index, BitExpressionStates::work_type value) const;
+    void GetAssignment(uint64_t batch, size_t lane, BitExpressionStates& state) const;
+private:
+    static lanes_type GetVariableLanes(size_t free_bit_number, uint64_t batch);
+    void LoadInputs(uint64_t first_batch);
+    void EvaluateScalar();
+    void EvaluateAvx2();
+    void EvaluateAvx512();
+
+    std::shared_ptr<const BitBytecode> code;
+    std::vector<lanes_type> registers;
+    size_t word_count;
+    uint64_t evaluated_batch;
+    size_t current_word;
+};
@@ -22,27 +22,49 @@
 #pragma once
 
 #include "BitExpressions.h"
+#include "BitExpressionStatistics.h"
+#include "ExecutionTracer.h"
 #include "Program.h"
+#include "ProgramBytecode.h"
 #include "Utility.h"
-//#include <Windows.h>
 
-inline void Execute(const Program& program, const BitExpressionStates& initial_state, BitExpressionStates& output_state)
+// Runs silently unless a tracer asks for output; a profile records expression statistics after every statement
+template<typename W>
+void Execute(const BasicProgram<W>& program, const BitExpressionStates& initial_state, BitExpressionStates& output_state, ExecutionProfile* profile = nullptr, IExecutionTracer* tracer = nullptr)
 {
-    FullState work_state;
+    const TraceLevel trace_level = tracer ? tracer->GetLevel() : TraceLevel::Off;
+    const std::shared_ptr<const BasicProgramBytecode<W> > code = BasicProgramBytecode<W>::Compile(program);
+    BasicFullState<W> work_state;
     work_state.Copy(initial_state);
-    while (work_state.statement_index < program.statements.size())
+    while (work_state.statement_index < code->instructions.size())
     {
-        std::cout << program.statements.at(work_state.statement_index)->Print(work_state) << std::endl;
-        std::cout << "run..." << std::endl;
-        program.statements.at(work_state.statement_index)->Execute(work_state);
-
-        std::cout << "optimize..." << std::endl;
+        const size_t statement_index = work_state.statement_index;
+        if (trace_level >= TraceLevel::Statements)
+        {
+            tracer->TraceStatement(statement_index, program.statements[statement_index]->Print(work_state));
+        }
+        code->Step(work_state);
         work_state.Optimize();
-        std::cout << "print..." << std::endl;
-        //std::cout << "Bit expressions" << std::endl;
-        PrintCurrent(work_state);
-        std::cout << std::endl;
-        //Sleep(250);
+        if (profile)
+        {
+            profile->Record(statement_index, program.statements[statement_index]->GetLabel(), work_state);
+        }
+        if (trace_level >= TraceLevel::Summary)
+        {
+            tracer->TraceSummary(work_state);
+        }
+        if (trace_level >= TraceLevel::Full)
+        {
+            tracer->TraceState(work_state);
+        }
     }
     output_state.Copy(work_state);
 }
+
+// Runs from the state's current statement on concrete words; no expressions are built.
+// Compile the program once with BasicProgramBytecode to run it on many states
+template<typename W>
+void ExecuteConcrete(const BasicProgram<W>& program, BasicConcreteState<W>& state)
+{
+    BasicProgramBytecode<W>::Compile(program)->Run(state);
+}
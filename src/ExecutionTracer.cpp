@@ -0,0 +1,70 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdexcept>
+
+#include "ExecutionTracer.h"
+#include "Utility.h"
+
+IExecutionTracer::~IExecutionTracer()
+{
+}
+
+StreamTracer::StreamTracer(TraceLevel level_, std::ostream& output_) : level(level_), output(output_)
+{
+}
+
+TraceLevel StreamTracer::GetLevel() const
+{
+    return level;
+}
+
+void StreamTracer::TraceStatement(size_t statement_index, const std::string& text)
+{
+    output << statement_index << ": " << text << "\n";
+}
+
+void StreamTracer::TraceSummary(const BitExpressionStates& state)
+{
+    size_t free_var_count = 0;
+    for (size_t var_index = 0; var_index < state.GetVariableCount(); ++var_index)
+    {
+        if (!state.IsCurrentVarConstant(var_index))
+        {
+            ++free_var_count;
+        }
+    }
+    output << "  non-constant variables " << free_var_count << ", live nodes " << BitExpressionTable::GetNodeCount() << "\n";
+}
+
+void StreamTracer::TraceState(const BitExpressionStates& state)
+{
+    PrintCurrent(state, output);
+    output << "\n";
+}
+
+FileTracer::FileTracer(TraceLevel level_, const std::string& path) : StreamTracer(level_, file), buffer(buffer_size)
+{
+    file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    file.open(path);
+    if (!file)
+        throw std::runtime_error("FileTracer::FileTracer(): cannot open " + path);
+}
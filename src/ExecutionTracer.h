@@ -0,0 +1,72 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "BitExpressions.h"
+
+// Each level includes the output of the levels below it
+enum class TraceLevel
+{
+    Off,
+    Statements,
+    Summary,
+    Full
+};
+
+// Receives the progress of Execute; nothing is traced unless GetLevel() asks for it
+struct IExecutionTracer
+{
+    virtual ~IExecutionTracer();
+    virtual TraceLevel GetLevel() const = 0;
+    virtual void TraceStatement(size_t statement_index, const std::string& text) = 0;
+    virtual void TraceSummary(const BitExpressionStates& state) = 0;
+    virtual void TraceState(const BitExpressionStates& state) = 0;
+};
+
+struct StreamTracer : public IExecutionTracer
+{
+    StreamTracer(TraceLevel level, std::ostream& output);
+    TraceLevel GetLevel() const;
+    void TraceStatement(size_t statement_index, const std::string& text);
+    void TraceSummary(const BitExpressionStates& state);
+    void TraceState(const BitExpressionStates& state);
+private:
+    TraceLevel level;
+    std::ostream& output;
+};
+
+// Writes through a large buffer that is only flushed when full or on destruction
+struct FileTracer : public StreamTracer
+{
+    static const size_t buffer_size = 1 << 20;
+
+    FileTracer(TraceLevel level, const std::string& path);
+private:
+    std::vector<char> buffer;
+    std::ofstream file;
+};
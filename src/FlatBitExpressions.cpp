@@ -0,0 +1,569 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "FlatBitExpressions.h"
+
+FlatBitExpressionEngine::FlatBitExpressionEngine() : collect_threshold(1 << 16), visit_epoch(0)
+{
+    Reference(AddNode(BitExpressionKind::Const, 0, 0));
+    Reference(AddNode(BitExpressionKind::Const, 1, 0));
+}
+
+std::shared_ptr<IBitExpression> FlatBitExpressionEngine::Const(bool value)
+{
+    return GetHandle(value ? 1 : 0);
+}
+
+std::shared_ptr<IBitExpression> FlatBitExpressionEngine::Variable(size_t var_index, size_t bit_number)
+{
+    MaybeCollect();
+    return GetHandle(AddNode(BitExpressionKind::Variable, static_cast<uint32_t>(var_index), static_cast<uint32_t>(bit_number)));
+}
+
+std::shared_ptr<IBitExpression> FlatBitExpressionEngine::Neg(const std::shared_ptr<IBitExpression>& argument)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> argument_handle = Import(argument);
+    return GetHandle(MakeNode(BitExpressionKind::Neg, GetIndex(argument_handle), 0));
+}
+
+std::shared_ptr<IBitExpression> FlatBitExpressionEngine::Or(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> left_handle = Import(left);
+    const std::shared_ptr<IBitExpression> right_handle = Import(right);
+    return GetHandle(MakeNode(BitExpressionKind::Or, GetIndex(left_handle), GetIndex(right_handle)));
+}
+
+std::shared_ptr<IBitExpression> FlatBitExpressionEngine::And(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> left_handle = Import(left);
+    const std::shared_ptr<IBitExpression> right_handle = Import(right);
+    return GetHandle(MakeNode(BitExpressionKind::And, GetIndex(left_handle), GetIndex(right_handle)));
+}
+
+std::shared_ptr<IBitExpression> FlatBitExpressionEngine::Xor(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right)
+{
+    MaybeCollect();
+    const std::shared_ptr<IBitExpression> left_handle = Import(left);
+    const std::shared_ptr<IBitExpression> right_handle = Import(right);
+    return GetHandle(MakeNode(BitExpressionKind::Xor, GetIndex(left_handle), GetIndex(right_handle)));
+}
+
+std::string FlatBitExpressionEngine::ToString(uint32_t index, const BitExpressionStates& info) const
+{
+    struct Frame
+    {
+        uint32_t node;
+        uint32_t next;
+    };
+    std::vector<Frame> frames;
+    std::vector<std::string> strings;
+    size_t written_nodes = 1;
+    Frame root = { index, 0 };
+    frames.push_back(root);
+    while (!frames.empty())
+    {
+        const uint32_t node = frames.back().node;
+        const uint32_t first = firsts[node];
+        const uint32_t second = seconds[node];
+        const BitExpressionKind kind = kinds[node];
+        const uint32_t count = kind == BitExpressionKind::Const || kind == BitExpressionKind::Variable ? 0 : kind == BitExpressionKind::Neg ? 1 : 2;
+        if (frames.back().next < count)
+        {
+            Frame frame = { frames.back().next++ ? second : first, 0 };
+            if (written_nodes >= max_string_nodes)
+            {
+                strings.push_back("...");
+                continue;
+            }
+            ++written_nodes;
+            frames.push_back(frame);
+            continue;
+        }
+        frames.pop_back();
+        std::string text;
+        switch (kind)
+        {
+        case BitExpressionKind::Const:
+            text = first ? "1" : "0";
+            break;
+        case BitExpressionKind::Variable:
+            text = info.GetVarName(first) + "." + std::to_string(second);
+            break;
+        case BitExpressionKind::Neg:
+            text = Priority(first) < Priority(node) ? "!(" + strings.back() + ")" : "!" + strings.back();
+            strings.pop_back();
+            break;
+        default:
+        {
+            std::string right_str = std::move(strings.back());
+            strings.pop_back();
+            std::string left_str = std::move(strings.back());
+            strings.pop_back();
+            if (Priority(first) < Priority(node))
+            {
+                left_str = "(" + left_str + ")";
+            }
+            if (Priority(second) < Priority(node))
+            {
+                right_str = "(" + right_str + ")";
+            }
+            const char* op = kind == BitExpressionKind::Or ? "+" : kind == BitExpressionKind::And ? "*" : "^";
+            text = left_str + op + right_str;
+            break;
+        }
+        }
+        strings.push_back(std::move(text));
+    }
+    return strings.back();
+}
+
+bool FlatBitExpressionEngine::Constant(uint32_t index, const BitExpressionStates& input) const
+{
+    const uint64_t epoch = input.GetEpoch();
+    if (constant_epochs[index] == epoch)
+    {
+        return constant_values[index] != 0;
+    }
+    CollectStale(index, constant_epochs, epoch);
+    for (size_t i = 0; i < cone.size(); ++i)
+    {
+        const uint32_t node = cone[i];
+        const uint32_t first = firsts[node];
+        switch (kinds[node])
+        {
+        case BitExpressionKind::Const:
+            constant_values[node] = 1;
+            break;
+        case BitExpressionKind::Variable:
+            constant_values[node] = input.IsInputBitConstant(BitExpressionStates::GetBitIndex(first, seconds[node]));
+            break;
+        case BitExpressionKind::Neg:
+            constant_values[node] = constant_values[first];
+            break;
+        default:
+            constant_values[node] = constant_values[first] & constant_values[seconds[node]];
+            break;
+        }
+        constant_epochs[node] = epoch;
+    }
+    return constant_values[index] != 0;
+}
+
+bool FlatBitExpressionEngine::Calculate(uint32_t index, const BitExpressionStates& input) const
+{
+    const uint64_t epoch = input.GetEpoch();
+    if (calculate_epochs[index] == epoch)
+    {
+        return calculate_values[index] != 0;
+    }
+    CollectStale(index, calculate_epochs, epoch);
+    for (size_t i = 0; i < cone.size(); ++i)
+    {
+        const uint32_t node = cone[i];
+        const uint32_t first = firsts[node];
+        switch (kinds[node])
+        {
+        case BitExpressionKind::Const:
+            calculate_values[node] = static_cast<uint8_t>(first);
+            break;
+        case BitExpressionKind::Variable:
+            calculate_values[node] = input.GetInputBitValue(BitExpressionStates::GetBitIndex(first, seconds[node]));
+            break;
+        case BitExpressionKind::Neg:
+            calculate_values[node] = calculate_values[first] ^ 1;
+            break;
+        case BitExpressionKind::Or:
+            calculate_values[node] = calculate_values[first] | calculate_values[seconds[node]];
+            break;
+        case BitExpressionKind::And:
+            calculate_values[node] = calculate_values[first] & calculate_values[seconds[node]];
+            break;
+        default:
+            calculate_values[node] = calculate_values[first] ^ calculate_values[seconds[node]];
+            break;
+        }
+        calculate_epochs[node] = epoch;
+    }
+    return calculate_values[index] != 0;
+}
+
+int FlatBitExpressionEngine::Priority(uint32_t index) const
+{
+    switch (kinds[index])
+    {
+    case BitExpressionKind::Neg:
+        return 3;
+    case BitExpressionKind::Or:
+        return 0;
+    case BitExpressionKind::And:
+        return 2;
+    case BitExpressionKind::Xor:
+        return 1;
+    default:
+        return 4;
+    }
+}
+
+uint32_t FlatBitExpressionEngine::Optimize(uint32_t index, const BitExpressionStates& input)
+{
+    MaybeCollect();
+    const uint64_t epoch = input.GetEpoch();
+    if (optimized_epochs[index] == epoch)
+    {
+        return optimized[index];
+    }
+    CollectStale(index, optimized_epochs, epoch);
+    for (size_t i = 0; i < cone.size(); ++i)
+    {
+        const uint32_t node = cone[i];
+        const BitExpressionKind kind = kinds[node];
+        uint32_t result = node;
+        if (kind == BitExpressionKind::Variable)
+        {
+            const size_t bit_index = BitExpressionStates::GetBitIndex(firsts[node], seconds[node]);
+            if (input.IsInputBitConstant(bit_index))
+            {
+                result = input.GetInputBitValue(bit_index) ? 1 : 0;
+            }
+        }
+        else if (kind != BitExpressionKind::Const)
+        {
+            result = MakeNode(kind, optimized[firsts[node]], kind == BitExpressionKind::Neg ? 0 : optimized[seconds[node]]);
+        }
+        optimized[node] = result;
+        optimized_epochs[node] = epoch;
+    }
+    return optimized[index];
+}
+
+std::shared_ptr<IBitExpression> FlatBitExpressionEngine::GetHandle(uint32_t index)
+{
+    return BitExpressionTable::Intern<FlatBitExpression>(BitExpressionKey(BitExpressionKind::Handle, GetEngineId(), index), shared_from_this(), index);
+}
+
+void FlatBitExpressionEngine::Reference(uint32_t index)
+{
+    ++references[index];
+}
+
+void FlatBitExpressionEngine::Release(uint32_t index)
+{
+    --references[index];
+}
+
+// Frees the nodes no handle reaches; optimized results may point at them, so those are dropped too
+void FlatBitExpressionEngine::Collect()
+{
+    ++visit_epoch;
+    std::vector<uint32_t> stack;
+    for (uint32_t node = 0; node < kinds.size(); ++node)
+    {
+        if (references[node] && visit_epochs[node] != visit_epoch)
+        {
+            visit_epochs[node] = visit_epoch;
+            stack.push_back(node);
+        }
+        while (!stack.empty())
+        {
+            const uint32_t current = stack.back();
+            stack.pop_back();
+            const BitExpressionKind kind = kinds[current];
+            if (kind == BitExpressionKind::Const || kind == BitExpressionKind::Variable)
+            {
+                continue;
+            }
+            if (visit_epochs[firsts[current]] != visit_epoch)
+            {
+                visit_epochs[firsts[current]] = visit_epoch;
+                stack.push_back(firsts[current]);
+            }
+            if (kind != BitExpressionKind::Neg && visit_epochs[seconds[current]] != visit_epoch)
+            {
+                visit_epochs[seconds[current]] = visit_epoch;
+                stack.push_back(seconds[current]);
+            }
+        }
+    }
+    for (uint32_t node = 2; node < kinds.size(); ++node)
+    {
+        if (visit_epochs[node] != visit_epoch && kinds[node] != BitExpressionKind::Handle)
+        {
+            unique_nodes.erase(BitExpressionKey(kinds[node], firsts[node], seconds[node]));
+            kinds[node] = BitExpressionKind::Handle;
+            free_nodes.push_back(node);
+        }
+    }
+    std::fill(optimized_epochs.begin(), optimized_epochs.end(), 0);
+    collect_threshold = std::max<size_t>(1 << 16, 2 * GetNodeCount());
+}
+
+size_t FlatBitExpressionEngine::GetNodeCount() const
+{
+    return kinds.size() - free_nodes.size();
+}
+
+void FlatBitExpressionEngine::Export(const std::vector<const IBitExpression*>& expressions, IBitExpressionSink& sink, std::vector<uint32_t>& slots) const
+{
+    ++visit_epoch;
+    cone.clear();
+    for (size_t i = 0; i < expressions.size(); ++i)
+    {
+        if (expressions[i]->GetEngine() != this)
+        {
+            throw std::runtime_error("FlatBitExpressionEngine::Export(): expression belongs to another engine");
+        }
+        AppendCone(static_cast<const FlatBitExpression*>(expressions[i])->GetIndex(), nullptr, 0);
+    }
+    std::vector<uint32_t> node_slots(kinds.size());
+    for (size_t i = 0; i < cone.size(); ++i)
+    {
+        const uint32_t node = cone[i];
+        const uint32_t first = firsts[node];
+        switch (kinds[node])
+        {
+        case BitExpressionKind::Const:
+            node_slots[node] = sink.Const(first != 0);
+            break;
+        case BitExpressionKind::Variable:
+            node_slots[node] = sink.Variable(first, seconds[node]);
+            break;
+        case BitExpressionKind::Neg:
+            node_slots[node] = sink.Neg(node_slots[first]);
+            break;
+        case BitExpressionKind::Or:
+            node_slots[node] = sink.Or(node_slots[first], node_slots[seconds[node]]);
+            break;
+        case BitExpressionKind::And:
+            node_slots[node] = sink.And(node_slots[first], node_slots[seconds[node]]);
+            break;
+        default:
+            node_slots[node] = sink.Xor(node_slots[first], node_slots[seconds[node]]);
+            break;
+        }
+    }
+    slots.clear();
+    for (size_t i = 0; i < expressions.size(); ++i)
+    {
+        slots.push_back(node_slots[static_cast<const FlatBitExpression*>(expressions[i])->GetIndex()]);
+    }
+}
+
+// Applies the local constant, double negation and complement rules before adding a node
+uint32_t FlatBitExpressionEngine::MakeNode(BitExpressionKind kind, uint32_t first, uint32_t second)
+{
+    if (kind == BitExpressionKind::Neg)
+    {
+        if (kinds[first] == BitExpressionKind::Const)
+        {
+            return firsts[first] ^ 1;
+        }
+        if (kinds[first] == BitExpressionKind::Neg)
+        {
+            return firsts[first];
+        }
+        return AddNode(BitExpressionKind::Neg, first, 0);
+    }
+    const bool left_constant = kinds[first] == BitExpressionKind::Const;
+    const bool right_constant = kinds[second] == BitExpressionKind::Const;
+    const bool complementary = (kinds[first] == BitExpressionKind::Neg && firsts[first] == second) || (kinds[second] == BitExpressionKind::Neg && firsts[second] == first);
+    if (left_constant && right_constant)
+    {
+        const uint32_t left_value = firsts[first];
+        const uint32_t right_value = firsts[second];
+        return kind == BitExpressionKind::Or ? left_value | right_value : kind == BitExpressionKind::And ? left_value & right_value : left_value ^ right_value;
+    }
+    if (left_constant || right_constant)
+    {
+        const uint32_t constant_value = firsts[left_constant ? first : second];
+        const uint32_t other = left_constant ? second : first;
+        if (kind == BitExpressionKind::Or)
+        {
+            return constant_value ? 1 : other;
+        }
+        if (kind == BitExpressionKind::And)
+        {
+            return constant_value ? other : 0;
+        }
+        return constant_value ? MakeNode(BitExpressionKind::Neg, other, 0) : other;
+    }
+    if (first == second)
+    {
+        return kind == BitExpressionKind::Xor ? 0 : first;
+    }
+    if (complementary)
+    {
+        return kind == BitExpressionKind::And ? 0 : 1;
+    }
+    return AddBinaryNode(kind, first, second);
+}
+
+uint32_t FlatBitExpressionEngine::AddNode(BitExpressionKind kind, uint32_t first, uint32_t second)
+{
+    const BitExpressionKey key(kind, first, second);
+    auto found = unique_nodes.find(key);
+    if (found != unique_nodes.end())
+    {
+        return found->second;
+    }
+    uint32_t index;
+    if (!free_nodes.empty())
+    {
+        index = free_nodes.back();
+        free_nodes.pop_back();
+        kinds[index] = kind;
+        firsts[index] = first;
+        seconds[index] = second;
+        constant_epochs[index] = 0;
+        calculate_epochs[index] = 0;
+        optimized_epochs[index] = 0;
+    }
+    else
+    {
+        index = static_cast<uint32_t>(kinds.size());
+        kinds.push_back(kind);
+        firsts.push_back(first);
+        seconds.push_back(second);
+        references.push_back(0);
+        visit_epochs.push_back(0);
+        constant_epochs.push_back(0);
+        constant_values.push_back(0);
+        calculate_epochs.push_back(0);
+        calculate_values.push_back(0);
+        optimized_epochs.push_back(0);
+        optimized.push_back(0);
+    }
+    unique_nodes.insert(std::make_pair(key, index));
+    return index;
+}
+
+uint32_t FlatBitExpressionEngine::AddBinaryNode(BitExpressionKind kind, uint32_t left, uint32_t right)
+{
+    return left < right ? AddNode(kind, left, right) : AddNode(kind, right, left);
+}
+
+uint32_t FlatBitExpressionEngine::GetIndex(const std::shared_ptr<IBitExpression>& expression) const
+{
+    return static_cast<const FlatBitExpression*>(expression.get())->GetIndex();
+}
+
+// Indices of freed nodes are reused, so a node may precede its operands; the cone is ordered by a
+// depth-first walk instead
+void FlatBitExpressionEngine::CollectStale(uint32_t index, const std::vector<uint64_t>& epochs, uint64_t epoch) const
+{
+    ++visit_epoch;
+    cone.clear();
+    AppendCone(index, &epochs, epoch);
+}
+
+void FlatBitExpressionEngine::AppendCone(uint32_t index, const std::vector<uint64_t>* epochs, uint64_t epoch) const
+{
+    frames.push_back(std::make_pair(index, false));
+    while (!frames.empty())
+    {
+        const uint32_t node = frames.back().first;
+        const bool expanded = frames.back().second;
+        frames.pop_back();
+        if (expanded)
+        {
+            cone.push_back(node);
+            continue;
+        }
+        if ((epochs && (*epochs)[node] == epoch) || visit_epochs[node] == visit_epoch)
+        {
+            continue;
+        }
+        visit_epochs[node] = visit_epoch;
+        frames.push_back(std::make_pair(node, true));
+        const BitExpressionKind kind = kinds[node];
+        if (kind != BitExpressionKind::Const && kind != BitExpressionKind::Variable)
+        {
+            frames.push_back(std::make_pair(firsts[node], false));
+            if (kind != BitExpressionKind::Neg)
+            {
+                frames.push_back(std::make_pair(seconds[node], false));
+            }
+        }
+    }
+}
+
+void FlatBitExpressionEngine::MaybeCollect()
+{
+    if (GetNodeCount() > collect_threshold)
+    {
+        Collect();
+    }
+}
+
+FlatBitExpression::FlatBitExpression(const std::shared_ptr<FlatBitExpressionEngine>& engine_, uint32_t index_)
+    : IBitExpression(BitExpressionKey(BitExpressionKind::Handle, engine_->GetEngineId(), index_)), engine(engine_), index(index_)
+{
+    engine->Reference(index);
+}
+
+FlatBitExpression::~FlatBitExpression()
+{
+    engine->Release(index);
+}
+
+std::string FlatBitExpression::ToString(const BitExpressionStates& info) const
+{
+    return engine->ToString(index, info);
+}
+
+bool FlatBitExpression::Constant(const BitExpressionStates& input) const
+{
+    return engine->Constant(index, input);
+}
+
+bool FlatBitExpression::Calculate(const BitExpressionStates& input) const
+{
+    return engine->Calculate(index, input);
+}
+
+int FlatBitExpression::Priority() const
+{
+    return engine->Priority(index);
+}
+
+void FlatBitExpression::Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) const
+{
+    const uint32_t optimized_index = engine->Optimize(index, input);
+    if (optimized_index != index)
+    {
+        output = engine->GetHandle(optimized_index);
+    }
+}
+
+IBitExpressionEngine* FlatBitExpression::GetEngine() const
+{
+    return engine.get();
+}
+
+uint32_t FlatBitExpression::GetIndex() const
+{
+    return index;
+}
@@ -0,0 +1,107 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "BitExpressions.h"
+
+class FlatBitExpressionEngine : public IBitExpressionEngine, public std::enable_shared_from_this<FlatBitExpressionEngine>
+{
+public:
+    FlatBitExpressionEngine();
+
+    std::shared_ptr<IBitExpression> Const(bool value);
+    std::shared_ptr<IBitExpression> Variable(size_t var_index, size_t bit_number);
+    std::shared_ptr<IBitExpression> Neg(const std::shared_ptr<IBitExpression>& argument);
+    std::shared_ptr<IBitExpression> Or(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
+    std::shared_ptr<IBitExpression> And(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
+    std::shared_ptr<IBitExpression> Xor(const std::shared_ptr<IBitExpression>& left, const std::shared_ptr<IBitExpression>& right);
+
+    std::string ToString(uint32_t index, const BitExpressionStates& info) const;
+    bool Constant(uint32_t index, const BitExpressionStates& input) const;
+    bool Calculate(uint32_t index, const BitExpressionStates& input) const;
+    int Priority(uint32_t index) const;
+    uint32_t Optimize(uint32_t index, const BitExpressionStates& input);
+    std::shared_ptr<IBitExpression> GetHandle(uint32_t index);
+    void Reference(uint32_t index);
+    void Release(uint32_t index);
+    void Collect();
+    size_t GetNodeCount() const;
+    void Export(const std::vector<const IBitExpression*>& expressions, IBitExpressionSink& sink, std::vector<uint32_t>& slots) const;
+private:
+    // ToString expands shared nodes, so operands past this many written nodes are elided as "..."
+    static const size_t max_string_nodes = 1 << 12;
+
+    uint32_t MakeNode(BitExpressionKind kind, uint32_t first, uint32_t second);
+    uint32_t AddNode(BitExpressionKind kind, uint32_t first, uint32_t second);
+    uint32_t AddBinaryNode(BitExpressionKind kind, uint32_t left, uint32_t right);
+    uint32_t GetIndex(const std::shared_ptr<IBitExpression>& expression) const;
+    // Lists the nodes under index not yet stamped with epoch, operands before the nodes using them
+    void CollectStale(uint32_t index, const std::vector<uint64_t>& epochs, uint64_t epoch) const;
+    // Appends the nodes under index not yet visited in visit_epoch or stamped in epochs to the cone
+    void AppendCone(uint32_t index, const std::vector<uint64_t>* epochs, uint64_t epoch) const;
+    void MaybeCollect();
+
+    // Freed nodes keep the Handle kind until they are reused
+    std::vector<BitExpressionKind> kinds;
+    std::vector<uint32_t> firsts;
+    std::vector<uint32_t> seconds;
+    std::vector<uint32_t> references;
+    std::vector<uint32_t> free_nodes;
+    std::unordered_map<BitExpressionKey, uint32_t, BitExpressionKeyHash> unique_nodes;
+    size_t collect_threshold;
+
+    mutable std::vector<uint32_t> cone;
+    mutable std::vector<std::pair<uint32_t, bool> > frames;
+    mutable std::vector<uint64_t> visit_epochs;
+    mutable uint64_t visit_epoch;
+    // Results are stamped with the epoch of the state they were computed for
+    mutable std::vector<uint64_t> constant_epochs;
+    mutable std::vector<uint8_t> constant_values;
+    mutable std::vector<uint64_t> calculate_epochs;
+    mutable std::vector<uint8_t> calculate_values;
+    std::vector<uint64_t> optimized_epochs;
+    std::vector<uint32_t> optimized;
+};
+
+struct FlatBitExpression : public IBitExpression
+{
+    FlatBitExpression(const std::shared_ptr<FlatBitExpressionEngine>& engine, uint32_t index);
+    ~FlatBitExpression();
+    std::string ToString(const BitExpressionStates& info) const;
+    bool Constant(const BitExpressionStates& input) const;
+    bool Calculate(const BitExpressionStates& input) const;
+    int Priority() const;
+    void Optimize(std::shared_ptr<IBitExpression>& output, const BitExpressionStates& input) const;
+    IBitExpressionEngine* GetEngine() const;
+    uint32_t GetIndex() const;
+private:
+    std::shared_ptr<FlatBitExpressionEngine> engine;
+    uint32_t index;
+};
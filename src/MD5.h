@@ -21,11 +21,24 @@
 
 #pragma once
 
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
+#include "AigBitExpressions.h"
+#include "AnfBitExpressions.h"
+#include "BddBitExpressions.h"
+#include "BitBytecode.h"
 #include "BitExpressions.h"
+#include "BitExpressionStatistics.h"
+#include "BitslicedEvaluator.h"
+#include "FlatBitExpressions.h"
+#include "PathExecutor.h"
 #include "Program.h"
+#include "ProgramSpecializer.h"
 #include "Utility.h"
 
 void CreateMD5(BitExpressionStates& state, Program& program)
@@ -310,6 +323,10 @@ void Print(uint32_t value0, uint32_t value1, uint32_t value2, uint32_t value3)
 void MD5Experiment()
 {
     BitExpressionStates input;
+    //input.SetEngine(std::make_shared<FlatBitExpressionEngine>());
+    //input.SetEngine(std::make_shared<AigBitExpressionEngine>());
+    //input.SetEngine(std::make_shared<AnfBitExpressionEngine>());
+    //input.SetEngine(std::make_shared<BddBitExpressionEngine>());
     Program program;
     CreateMD5(input, program);
 
@@ -325,8 +342,17 @@ void MD5Experiment()
     input.SetInputVarValue(1, 0x0080216f);
     input.SetInputVarValue(14, 0x00000030);
 
+    ProgramSpecializer specializer(program);
+    const std::shared_ptr<const Program> specialized = specializer.Specialize(input);
+
     BitExpressionStates output;
-    Execute(program, input, output);
+    Execute(*specialized, input, output);
+    //FileTracer tracer(TraceLevel::Summary, "md5_trace.txt");
+    //Execute(*specialized, input, output, nullptr, &tracer);
+    //ExecutionProfile profile;
+    //Execute(*specialized, input, output, &profile);
+    //std::ofstream profile_file("md5_profile.csv");
+    //profile.WriteCsv(profile_file, output);
 
     std::cout << "Bit expressions" << std::endl;
     PrintCurrentVar(output, 16);
@@ -339,9 +365,69 @@ void MD5Experiment()
     //PrintOutput(output);
     //std::cout << std::endl;
 
-    Print(output.GetOutputVarValue(16), output.GetOutputVarValue(17), output.GetOutputVarValue(18), output.GetOutputVarValue(19));
+    const std::shared_ptr<const BitBytecode> code = BitBytecode::Compile(output, { 16, 17, 18, 19 });
+    BitBytecodeVm vm(code);
+    vm.Run(output);
+    Print(vm.GetVarValue(16), vm.GetVarValue(17), vm.GetVarValue(18), vm.GetVarValue(19));
     output.SetInputBitValue(0, true);
-    Print(output.GetOutputVarValue(16), output.GetOutputVarValue(17), output.GetOutputVarValue(18), output.GetOutputVarValue(19));
+    vm.Run(output);
+    Print(vm.GetVarValue(16), vm.GetVarValue(17), vm.GetVarValue(18), vm.GetVarValue(19));
+    std::cout << std::endl;
+
+    std::cout << "Concrete" << std::endl;
+    ConcreteState concrete_state(output);
+    ExecuteConcrete(program, concrete_state);
+    Print(concrete_state.values[16], concrete_state.values[17], concrete_state.values[18], concrete_state.values[19]);
+    std::cout << std::endl;
+
+    std::cout << "Bitsliced" << std::endl;
+    BitslicedEvaluator evaluator(code);
+    for (uint64_t batch = 0; batch < evaluator.GetBatchCount(); ++batch)
+    {
+        evaluator.Evaluate(batch);
+        const BitslicedEvaluator::lanes_type valid_lanes = evaluator.GetValidLanes();
+        for (size_t lane = 0; lane < BitslicedEvaluator::lane_count; ++lane)
+        {
+            if ((valid_lanes >> lane) & 1)
+            {
+                Print(evaluator.GetVarValue(16, lane), evaluator.GetVarValue(17, lane), evaluator.GetVarValue(18, lane), evaluator.GetVarValue(19, lane));
+            }
+        }
+    }
+}
+
+void BitslicedBenchmark()
+{
+    BitExpressionStates input;
+    Program program;
+    CreateMD5(input, program);
+
+    // 22 free bits give 2^16 distinct batches, so every evaluated batch is real work
+    input.SetInputVarValue(0, 0x6c6c6548);
+    input.SetInputFreeMask(0, (1 << 22) - 1);
+    input.SetInputVarValue(1, 0x0080216f);
+    input.SetInputVarValue(14, 0x00000030);
+
+    BitExpressionStates output;
+    Execute(*ProgramSpecializer(program).Specialize(input), input, output);
+
+    for (size_t word_count = 1; word_count <= BitslicedEvaluator::GetMaxWordCount(); word_count *= word_count == 1 ? 4 : 2)
+    {
+        BitslicedEvaluator evaluator(output, { 16, 17, 18, 19 }, word_count);
+        const uint64_t batch_count = evaluator.GetBatchCount();
+        const uint64_t assignment_count = batch_count * __builtin_popcountll(evaluator.GetValidLanes());
+        BitslicedEvaluator::lanes_type checksum = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (uint64_t batch = 0; batch < batch_count; ++batch)
+        {
+            evaluator.Evaluate(batch);
+            checksum += evaluator.GetBitLanes(16, batch % output.GetBitCount());
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "lane width " << word_count * BitslicedEvaluator::lane_count << ": ";
+        std::cout << assignment_count / elapsed.count() << " assignments/s";
+        std::cout << " (checksum " << checksum << ")" << std::endl;
+    }
 }
 
 void SmallExperiment()
@@ -376,3 +462,143 @@ void SmallExperiment()
     PrintOutput(output);
     std::cout << std::endl;
 }
+
+// Cross-checks the ways of running a program: the original MD5 and its residual run concretely,
+// the bit bytecode VM and the bitsliced evaluator must agree for every assignment of the free
+// input bits; then every input of a forking loop must satisfy exactly one path condition of the
+// path executor and give the output of a concrete run
+void SelfCheck()
+{
+    BitExpressionStates input;
+    Program program;
+    CreateMD5(input, program);
+
+    const size_t free_bit_count = 8;
+    input.SetInputVarValue(0, 0x6c6c6548);
+    input.SetInputFreeMask(0, (1 << free_bit_count) - 1);
+    input.SetInputVarValue(1, 0x0080216f);
+    input.SetInputVarValue(14, 0x00000030);
+
+    const std::shared_ptr<const Program> specialized = ProgramSpecializer(program).Specialize(input);
+    BitExpressionStates output;
+    Execute(*specialized, input, output);
+
+    const std::vector<size_t> output_vars = { 16, 17, 18, 19 };
+    const std::shared_ptr<const ProgramBytecode> program_code = ProgramBytecode::Compile(program);
+    const std::shared_ptr<const ProgramBytecode> specialized_code = ProgramBytecode::Compile(*specialized);
+    const std::shared_ptr<const BitBytecode> code = BitBytecode::Compile(output, output_vars);
+    BitBytecodeVm vm(code);
+    BitslicedEvaluator evaluator(code);
+    uint64_t assignment_count = 0;
+    for (uint64_t batch = 0; batch < evaluator.GetBatchCount(); ++batch)
+    {
+        evaluator.Evaluate(batch);
+        for (size_t lane = 0; lane < BitslicedEvaluator::lane_count; ++lane)
+        {
+            if (!((evaluator.GetValidLanes() >> lane) & 1))
+            {
+                continue;
+            }
+            evaluator.GetAssignment(batch, lane, output);
+            ConcreteState program_state(output);
+            program_code->Run(program_state);
+            ConcreteState specialized_state(output);
+            specialized_code->Run(specialized_state);
+            if (program_state.values != specialized_state.values)
+            {
+                throw std::runtime_error("SelfCheck(): residual program differs from the original");
+            }
+            vm.Run(output);
+            for (size_t var_index : output_vars)
+            {
+                if (vm.GetVarValue(var_index) != program_state.values[var_index])
+                {
+                    throw std::runtime_error("SelfCheck(): bit bytecode VM differs from the concrete run");
+                }
+                if (evaluator.GetVarValue(var_index, lane) != program_state.values[var_index])
+                {
+                    throw std::runtime_error("SelfCheck(): bitsliced evaluator differs from the concrete run");
+                }
+            }
+            ++assignment_count;
+        }
+    }
+    if (assignment_count != 1 << free_bit_count)
+    {
+        throw std::runtime_error("SelfCheck(): not every assignment of the free bits was evaluated");
+    }
+    std::cout << "MD5: " << assignment_count << " assignments agree" << std::endl;
+
+    FullState loop_state;
+    Program loop_program;
+    auto x = loop_state.AddVariable("x", false, 0);
+    auto y = loop_state.AddVariable("y", true, 0x9e3779b9);
+    auto i = loop_state.AddVariable("i", true, 0);
+    auto r = loop_state.AddVariable("r", true, 0);
+    auto c = loop_state.AddVariable("c", true, 100);
+    loop_state.SetInputFreeMask(x, (1 << free_bit_count) - 1);
+
+    // while (i < x) { r += y; ++i; } if (x > c) r += c; else r ^= x; r ^= y;
+    IfALessBGoto::Create(loop_program, i, x)->SetDestinationLine(2);
+    auto to_join = Goto::Create(loop_program);
+    AddRA::Create(loop_program, r, y);
+    IncR::Create(loop_program, i);
+    Goto::Create(loop_program)->SetDestinationLine(0);
+    auto join = IfAMoreBGoto::Create(loop_program, x, c);
+    to_join->SetDestinationLine(join->GetLineNumber());
+    XorRA::Create(loop_program, r, x);
+    auto to_end = Goto::Create(loop_program);
+    join->SetDestinationLine(AddRA::Create(loop_program, r, c)->GetLineNumber());
+    to_end->SetDestinationLine(XorRA::Create(loop_program, r, y)->GetLineNumber());
+
+    // Several threads share the unique table and steal paths from each other, so the executor also
+    // runs on 4 threads and must give the paths of the single-thread run
+    const std::shared_ptr<const ProgramBytecode> loop_code = ProgramBytecode::Compile(loop_program);
+    for (bool merge : { false, true })
+    {
+        size_t single_thread_path_count = 0;
+        for (size_t thread_count : { 1, 4 })
+        {
+            PathExecutor executor(loop_program, thread_count);
+            if (merge)
+            {
+                executor.AddMergePoint(join->GetLineNumber());
+                executor.AddMergePoint(to_end->GetDestinationLine());
+            }
+            const std::vector<std::shared_ptr<FullState> > paths = executor.Run(loop_state);
+            for (uint32_t x_value = 0; x_value < 1 << free_bit_count; ++x_value)
+            {
+                ConcreteState concrete_state(loop_state);
+                concrete_state.values[x] = x_value;
+                loop_code->Run(concrete_state);
+                size_t taken_count = 0;
+                for (const std::shared_ptr<FullState>& path : paths)
+                {
+                    path->SetInputVarValue(x, x_value);
+                    if (!path->path_condition->Calculate(*path))
+                    {
+                        continue;
+                    }
+                    ++taken_count;
+                    if (path->GetOutputVarValue(r) != concrete_state.values[r])
+                    {
+                        throw std::runtime_error("SelfCheck(): path executor differs from the concrete run");
+                    }
+                }
+                if (taken_count != 1)
+                {
+                    throw std::runtime_error("SelfCheck(): an input does not take exactly one path");
+                }
+            }
+            if (thread_count == 1)
+            {
+                single_thread_path_count = paths.size();
+            }
+            else if (paths.size() != single_thread_path_count)
+            {
+                throw std::runtime_error("SelfCheck(): path executor gives another path count on several threads");
+            }
+            std::cout << "Path executor" << (merge ? " with merge points" : "") << " on " << thread_count << (thread_count == 1 ? " thread: " : " threads: ") << paths.size() << " paths agree" << std::endl;
+        }
+    }
+}
@@ -20,17 +20,25 @@
  */
 
 #include <cstdlib>
+#include <string>
 
 #include "Execute.h"
 #include "Utility.h"
 #include "MD5.h"
 
-int main()
+int main(int argc, char* argv[])
 {
     try
     {
+        // --self-check runs the consistency checks that ctest registers
+        if (argc > 1 && std::string(argv[1]) == "--self-check")
+        {
+            SelfCheck();
+            return EXIT_SUCCESS;
+        }
         //SmallExperiment();
         MD5Experiment();
+        //BitslicedBenchmark();
     }
     catch (const std::exception& error)
     {
@@ -0,0 +1,370 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "PathExecutor.h"
+#include "WordExpressions.h"
+
+namespace
+{
+    template<typename W>
+    struct Path
+    {
+        std::shared_ptr<BasicFullState<W> > state;
+        // Set when leaving a merge point, so the path does not wait there again
+        bool resumed;
+    };
+
+    bool IsBranch(ProgramOpcode opcode)
+    {
+        return opcode == ProgramOpcode::IfAMoreBGoto || opcode == ProgramOpcode::IfALessBGoto;
+    }
+
+    bool IsFeasible(const std::shared_ptr<IBitExpression>& condition, const BitExpressionStates& state)
+    {
+        return !condition->Constant(state) || condition->Calculate(state);
+    }
+
+    std::shared_ptr<IBitExpression> OptimizeBit(const std::shared_ptr<IBitExpression>& expression, const BitExpressionStates& state)
+    {
+        std::shared_ptr<IBitExpression> result = expression;
+        expression->Optimize(result, state);
+        return result;
+    }
+
+    // Word expressions fill their bits on first query, so they are blasted before a state is shared
+    void BlastWords(const BitExpressionStates& state)
+    {
+        for (size_t var_index = 0; var_index < state.GetVariableCount(); ++var_index)
+        {
+            state.GetBitExpression(BitExpressionStates::GetBitIndex(var_index, 0));
+        }
+    }
+
+    template<typename W>
+    struct PathScheduler
+    {
+        typedef std::shared_ptr<BasicFullState<W> > state_type;
+
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<Path<W> > paths;
+        };
+
+        PathScheduler(const BasicProgramBytecode<W>& code_, const std::vector<bool>& merge_points_, size_t worker_count, size_t max_path_count_)
+            : code(code_), merge_points(merge_points_), max_path_count(max_path_count_), pending(0), queued(0), path_count(0), stopped(false)
+        {
+            for (size_t worker = 0; worker < worker_count; ++worker)
+            {
+                workers.push_back(std::unique_ptr<Worker>(new Worker));
+            }
+        }
+
+        // Runs until every path has finished or parked at a merge point
+        void RunWorkers()
+        {
+            std::vector<std::thread> threads;
+            for (size_t worker = 1; worker < workers.size(); ++worker)
+            {
+                threads.push_back(std::thread(&PathScheduler::Work, this, worker));
+            }
+            Work(0);
+            for (size_t i = 0; i < threads.size(); ++i)
+            {
+                threads[i].join();
+            }
+            if (failure)
+            {
+                std::rethrow_exception(failure);
+            }
+        }
+
+        void Push(size_t worker, const Path<W>& path)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++pending;
+                ++queued;
+            }
+            {
+                std::lock_guard<std::mutex> lock(workers[worker]->mutex);
+                workers[worker]->paths.push_back(path);
+            }
+            idle.notify_one();
+        }
+
+        void AddPaths(size_t count)
+        {
+            if ((path_count += count) > max_path_count)
+                throw std::runtime_error("BasicPathExecutor::Run(): path limit exceeded");
+        }
+
+        // Joins the paths parked at each merge point and queues the results
+        void Merge()
+        {
+            std::map<size_t, std::vector<state_type> > groups;
+            for (size_t i = 0; i < parked.size(); ++i)
+            {
+                groups[parked[i]->statement_index].push_back(parked[i]);
+            }
+            parked.clear();
+            for (auto& group : groups)
+            {
+                Path<W> path = { group.second.size() == 1 ? group.second[0] : Join(group.second), true };
+                path_count -= group.second.size() - 1;
+                Push(0, path);
+            }
+        }
+
+        std::vector<state_type> finished;
+        std::vector<state_type> parked;
+    private:
+        void Work(size_t worker)
+        {
+            for (;;)
+            {
+                Path<W> path;
+                if (Take(worker, path))
+                {
+                    try
+                    {
+                        RunPath(worker, path);
+                    }
+                    catch (...)
+                    {
+                        Fail(std::current_exception());
+                    }
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(mutex);
+                if (!pending || failure)
+                {
+                    return;
+                }
+                idle.wait(lock, [this] { return queued > 0 || !pending || failure; });
+            }
+        }
+
+        // Owners take their newest path, thieves the oldest one of another worker
+        bool Take(size_t worker, Path<W>& path)
+        {
+            for (size_t i = 0; i < workers.size(); ++i)
+            {
+                Worker& victim = *workers[(worker + i) % workers.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (victim.paths.empty())
+                {
+                    continue;
+                }
+                if (i == 0)
+                {
+                    path = victim.paths.back();
+                    victim.paths.pop_back();
+                }
+                else
+                {
+                    path = victim.paths.front();
+                    victim.paths.pop_front();
+                }
+                --queued;
+                return true;
+            }
+            return false;
+        }
+
+        void RunPath(size_t worker, const Path<W>& path)
+        {
+            BasicFullState<W>& state = *path.state;
+            bool resumed = path.resumed;
+            while (state.statement_index < code.instructions.size())
+            {
+                if (stopped)
+                {
+                    return;
+                }
+                if (merge_points[state.statement_index] && !resumed)
+                {
+                    Retire(parked, path.state);
+                    return;
+                }
+                resumed = false;
+                const BasicInstruction<W>& instruction = code.instructions[state.statement_index];
+                if (IsBranch(instruction.opcode) && (!state.IsCurrentVarConstant(instruction.result) || !state.IsCurrentVarConstant(instruction.argument)))
+                {
+                    Branch(worker, state, instruction);
+                }
+                else
+                {
+                    ExecuteInstruction(instruction, state);
+                }
+                state.Optimize();
+            }
+            Retire(finished, path.state);
+        }
+
+        void Branch(size_t worker, BasicFullState<W>& state, const BasicInstruction<W>& instruction)
+        {
+            const std::shared_ptr<WordExpression> a = state.GetWordExpression(instruction.result);
+            const std::shared_ptr<WordExpression> b = state.GetWordExpression(instruction.argument);
+            const std::shared_ptr<IBitExpression> condition = OptimizeBit(instruction.opcode == ProgramOpcode::IfALessBGoto ? word_less(a, b) : word_less(b, a), state);
+            const std::shared_ptr<IBitExpression> taken = OptimizeBit(state.path_condition & condition, state);
+            const std::shared_ptr<IBitExpression> skipped = OptimizeBit(state.path_condition & ~condition, state);
+            if (!IsFeasible(skipped, state))
+            {
+                state.path_condition = taken;
+                state.statement_index = instruction.target;
+                return;
+            }
+            if (!IsFeasible(taken, state))
+            {
+                state.path_condition = skipped;
+                ++state.statement_index;
+                return;
+            }
+            AddPaths(1);
+            BlastWords(state);
+            Path<W> fork = { std::make_shared<BasicFullState<W> >(state), false };
+            fork.state->path_condition = taken;
+            fork.state->statement_index = instruction.target;
+            Push(worker, fork);
+            state.path_condition = skipped;
+            ++state.statement_index;
+        }
+
+        // Every bit selects the value of the path whose condition holds; the conditions are disjoint
+        static state_type Join(const std::vector<state_type>& group)
+        {
+            state_type result = std::make_shared<BasicFullState<W> >(*group[0]);
+            for (size_t var_index = 0; var_index < result->GetVariableCount(); ++var_index)
+            {
+                for (size_t bit_number = 0; bit_number < BasicFullState<W>::bit_count; ++bit_number)
+                {
+                    const size_t bit_index = BitExpressionStates::GetBitIndex(var_index, bit_number);
+                    const std::shared_ptr<IBitExpression> first = group[0]->GetBitExpression(bit_index);
+                    size_t i = 1;
+                    while (i < group.size() && group[i]->GetBitExpression(bit_index).get() == first.get())
+                    {
+                        ++i;
+                    }
+                    if (i == group.size())
+                    {
+                        continue;
+                    }
+                    std::shared_ptr<IBitExpression> bit = group[0]->path_condition & first;
+                    for (i = 1; i < group.size(); ++i)
+                    {
+                        bit = bit | (group[i]->path_condition & group[i]->GetBitExpression(bit_index));
+                    }
+                    result->SetBitExpression(bit_index, bit);
+                }
+            }
+            std::shared_ptr<IBitExpression> path_condition = group[0]->path_condition;
+            for (size_t i = 1; i < group.size(); ++i)
+            {
+                path_condition = path_condition | group[i]->path_condition;
+            }
+            result->Optimize();
+            result->path_condition = OptimizeBit(path_condition, *result);
+            return result;
+        }
+
+        void Retire(std::vector<state_type>& states, const state_type& state)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            states.push_back(state);
+            if (!--pending)
+            {
+                idle.notify_all();
+            }
+        }
+
+        void Fail(const std::exception_ptr& exception)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!failure)
+            {
+                failure = exception;
+            }
+            stopped = true;
+            idle.notify_all();
+        }
+
+        const BasicProgramBytecode<W>& code;
+        const std::vector<bool>& merge_points;
+        size_t max_path_count;
+        std::vector<std::unique_ptr<Worker> > workers;
+        // Guards pending, the finished and parked states and the failure
+        std::mutex mutex;
+        std::condition_variable idle;
+        size_t pending;
+        std::atomic<size_t> queued;
+        std::atomic<size_t> path_count;
+        std::atomic<bool> stopped;
+        std::exception_ptr failure;
+    };
+}
+
+template<typename W>
+BasicPathExecutor<W>::BasicPathExecutor(const BasicProgram<W>& program, size_t thread_count_, size_t max_path_count_)
+    : code(BasicProgramBytecode<W>::Compile(program)), thread_count(thread_count_ ? thread_count_ : std::max<size_t>(std::thread::hardware_concurrency(), 1)),
+      max_path_count(max_path_count_), merge_points(program.statements.size(), false)
+{
+}
+
+template<typename W>
+void BasicPathExecutor<W>::AddMergePoint(size_t statement_index)
+{
+    if (statement_index >= merge_points.size())
+        throw std::runtime_error("BasicPathExecutor::AddMergePoint(): statement index is out of range");
+
+    merge_points[statement_index] = true;
+}
+
+template<typename W>
+std::vector<std::shared_ptr<BasicFullState<W> > > BasicPathExecutor<W>::Run(const BasicFullState<W>& initial_state) const
+{
+    PathScheduler<W> scheduler(*code, merge_points, initial_state.GetEngine() ? 1 : thread_count, max_path_count);
+    scheduler.AddPaths(1);
+    Path<W> initial = { std::make_shared<BasicFullState<W> >(initial_state), false };
+    scheduler.Push(0, initial);
+    scheduler.RunWorkers();
+    while (!scheduler.parked.empty())
+    {
+        scheduler.Merge();
+        scheduler.RunWorkers();
+    }
+    return scheduler.finished;
+}
+
+template struct BasicPathExecutor<uint8_t>;
+template struct BasicPathExecutor<uint16_t>;
+template struct BasicPathExecutor<uint32_t>;
+template struct BasicPathExecutor<uint64_t>;
@@ -0,0 +1,59 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "BitExpressions.h"
+#include "Program.h"
+#include "ProgramBytecode.h"
+
+// Runs a program symbolically over every path its branches on free inputs can take. A branch
+// whose comparison is not constant forks the state: each side extends the path condition with
+// the comparator outcome and is dropped once that condition optimizes to false. Paths are
+// scheduled on per-thread deques, idle threads stealing the oldest path of another thread.
+// Paths reaching a merge point wait there until no other work is left, then paths at the same
+// point are joined into one whose bits select between them by path condition.
+// States with an engine are run on one thread, since engines are not shared between threads;
+// a thread count of 0 uses every hardware thread
+template<typename W>
+struct BasicPathExecutor
+{
+    static const size_t default_max_path_count = 1 << 10;
+
+    explicit BasicPathExecutor(const BasicProgram<W>& program, size_t thread_count = 1, size_t max_path_count = default_max_path_count);
+
+    void AddMergePoint(size_t statement_index);
+
+    // Returns the final state of every path, each with its path condition
+    std::vector<std::shared_ptr<BasicFullState<W> > > Run(const BasicFullState<W>& initial_state) const;
+private:
+    std::shared_ptr<const BasicProgramBytecode<W> > code;
+    size_t thread_count;
+    size_t max_path_count;
+    std::vector<bool> merge_points;
+};
+
+typedef BasicPathExecutor<uint32_t> PathExecutor;
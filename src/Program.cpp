@@ -22,21 +22,73 @@
 #include <sstream>
 
 #include "Program.h"
+#include "ProgramBytecode.h"
 
-FullState::FullState() : statement_index(0)
+namespace
 {
+    template<typename W>
+    BasicInstruction<W> MakeInstruction(ProgramOpcode opcode, size_t result = 0, size_t argument = 0, size_t index = 0, size_t target = 0, W value = 0)
+    {
+        BasicInstruction<W> instruction;
+        instruction.opcode = opcode;
+        instruction.result = static_cast<uint32_t>(result);
+        instruction.argument = static_cast<uint32_t>(argument);
+        instruction.index = static_cast<uint32_t>(index);
+        instruction.target = static_cast<uint32_t>(target);
+        instruction.value = value;
+        return instruction;
+    }
+}
+
+template<typename W>
+BasicFullState<W>::BasicFullState() : statement_index(0), path_condition(const_bool(true))
+{
+}
+
+template<typename W>
+BasicConcreteState<W>::BasicConcreteState() : statement_index(0)
+{
+}
+
+template<typename W>
+BasicConcreteState<W>::BasicConcreteState(size_t variable_count) : values(variable_count), statement_index(0)
+{
+}
+
+template<typename W>
+BasicConcreteState<W>::BasicConcreteState(const BitExpressionStates& input) : values(input.GetVariableCount()), statement_index(0)
+{
+    for (size_t var_index = 0; var_index < values.size(); ++var_index)
+    {
+        values[var_index] = static_cast<W>(input.GetInputVarValue(var_index));
+    }
 }
 
-size_t IStatement::GetLineNumber() const
+template<typename W>
+size_t BasicStatement<W>::GetLineNumber() const
 {
     return line_number;
 }
 
-IStatement::~IStatement()
+template<typename W>
+BasicStatement<W>::~BasicStatement()
+{
+}
+
+template<typename W>
+void BasicStatement<W>::Execute(BasicFullState<W>& state) const
+{
+    ExecuteInstruction(Lower(), state);
+}
+
+template<typename W>
+void BasicStatement<W>::ExecuteConcrete(BasicConcreteState<W>& state) const
 {
+    ExecuteInstruction(Lower(), state);
 }
 
-std::string IStatement::Print(const FullState& info) const
+template<typename W>
+std::string BasicStatement<W>::Print(const BasicFullState<W>& info) const
 {
     std::string prefix = "";
     if (info.statement_index == GetLineNumber())
@@ -53,521 +105,414 @@ std::string IStatement::Print(const FullState& info) const
     }
 }
 
-std::string IStatement::GetLabel() const
+template<typename W>
+std::string BasicStatement<W>::GetLabel() const
 {
     return label;
 }
 
-IStatement::IStatement(const Program& program_, size_t line_number_, const std::string& label_)
+template<typename W>
+BasicStatement<W>::BasicStatement(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_)
     : program(program_), line_number(line_number_), label(label_)
 {
 }
 
-std::shared_ptr<Nop> Nop::Create(Program& program, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicNop<W> > BasicNop<W>::Create(BasicProgram<W>& program, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<Nop>(Nop(program, line_number, label));
+    auto new_statement = std::make_shared<BasicNop>(BasicNop(program, line_number, label));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void Nop::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicNop<W>::Lower() const
 {
-    ++state.statement_index;
+    return MakeInstruction<W>(ProgramOpcode::Nop);
 }
 
-std::string Nop::Print(const FullState& info) const
+template<typename W>
+std::string BasicNop<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "Nop";
+    return BasicStatement<W>::Print(info) + "Nop";
 }
 
-Nop::Nop(const Program& program_, size_t line_number_, const std::string& label) : IStatement(program_, line_number_, label)
+template<typename W>
+BasicNop<W>::BasicNop(const BasicProgram<W>& program_, size_t line_number_, const std::string& label) : BasicStatement<W>(program_, line_number_, label)
 {
 }
 
-std::shared_ptr<SetConstant> SetConstant::Create(Program& program, size_t result_index, BitExpressionStates::work_type value, bool hex, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicSetConstant<W> > BasicSetConstant<W>::Create(BasicProgram<W>& program, size_t result_index, W value, bool hex, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<SetConstant>(SetConstant(program, line_number, label, result_index, value, hex));
+    auto new_statement = std::make_shared<BasicSetConstant>(BasicSetConstant(program, line_number, label, result_index, value, hex));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void SetConstant::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicSetConstant<W>::Lower() const
 {
-    for (size_t bit_number = 0; bit_number < BitExpressionStates::bit_count; ++bit_number)
-    {
-        const size_t result_bit_index = state.GetBitIndex(result_index, bit_number);
-        const bool bit_value = BitExpressionStates::ExtractBit(value, bit_number);
-        state.SetBitExpression(result_bit_index, const_bool(bit_value));
-    }
-    ++state.statement_index;
+    return MakeInstruction<W>(ProgramOpcode::SetConstant, result_index, 0, 0, 0, value);
 }
 
-std::string SetConstant::Print(const FullState& info) const
+template<typename W>
+std::string BasicSetConstant<W>::Print(const BasicFullState<W>& info) const
 {
     std::string value_str = std::to_string(value);
 
     if (hex)
     {
         std::stringstream ss;
-        ss << std::hex << "0x" << value;
+        ss << std::hex << "0x" << static_cast<uint64_t>(value);
         value_str = ss.str();
     }
 
-    return IStatement::Print(info) + "Let " + info.GetVarName(result_index) + " = " + value_str;
+    return BasicStatement<W>::Print(info) + "Let " + info.GetVarName(result_index) + " = " + value_str;
 }
 
-SetConstant::SetConstant(const Program& program_, size_t line_number_, const std::string& label_, size_t result_index_, BitExpressionStates::work_type value_, bool hex_)
-    : IStatement(program_, line_number_, label_), result_index(result_index_), value(value_), hex(hex_)
+template<typename W>
+BasicSetConstant<W>::BasicSetConstant(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, size_t result_index_, W value_, bool hex_)
+    : BasicStatement<W>(program_, line_number_, label_), result_index(result_index_), value(value_), hex(hex_)
 {
 }
 
-std::shared_ptr<LetRA> LetRA::Create(Program& program, size_t result_index, size_t argument_index, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicLetRA<W> > BasicLetRA<W>::Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<LetRA>(LetRA(program, line_number, label, result_index, argument_index));
+    auto new_statement = std::make_shared<BasicLetRA>(BasicLetRA(program, line_number, label, result_index, argument_index));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void LetRA::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicLetRA<W>::Lower() const
 {
-    for (size_t bit_number = 0; bit_number < BitExpressionStates::bit_count; ++bit_number)
-    {
-        const size_t result_bit_index = state.GetBitIndex(result_index, bit_number);
-        const size_t source_bit_index = state.GetBitIndex(argument_index, bit_number);
-        state.SetBitExpression(result_bit_index, state.GetBitExpression(source_bit_index));
-    }
-    ++state.statement_index;
+    return MakeInstruction<W>(ProgramOpcode::LetRA, result_index, argument_index);
 }
 
-std::string LetRA::Print(const FullState& info) const
+template<typename W>
+std::string BasicLetRA<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(argument_index);
+    return BasicStatement<W>::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(argument_index);
 }
 
-LetRA::LetRA(const Program& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
-    : IStatement(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
+template<typename W>
+BasicLetRA<W>::BasicLetRA(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
+    : BasicStatement<W>(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
 {
 }
 
-std::shared_ptr<LetRAI> LetRAI::Create(Program& program, size_t result_index, size_t argument_index, size_t index_index, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicLetRAI<W> > BasicLetRAI<W>::Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, size_t index_index, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<LetRAI>(LetRAI(program, line_number, label, result_index, argument_index, index_index));
+    auto new_statement = std::make_shared<BasicLetRAI>(BasicLetRAI(program, line_number, label, result_index, argument_index, index_index));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void LetRAI::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicLetRAI<W>::Lower() const
 {
-    if (state.IsCurrentVarConstant(index_index))
-    {
-        const size_t source_index = argument_index + state.GetCurrentVarValue(index_index);
-        for (size_t bit_number = 0; bit_number < BitExpressionStates::bit_count; ++bit_number)
-        {
-            const size_t result_bit_index = state.GetBitIndex(result_index, bit_number);
-            const size_t source_bit_index = state.GetBitIndex(source_index, bit_number);
-            state.SetBitExpression(result_bit_index, state.GetBitExpression(source_bit_index));
-        }
-    }
-    else
-    {
-        //TODO:
-        throw std::runtime_error("not implemented");
-    }
-    ++state.statement_index;
+    return MakeInstruction<W>(ProgramOpcode::LetRAI, result_index, argument_index, index_index);
 }
 
-std::string LetRAI::Print(const FullState& info) const
+template<typename W>
+std::string BasicLetRAI<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(argument_index) + "[" + info.GetVarName(index_index) + "]";
+    return BasicStatement<W>::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(argument_index) + "[" + info.GetVarName(index_index) + "]";
 }
 
-LetRAI::LetRAI(const Program& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_, size_t index_index_)
-    : IStatement(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_), index_index(index_index_)
+template<typename W>
+BasicLetRAI<W>::BasicLetRAI(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_, size_t index_index_)
+    : BasicStatement<W>(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_), index_index(index_index_)
 {
 }
 
-std::shared_ptr<AndRA> AndRA::Create(Program& program, size_t result_index, size_t argument_index, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicAndRA<W> > BasicAndRA<W>::Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<AndRA>(AndRA(program, line_number, label, result_index, argument_index));
+    auto new_statement = std::make_shared<BasicAndRA>(BasicAndRA(program, line_number, label, result_index, argument_index));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void AndRA::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicAndRA<W>::Lower() const
 {
-    for (size_t bit_number = 0; bit_number < BitExpressionStates::bit_count; ++bit_number)
-    {
-        const size_t result_bit_index = state.GetBitIndex(result_index, bit_number);
-        const size_t source_bit_index = state.GetBitIndex(argument_index, bit_number);
-        state.SetBitExpression(result_bit_index, state.GetBitExpression(result_bit_index) & state.GetBitExpression(source_bit_index));
-    }
-    ++state.statement_index;
+    return MakeInstruction<W>(ProgramOpcode::AndRA, result_index, argument_index);
 }
 
-std::string AndRA::Print(const FullState& info) const
+template<typename W>
+std::string BasicAndRA<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(result_index) + " & " + info.GetVarName(argument_index);
+    return BasicStatement<W>::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(result_index) + " & " + info.GetVarName(argument_index);
 }
 
-AndRA::AndRA(const Program& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
-    : IStatement(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
+template<typename W>
+BasicAndRA<W>::BasicAndRA(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
+    : BasicStatement<W>(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
 {
 }
 
-std::shared_ptr<OrRA> OrRA::Create(Program& program, size_t result_index, size_t argument_index, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicOrRA<W> > BasicOrRA<W>::Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<OrRA>(OrRA(program, line_number, label, result_index, argument_index));
+    auto new_statement = std::make_shared<BasicOrRA>(BasicOrRA(program, line_number, label, result_index, argument_index));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void OrRA::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicOrRA<W>::Lower() const
 {
-    for (size_t bit_number = 0; bit_number < BitExpressionStates::bit_count; ++bit_number)
-    {
-        const size_t result_bit_index = state.GetBitIndex(result_index, bit_number);
-        const size_t source_bit_index = state.GetBitIndex(argument_index, bit_number);
-        state.SetBitExpression(result_bit_index, state.GetBitExpression(result_bit_index) | state.GetBitExpression(source_bit_index));
-    }
-    ++state.statement_index;
+    return MakeInstruction<W>(ProgramOpcode::OrRA, result_index, argument_index);
 }
 
-std::string OrRA::Print(const FullState& info) const
+template<typename W>
+std::string BasicOrRA<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(result_index) + " | " + info.GetVarName(argument_index);
+    return BasicStatement<W>::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(result_index) + " | " + info.GetVarName(argument_index);
 }
 
-OrRA::OrRA(const Program& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
-    : IStatement(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
+template<typename W>
+BasicOrRA<W>::BasicOrRA(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
+    : BasicStatement<W>(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
 {
 }
 
-std::shared_ptr<XorRA> XorRA::Create(Program& program, size_t result_index, size_t argument_index, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicXorRA<W> > BasicXorRA<W>::Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<XorRA>(XorRA(program, line_number, label, result_index, argument_index));
+    auto new_statement = std::make_shared<BasicXorRA>(BasicXorRA(program, line_number, label, result_index, argument_index));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void XorRA::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicXorRA<W>::Lower() const
 {
-    for (size_t bit_number = 0; bit_number < BitExpressionStates::bit_count; ++bit_number)
-    {
-        const size_t result_bit_index = state.GetBitIndex(result_index, bit_number);
-        const size_t source_bit_index = state.GetBitIndex(argument_index, bit_number);
-        state.SetBitExpression(result_bit_index, state.GetBitExpression(result_bit_index) ^ state.GetBitExpression(source_bit_index));
-    }
-    ++state.statement_index;
+    return MakeInstruction<W>(ProgramOpcode::XorRA, result_index, argument_index);
 }
 
-std::string XorRA::Print(const FullState& info) const
+template<typename W>
+std::string BasicXorRA<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(result_index) + " ^ " + info.GetVarName(argument_index);
+    return BasicStatement<W>::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(result_index) + " ^ " + info.GetVarName(argument_index);
 }
 
-XorRA::XorRA(const Program& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
-    : IStatement(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
+template<typename W>
+BasicXorRA<W>::BasicXorRA(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
+    : BasicStatement<W>(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
 {
 }
 
-std::shared_ptr<InverseR> InverseR::Create(Program& program, size_t result_index, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicInverseR<W> > BasicInverseR<W>::Create(BasicProgram<W>& program, size_t result_index, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<InverseR>(InverseR(program, line_number, label, result_index));
+    auto new_statement = std::make_shared<BasicInverseR>(BasicInverseR(program, line_number, label, result_index));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void InverseR::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicInverseR<W>::Lower() const
 {
-    for (size_t bit_number = 0; bit_number < BitExpressionStates::bit_count; ++bit_number)
-    {
-        const size_t result_bit_index = state.GetBitIndex(result_index, bit_number);
-        state.SetBitExpression(result_bit_index, ~state.GetBitExpression(result_bit_index));
-    }
-    ++state.statement_index;
+    return MakeInstruction<W>(ProgramOpcode::InverseR, result_index);
 }
 
-std::string InverseR::Print(const FullState& info) const
+template<typename W>
+std::string BasicInverseR<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "Let " + info.GetVarName(result_index) + " = ~" + info.GetVarName(result_index);
+    return BasicStatement<W>::Print(info) + "Let " + info.GetVarName(result_index) + " = ~" + info.GetVarName(result_index);
 }
 
-InverseR::InverseR(const Program& program_, size_t line_number_, const std::string& label_, size_t result_index_)
-    : IStatement(program_, line_number_, label_), result_index(result_index_)
+template<typename W>
+BasicInverseR<W>::BasicInverseR(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, size_t result_index_)
+    : BasicStatement<W>(program_, line_number_, label_), result_index(result_index_)
 {
 }
 
-std::shared_ptr<AddRA> AddRA::Create(Program& program, size_t result_index, size_t argument_index, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicAddRA<W> > BasicAddRA<W>::Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<AddRA>(AddRA(program, line_number, label, result_index, argument_index));
+    auto new_statement = std::make_shared<BasicAddRA>(BasicAddRA(program, line_number, label, result_index, argument_index));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void AddRA::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicAddRA<W>::Lower() const
 {
-    auto c = const_bool(false);
-
-    for (size_t bit_number = 0; bit_number < BitExpressionStates::bit_count; ++bit_number)
-    {
-        const size_t result_bit_index = state.GetBitIndex(result_index, bit_number);
-        const size_t argument_bit_index = state.GetBitIndex(argument_index, bit_number);
-        auto a = state.GetBitExpression(result_bit_index);
-        auto b = state.GetBitExpression(argument_bit_index);
-        auto r = c & a & b | c & ~a & ~b | ~c & a & ~b | ~c & ~a & b;
-        c = c & a & b | c & a & ~b | c & ~a & b | ~c & a & b;
-        r->Optimize(r, state);
-        c->Optimize(c, state);
-        state.SetBitExpression(result_bit_index, r);
-    }
-    ++state.statement_index;
+    return MakeInstruction<W>(ProgramOpcode::AddRA, result_index, argument_index);
 }
 
-std::string AddRA::Print(const FullState& info) const
+template<typename W>
+std::string BasicAddRA<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(result_index) + " + " + info.GetVarName(argument_index);
+    return BasicStatement<W>::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(result_index) + " + " + info.GetVarName(argument_index);
 }
 
-AddRA::AddRA(const Program& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
-    : IStatement(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
+template<typename W>
+BasicAddRA<W>::BasicAddRA(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
+    : BasicStatement<W>(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
 {
 }
 
-std::shared_ptr<IncR> IncR::Create(Program& program, size_t result_index, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicIncR<W> > BasicIncR<W>::Create(BasicProgram<W>& program, size_t result_index, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<IncR>(IncR(program, line_number, label, result_index));
+    auto new_statement = std::make_shared<BasicIncR>(BasicIncR(program, line_number, label, result_index));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void IncR::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicIncR<W>::Lower() const
 {
-    auto c = const_bool(false);
-    auto one = const_bool(true);
-    auto zero = const_bool(false);
-
-    for (size_t bit_number = 0; bit_number < BitExpressionStates::bit_count; ++bit_number)
-    {
-        const size_t result_bit_index = state.GetBitIndex(result_index, bit_number);
-        auto a = state.GetBitExpression(result_bit_index);
-        auto b = (bit_number == 0) ? one : zero;
-        auto r = c & a & b | c & ~a & ~b | ~c & a & ~b | ~c & ~a & b;
-        c = c & a & b | c & a & ~b | c & ~a & b | ~c & a & b;
-        r->Optimize(r, state);
-        c->Optimize(c, state);
-        state.SetBitExpression(result_bit_index, r);
-    }
-    ++state.statement_index;
+    return MakeInstruction<W>(ProgramOpcode::IncR, result_index);
 }
 
-std::string IncR::Print(const FullState& info) const
+template<typename W>
+std::string BasicIncR<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "Inc " + info.GetVarName(result_index);
+    return BasicStatement<W>::Print(info) + "Inc " + info.GetVarName(result_index);
 }
 
-IncR::IncR(const Program& program_, size_t line_number_, const std::string& label_, size_t result_index_)
-    : IStatement(program_, line_number_, label_), result_index(result_index_)
+template<typename W>
+BasicIncR<W>::BasicIncR(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, size_t result_index_)
+    : BasicStatement<W>(program_, line_number_, label_), result_index(result_index_)
 {
 }
 
-std::shared_ptr<MulRA> MulRA::Create(Program& program, size_t result_index, size_t argument_index, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicMulRA<W> > BasicMulRA<W>::Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<MulRA>(MulRA(program, line_number, label, result_index, argument_index));
+    auto new_statement = std::make_shared<BasicMulRA>(BasicMulRA(program, line_number, label, result_index, argument_index));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void MulRA::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicMulRA<W>::Lower() const
 {
-    auto c = const_bool(false);
-
-    std::vector<std::shared_ptr<IBitExpression> > sub_sums;
-    sub_sums.reserve(BitExpressionStates::bit_count * BitExpressionStates::bit_count);
-    for (size_t i = 0; i < BitExpressionStates::bit_count * BitExpressionStates::bit_count; ++i)
-    {
-        sub_sums.push_back(const_bool(false));
-    }
-    for (size_t a_bit_number = 0; a_bit_number < BitExpressionStates::bit_count; ++a_bit_number)
-    {
-        const size_t a_bit_index = state.GetBitIndex(result_index, a_bit_number);
-        for (size_t b_bit_number = 0; b_bit_number < BitExpressionStates::bit_count; ++b_bit_number)
-        {
-            const size_t b_bit_index = state.GetBitIndex(argument_index, b_bit_number);
-            auto multiplication = state.GetBitExpression(a_bit_index) & state.GetBitExpression(b_bit_index);
-            if (a_bit_number + b_bit_number < BitExpressionStates::bit_count)
-            {
-                multiplication->Optimize(multiplication, state);
-                sub_sums[b_bit_number * BitExpressionStates::bit_count + a_bit_number + b_bit_number] = multiplication;
-            }
-        }
-    }
-    std::vector<std::shared_ptr<IBitExpression> > total_sum;
-    total_sum.reserve(BitExpressionStates::bit_count);
-    for (size_t i = 0; i < BitExpressionStates::bit_count; ++i)
-    {
-        total_sum.push_back(const_bool(false));
-    }
-    for (size_t i = 0; i < BitExpressionStates::bit_count; ++i)
-    {
-        auto c = const_bool(false);
-        for (size_t bit_number = 0; bit_number < BitExpressionStates::bit_count; ++bit_number)
-        {
-            auto a = total_sum[bit_number];
-            auto b = sub_sums[i * BitExpressionStates::bit_count + bit_number];
-            auto r = c & a & b | c & ~a & ~b | ~c & a & ~b | ~c & ~a & b;
-            c = c & a & b | c & a & ~b | c & ~a & b | ~c & a & b;
-            r->Optimize(r, state);
-            c->Optimize(c, state);
-            total_sum[bit_number] = r;
-        }
-    }
-    for (size_t bit_number = 0; bit_number < BitExpressionStates::bit_count; ++bit_number)
-    {
-        const size_t result_bit_index = state.GetBitIndex(result_index, bit_number);
-        state.SetBitExpression(result_bit_index, total_sum[bit_number]);
-    }
-
-    ++state.statement_index;
+    return MakeInstruction<W>(ProgramOpcode::MulRA, result_index, argument_index);
 }
 
-std::string MulRA::Print(const FullState& info) const
+template<typename W>
+std::string BasicMulRA<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(result_index) + " * " + info.GetVarName(argument_index);
+    return BasicStatement<W>::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(result_index) + " * " + info.GetVarName(argument_index);
 }
 
-MulRA::MulRA(const Program& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
-    : IStatement(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
+template<typename W>
+BasicMulRA<W>::BasicMulRA(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
+    : BasicStatement<W>(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
 {
 }
 
-std::shared_ptr<RestDivideRA> RestDivideRA::Create(Program& program, size_t result_index, size_t argument_index, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicRestDivideRA<W> > BasicRestDivideRA<W>::Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<RestDivideRA>(RestDivideRA(program, line_number, label, result_index, argument_index));
+    auto new_statement = std::make_shared<BasicRestDivideRA>(BasicRestDivideRA(program, line_number, label, result_index, argument_index));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void RestDivideRA::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicRestDivideRA<W>::Lower() const
 {
-    if (state.IsCurrentVarConstant(argument_index) && state.GetCurrentVarValue(argument_index) == 16)
-    {
-        for (size_t bit_number = 0; bit_number < BitExpressionStates::bit_count; ++bit_number)
-        {
-            if (bit_number >= 4)
-            {
-                const size_t result_bit_index = state.GetBitIndex(result_index, bit_number);
-                state.SetBitExpression(result_bit_index, const_bool(false));
-            }
-        }
-    }
-    else
-    {
-        throw std::runtime_error("not implemented");
-    }
-
-    ++state.statement_index;
+    return MakeInstruction<W>(ProgramOpcode::RestDivideRA, result_index, argument_index);
 }
 
-std::string RestDivideRA::Print(const FullState& info) const
+template<typename W>
+std::string BasicRestDivideRA<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(result_index) + " % " + info.GetVarName(argument_index);
+    return BasicStatement<W>::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(result_index) + " % " + info.GetVarName(argument_index);
 }
 
-RestDivideRA::RestDivideRA(const Program& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
-    : IStatement(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
+template<typename W>
+BasicRestDivideRA<W>::BasicRestDivideRA(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
+    : BasicStatement<W>(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
 {
 }
 
-std::shared_ptr<LcrRA> LcrRA::Create(Program& program, size_t result_index, size_t argument_index, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicLcrRA<W> > BasicLcrRA<W>::Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<LcrRA>(LcrRA(program, line_number, label, result_index, argument_index));
+    auto new_statement = std::make_shared<BasicLcrRA>(BasicLcrRA(program, line_number, label, result_index, argument_index));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void LcrRA::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicLcrRA<W>::Lower() const
 {
-    if (state.IsCurrentVarConstant(argument_index))
-    {
-        const BitExpressionStates::work_type shift = state.GetCurrentVarValue(argument_index);
-        std::vector<std::shared_ptr<IBitExpression> > saved_bit_expressions;
-        saved_bit_expressions.reserve(BitExpressionStates::bit_count);
-
-        for (size_t bit_number = 0; bit_number < BitExpressionStates::bit_count; ++bit_number)
-        {
-            const size_t bit_index = state.GetBitIndex(result_index, bit_number);
-            saved_bit_expressions.push_back(state.GetBitExpression(bit_index));
-        }
-
-        for (size_t bit_number = 0; bit_number < BitExpressionStates::bit_count; ++bit_number)
-        {
-            const size_t result_bit_number = (bit_number + shift) % BitExpressionStates::bit_count;
-            const size_t result_bit_index = state.GetBitIndex(result_index, result_bit_number);
-            state.SetBitExpression(result_bit_index, saved_bit_expressions[bit_number]);
-        }
-    }
-    else
-    {
-        //TODO:
-        throw std::runtime_error("not implemented");
-    }
-    ++state.statement_index;
+    return MakeInstruction<W>(ProgramOpcode::LcrRA, result_index, argument_index);
 }
 
-std::string LcrRA::Print(const FullState& info) const
+template<typename W>
+std::string BasicLcrRA<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(result_index) + " <<< " + info.GetVarName(argument_index);
+    return BasicStatement<W>::Print(info) + "Let " + info.GetVarName(result_index) + " = " + info.GetVarName(result_index) + " <<< " + info.GetVarName(argument_index);
 }
 
-LcrRA::LcrRA(const Program& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
-    : IStatement(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
+template<typename W>
+BasicLcrRA<W>::BasicLcrRA(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, size_t result_index_, size_t argument_index_)
+    : BasicStatement<W>(program_, line_number_, label_), result_index(result_index_), argument_index(argument_index_)
 {
 }
 
-std::shared_ptr<Goto> Goto::Create(Program& program, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicGoto<W> > BasicGoto<W>::Create(BasicProgram<W>& program, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<Goto>(Goto(program, line_number, label));
+    auto new_statement = std::make_shared<BasicGoto>(BasicGoto(program, line_number, label));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void Goto::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicGoto<W>::Lower() const
 {
-    state.statement_index = GetDestinationLine();
+    return MakeInstruction<W>(ProgramOpcode::Goto, 0, 0, 0, GetDestinationLine());
 }
 
-std::string Goto::Print(const FullState& info) const
+template<typename W>
+std::string BasicGoto<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "Goto " + GetDestinationLabel();
+    return BasicStatement<W>::Print(info) + "Goto " + GetDestinationLabel();
 }
 
-void Goto::SetDestinationLine(size_t destination_line_)
+template<typename W>
+void BasicGoto<W>::SetDestinationLine(size_t destination_line_)
 {
     destination_line = destination_line_;
 }
 
-size_t Goto::GetDestinationLine() const
+template<typename W>
+size_t BasicGoto<W>::GetDestinationLine() const
 {
     return destination_line;
 }
 
-std::string Goto::GetDestinationLabel() const
+template<typename W>
+std::string BasicGoto<W>::GetDestinationLabel() const
 {
-    const std::string label = program.statements.at(destination_line)->GetLabel();
+    const std::string label = this->program.statements.at(destination_line)->GetLabel();
     if (!label.empty())
     {
         return label;
@@ -578,118 +523,143 @@ std::string Goto::GetDestinationLabel() const
     }
 }
 
-Goto::Goto(const Program& program_, size_t line_number_, const std::string& label_) : IStatement(program_, line_number_, label_)
+template<typename W>
+BasicGoto<W>::BasicGoto(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_) : BasicStatement<W>(program_, line_number_, label_)
 {
 }
 
-std::shared_ptr<IfAMoreBGoto> IfAMoreBGoto::Create(Program& program, size_t a_index, size_t b_index, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicIfAMoreBGoto<W> > BasicIfAMoreBGoto<W>::Create(BasicProgram<W>& program, size_t a_index, size_t b_index, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<IfAMoreBGoto>(IfAMoreBGoto(program, line_number, label, a_index, b_index));
+    auto new_statement = std::make_shared<BasicIfAMoreBGoto>(BasicIfAMoreBGoto(program, line_number, label, a_index, b_index));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void IfAMoreBGoto::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicIfAMoreBGoto<W>::Lower() const
 {
-    if (state.IsCurrentVarConstant(a_index) && state.IsCurrentVarConstant(b_index))
-    {
-        if (state.GetCurrentVarValue(a_index) > state.GetCurrentVarValue(b_index))
-            state.statement_index = GetDestinationLine();
-        else
-            ++state.statement_index;
-    }
-    else
-    {
-        //TODO:
-        throw std::runtime_error("not implemented");
-    }
+    return MakeInstruction<W>(ProgramOpcode::IfAMoreBGoto, a_index, b_index, 0, this->GetDestinationLine());
 }
 
-std::string IfAMoreBGoto::Print(const FullState& info) const
+template<typename W>
+std::string BasicIfAMoreBGoto<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "If " + info.GetVarName(a_index) + " > " + info.GetVarName(b_index) + " Then Goto " + GetDestinationLabel();
+    return BasicStatement<W>::Print(info) + "If " + info.GetVarName(a_index) + " > " + info.GetVarName(b_index) + " Then Goto " + this->GetDestinationLabel();
 }
 
-IfAMoreBGoto::IfAMoreBGoto(const Program& program_, size_t line_number_, const std::string& label_, size_t a_index_, size_t b_index_)
-    : Goto(program_, line_number_, label_), a_index(a_index_), b_index(b_index_)
+template<typename W>
+BasicIfAMoreBGoto<W>::BasicIfAMoreBGoto(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, size_t a_index_, size_t b_index_)
+    : BasicGoto<W>(program_, line_number_, label_), a_index(a_index_), b_index(b_index_)
 {
 }
 
-std::shared_ptr<IfALessBGoto> IfALessBGoto::Create(Program& program, size_t a_index, size_t b_index, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicIfALessBGoto<W> > BasicIfALessBGoto<W>::Create(BasicProgram<W>& program, size_t a_index, size_t b_index, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<IfALessBGoto>(IfALessBGoto(program, line_number, label, a_index, b_index));
+    auto new_statement = std::make_shared<BasicIfALessBGoto>(BasicIfALessBGoto(program, line_number, label, a_index, b_index));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void IfALessBGoto::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicIfALessBGoto<W>::Lower() const
 {
-    if (state.IsCurrentVarConstant(a_index) && state.IsCurrentVarConstant(b_index))
-    {
-        if (state.GetCurrentVarValue(a_index) < state.GetCurrentVarValue(b_index))
-            state.statement_index = GetDestinationLine();
-        else
-            ++state.statement_index;
-    }
-    else
-    {
-        //TODO:
-        throw std::runtime_error("not implemented");
-    }
+    return MakeInstruction<W>(ProgramOpcode::IfALessBGoto, a_index, b_index, 0, this->GetDestinationLine());
 }
 
-std::string IfALessBGoto::Print(const FullState& info) const
+template<typename W>
+std::string BasicIfALessBGoto<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "If " + info.GetVarName(a_index) + " < " + info.GetVarName(b_index) + " Then Goto " + GetDestinationLabel();
+    return BasicStatement<W>::Print(info) + "If " + info.GetVarName(a_index) + " < " + info.GetVarName(b_index) + " Then Goto " + this->GetDestinationLabel();
 }
 
-IfALessBGoto::IfALessBGoto(const Program& program_, size_t line_number_, const std::string& label_, size_t a_index_, size_t b_index_)
-    : Goto(program_, line_number_, label_), a_index(a_index_), b_index(b_index_)
+template<typename W>
+BasicIfALessBGoto<W>::BasicIfALessBGoto(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, size_t a_index_, size_t b_index_)
+    : BasicGoto<W>(program_, line_number_, label_), a_index(a_index_), b_index(b_index_)
 {
 }
 
-std::shared_ptr<PrintVar> PrintVar::Create(Program& program, size_t argument_index, const std::string& text, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicPrintVar<W> > BasicPrintVar<W>::Create(BasicProgram<W>& program, size_t argument_index, const std::string& text, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<PrintVar>(PrintVar(program, line_number, label, argument_index, text));
+    auto new_statement = std::make_shared<BasicPrintVar>(BasicPrintVar(program, line_number, label, argument_index, text));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void PrintVar::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicPrintVar<W>::Lower() const
 {
+    return MakeInstruction<W>(ProgramOpcode::Nop);
 }
 
-std::string PrintVar::Print(const FullState& info) const
+template<typename W>
+std::string BasicPrintVar<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "Print 'Var " + info.GetVarName(argument_index) + ": ' + " + info.GetVarName(argument_index);
+    return BasicStatement<W>::Print(info) + "Print 'Var " + info.GetVarName(argument_index) + ": ' + " + info.GetVarName(argument_index);
 }
 
-PrintVar::PrintVar(const Program& program_, size_t line_number_, const std::string& label_, size_t argument_index_, const std::string& text_)
-    : IStatement(program_, line_number_, label_), argument_index(argument_index_), text(text_)
+template<typename W>
+BasicPrintVar<W>::BasicPrintVar(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, size_t argument_index_, const std::string& text_)
+    : BasicStatement<W>(program_, line_number_, label_), argument_index(argument_index_), text(text_)
 {
 }
 
-std::shared_ptr<PrintText> PrintText::Create(Program& program, const std::string& text, const std::string& label)
+template<typename W>
+std::shared_ptr<BasicPrintText<W> > BasicPrintText<W>::Create(BasicProgram<W>& program, const std::string& text, const std::string& label)
 {
     const size_t line_number = program.statements.size();
-    auto new_statement = std::make_shared<PrintText>(PrintText(program, line_number, label, text));
+    auto new_statement = std::make_shared<BasicPrintText>(BasicPrintText(program, line_number, label, text));
     program.statements.push_back(new_statement);
     return new_statement;
 }
 
-void PrintText::Execute(FullState& state) const
+template<typename W>
+BasicInstruction<W> BasicPrintText<W>::Lower() const
 {
+    return MakeInstruction<W>(ProgramOpcode::Nop);
 }
 
-std::string PrintText::Print(const FullState& info) const
+template<typename W>
+std::string BasicPrintText<W>::Print(const BasicFullState<W>& info) const
 {
-    return IStatement::Print(info) + "Print '" + text + "'";
+    return BasicStatement<W>::Print(info) + "Print '" + text + "'";
 }
 
-PrintText::PrintText(const Program& program_, size_t line_number_, const std::string& label_, const std::string& text_)
-    : IStatement(program_, line_number_, label_), text(text_)
+template<typename W>
+BasicPrintText<W>::BasicPrintText(const BasicProgram<W>& program_, size_t line_number_, const std::string& label_, const std::string& text_)
+    : BasicStatement<W>(program_, line_number_, label_), text(text_)
 {
 }
+
+#define INSTANTIATE_PROGRAM(W) \
+    template struct BasicFullState<W>; \
+    template struct BasicConcreteState<W>; \
+    template struct BasicStatement<W>; \
+    template struct BasicNop<W>; \
+    template struct BasicSetConstant<W>; \
+    template struct BasicLetRA<W>; \
+    template struct BasicLetRAI<W>; \
+    template struct BasicAndRA<W>; \
+    template struct BasicOrRA<W>; \
+    template struct BasicXorRA<W>; \
+    template struct BasicInverseR<W>; \
+    template struct BasicAddRA<W>; \
+    template struct BasicIncR<W>; \
+    template struct BasicMulRA<W>; \
+    template struct BasicRestDivideRA<W>; \
+    template struct BasicLcrRA<W>; \
+    template struct BasicGoto<W>; \
+    template struct BasicIfAMoreBGoto<W>; \
+    template struct BasicIfALessBGoto<W>; \
+    template struct BasicPrintVar<W>; \
+    template struct BasicPrintText<W>;
+
+INSTANTIATE_PROGRAM(uint8_t)
+INSTANTIATE_PROGRAM(uint16_t)
+INSTANTIATE_PROGRAM(uint32_t)
+INSTANTIATE_PROGRAM(uint64_t)
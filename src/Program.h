@@ -30,230 +30,325 @@
 
 #include "BitExpressions.h"
 
-struct FullState : public BitExpressionStates
+// Programs are templated on the word type; Program.cpp instantiates them for 8, 16, 32 and 64 bits
+template<typename W>
+struct BasicFullState : public BasicBitExpressionStates<W>
 {
     size_t statement_index;
+    // Inputs for which execution takes this path; stays true unless branches on free inputs fork it
+    std::shared_ptr<IBitExpression> path_condition;
 
-    FullState();
+    BasicFullState();
 };
 
-struct IStatement;
+// Plain register file for running a program on concrete words without building expressions
+template<typename W>
+struct BasicConcreteState
+{
+    std::vector<W> values;
+    size_t statement_index;
+
+    BasicConcreteState();
+    explicit BasicConcreteState(size_t variable_count);
+    // Takes the input value of every variable, free bits included
+    explicit BasicConcreteState(const BitExpressionStates& input);
+};
+
+enum class ProgramOpcode : uint32_t
+{
+    Nop,
+    SetConstant,
+    LetRA,
+    LetRAI,
+    AndRA,
+    OrRA,
+    XorRA,
+    InverseR,
+    AddRA,
+    IncR,
+    MulRA,
+    RestDivideRA,
+    LcrRA,
+    Goto,
+    IfAMoreBGoto,
+    IfALessBGoto
+};
+
+// Statement lowered to plain operands; comparisons keep their operands in result and argument
+template<typename W>
+struct BasicInstruction
+{
+    ProgramOpcode opcode;
+    uint32_t result;
+    uint32_t argument;
+    uint32_t index;
+    uint32_t target;
+    W value;
+};
+
+template<typename W>
+struct BasicStatement;
 
-struct Program
+template<typename W>
+struct BasicProgram
 {
-    std::vector<std::shared_ptr<IStatement> > statements;
+    std::vector<std::shared_ptr<BasicStatement<W> > > statements;
 };
 
-struct IStatement
+template<typename W>
+struct BasicStatement
 {
     size_t GetLineNumber() const;
-    virtual ~IStatement();
-    virtual void Execute(FullState& state) const = 0;
-    virtual std::string Print(const FullState& info) const;
+    virtual ~BasicStatement();
+    void Execute(BasicFullState<W>& state) const;
+    void ExecuteConcrete(BasicConcreteState<W>& state) const;
+    virtual BasicInstruction<W> Lower() const = 0;
+    virtual std::string Print(const BasicFullState<W>& info) const;
     std::string GetLabel() const;
 
 protected:
-    IStatement(const Program& program, size_t line_number, const std::string& label);
-    const Program& program;
+    BasicStatement(const BasicProgram<W>& program, size_t line_number, const std::string& label);
+    const BasicProgram<W>& program;
 private:
     size_t line_number;
     std::string label;
 };
 
-struct Nop : public IStatement
+template<typename W>
+struct BasicNop : public BasicStatement<W>
 {
-    static std::shared_ptr<Nop> Create(Program& program, const std::string& label="");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicNop> Create(BasicProgram<W>& program, const std::string& label="");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    Nop(const Program& program, size_t line_number, const std::string& label);
+    BasicNop(const BasicProgram<W>& program, size_t line_number, const std::string& label);
 };
 
-struct SetConstant : public IStatement
+template<typename W>
+struct BasicSetConstant : public BasicStatement<W>
 {
-    static std::shared_ptr<SetConstant> Create(Program& program, size_t result_index, BitExpressionStates::work_type value, bool hex = true, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicSetConstant> Create(BasicProgram<W>& program, size_t result_index, W value, bool hex = true, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    SetConstant(const Program& program, size_t line_number, const std::string& label, size_t result_index, BitExpressionStates::work_type value, bool hex);
+    BasicSetConstant(const BasicProgram<W>& program, size_t line_number, const std::string& label, size_t result_index, W value, bool hex);
     size_t result_index;
-    BitExpressionStates::work_type value;
+    W value;
     bool hex;
 };
 
-struct LetRA : public IStatement
+template<typename W>
+struct BasicLetRA : public BasicStatement<W>
 {
-    static std::shared_ptr<LetRA> Create(Program& program, size_t result_index, size_t argument_index, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicLetRA> Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    LetRA(const Program& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
+    BasicLetRA(const BasicProgram<W>& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
     size_t result_index;
     size_t argument_index;
 };
 
-struct LetRAI : public IStatement
+template<typename W>
+struct BasicLetRAI : public BasicStatement<W>
 {
-    static std::shared_ptr<LetRAI> Create(Program& program, size_t result_index, size_t argument_index, size_t index_index, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicLetRAI> Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, size_t index_index, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    LetRAI(const Program& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index, size_t index_index);
+    BasicLetRAI(const BasicProgram<W>& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index, size_t index_index);
     size_t result_index;
     size_t argument_index;
     size_t index_index;
 };
 
-struct AndRA : public IStatement
+template<typename W>
+struct BasicAndRA : public BasicStatement<W>
 {
-    static std::shared_ptr<AndRA> Create(Program& program, size_t result_index, size_t argument_index, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicAndRA> Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    AndRA(const Program& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
+    BasicAndRA(const BasicProgram<W>& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
     size_t result_index;
     size_t argument_index;
 };
 
-struct OrRA : public IStatement
+template<typename W>
+struct BasicOrRA : public BasicStatement<W>
 {
-    static std::shared_ptr<OrRA> Create(Program& program, size_t result_index, size_t argument_index, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicOrRA> Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    OrRA(const Program& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
+    BasicOrRA(const BasicProgram<W>& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
     size_t result_index;
     size_t argument_index;
 };
 
-struct XorRA : public IStatement
+template<typename W>
+struct BasicXorRA : public BasicStatement<W>
 {
-    static std::shared_ptr<XorRA> Create(Program& program, size_t result_index, size_t argument_index, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicXorRA> Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    XorRA(const Program& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
+    BasicXorRA(const BasicProgram<W>& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
     size_t result_index;
     size_t argument_index;
 };
 
-struct InverseR : public IStatement
+template<typename W>
+struct BasicInverseR : public BasicStatement<W>
 {
-    static std::shared_ptr<InverseR> Create(Program& program, size_t result_index, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicInverseR> Create(BasicProgram<W>& program, size_t result_index, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    InverseR(const Program& program, size_t line_number, const std::string& label, size_t result_index);
+    BasicInverseR(const BasicProgram<W>& program, size_t line_number, const std::string& label, size_t result_index);
     size_t result_index;
 };
 
-struct AddRA : public IStatement
+template<typename W>
+struct BasicAddRA : public BasicStatement<W>
 {
-    static std::shared_ptr<AddRA> Create(Program& program, size_t result_index, size_t argument_index, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicAddRA> Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    AddRA(const Program& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
+    BasicAddRA(const BasicProgram<W>& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
     size_t result_index;
     size_t argument_index;
 };
 
-struct IncR : public IStatement
+template<typename W>
+struct BasicIncR : public BasicStatement<W>
 {
-    static std::shared_ptr<IncR> Create(Program& program, size_t result_index, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicIncR> Create(BasicProgram<W>& program, size_t result_index, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    IncR(const Program& program, size_t line_number, const std::string& label, size_t result_index);
+    BasicIncR(const BasicProgram<W>& program, size_t line_number, const std::string& label, size_t result_index);
     size_t result_index;
 };
 
-struct MulRA : public IStatement
+template<typename W>
+struct BasicMulRA : public BasicStatement<W>
 {
-    static std::shared_ptr<MulRA> Create(Program& program, size_t result_index, size_t argument_index, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicMulRA> Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    MulRA(const Program& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
+    BasicMulRA(const BasicProgram<W>& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
     size_t result_index;
     size_t argument_index;
 };
 
-struct RestDivideRA : public IStatement
+template<typename W>
+struct BasicRestDivideRA : public BasicStatement<W>
 {
-    static std::shared_ptr<RestDivideRA> Create(Program& program, size_t result_index, size_t argument_index, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicRestDivideRA> Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    RestDivideRA(const Program& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
+    BasicRestDivideRA(const BasicProgram<W>& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
     size_t result_index;
     size_t argument_index;
 };
 
-struct LcrRA : public IStatement
+template<typename W>
+struct BasicLcrRA : public BasicStatement<W>
 {
-    static std::shared_ptr<LcrRA> Create(Program& program, size_t result_index, size_t argument_index, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicLcrRA> Create(BasicProgram<W>& program, size_t result_index, size_t argument_index, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    LcrRA(const Program& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
+    BasicLcrRA(const BasicProgram<W>& program, size_t line_number, const std::string& label, size_t result_index, size_t argument_index);
     size_t result_index;
     size_t argument_index;
 };
 
-struct Goto : public IStatement
+template<typename W>
+struct BasicGoto : public BasicStatement<W>
 {
-    static std::shared_ptr<Goto> Create(Program& program, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicGoto> Create(BasicProgram<W>& program, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
     void SetDestinationLine(size_t destination_line);
     size_t GetDestinationLine() const;
     std::string GetDestinationLabel() const;
 protected:
-    Goto(const Program& program, size_t line_number, const std::string& label);
+    BasicGoto(const BasicProgram<W>& program, size_t line_number, const std::string& label);
 private:
     size_t destination_line;
 };
 
-struct IfAMoreBGoto : public Goto
+template<typename W>
+struct BasicIfAMoreBGoto : public BasicGoto<W>
 {
-    static std::shared_ptr<IfAMoreBGoto> Create(Program& program, size_t a_index, size_t b_index, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicIfAMoreBGoto> Create(BasicProgram<W>& program, size_t a_index, size_t b_index, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    IfAMoreBGoto(const Program& program, size_t line_number, const std::string& label, size_t a_index, size_t b_index);
+    BasicIfAMoreBGoto(const BasicProgram<W>& program, size_t line_number, const std::string& label, size_t a_index, size_t b_index);
     size_t a_index;
     size_t b_index;
 };
 
-struct IfALessBGoto : public Goto
+template<typename W>
+struct BasicIfALessBGoto : public BasicGoto<W>
 {
-    static std::shared_ptr<IfALessBGoto> Create(Program& program, size_t a_index, size_t b_index, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicIfALessBGoto> Create(BasicProgram<W>& program, size_t a_index, size_t b_index, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    IfALessBGoto(const Program& program, size_t line_number, const std::string& label, size_t a_index, size_t b_index);
+    BasicIfALessBGoto(const BasicProgram<W>& program, size_t line_number, const std::string& label, size_t a_index, size_t b_index);
     size_t a_index;
     size_t b_index;
 };
 
-struct PrintVar : public IStatement
+template<typename W>
+struct BasicPrintVar : public BasicStatement<W>
 {
-    static std::shared_ptr<PrintVar> Create(Program& program, size_t argument_index, const std::string& text, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicPrintVar> Create(BasicProgram<W>& program, size_t argument_index, const std::string& text, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    PrintVar(const Program& program, size_t line_number, const std::string& label, size_t argument_index, const std::string& text);
+    BasicPrintVar(const BasicProgram<W>& program, size_t line_number, const std::string& label, size_t argument_index, const std::string& text);
     size_t argument_index;
     std::string text;
 };
 
-struct PrintText : public IStatement
+template<typename W>
+struct BasicPrintText : public BasicStatement<W>
 {
-    static std::shared_ptr<PrintText> Create(Program& program, const std::string& text, const std::string& label = "");
-    void Execute(FullState& state) const;
-    std::string Print(const FullState& info) const;
+    static std::shared_ptr<BasicPrintText> Create(BasicProgram<W>& program, const std::string& text, const std::string& label = "");
+    BasicInstruction<W> Lower() const;
+    std::string Print(const BasicFullState<W>& info) const;
 private:
-    PrintText(const Program& program, size_t line_number, const std::string& label, const std::string& text);
+    BasicPrintText(const BasicProgram<W>& program, size_t line_number, const std::string& label, const std::string& text);
     std::string text;
 };
+
+typedef BasicFullState<uint32_t> FullState;
+typedef BasicConcreteState<uint32_t> ConcreteState;
+typedef BasicProgram<uint32_t> Program;
+typedef BasicStatement<uint32_t> IStatement;
+typedef BasicNop<uint32_t> Nop;
+typedef BasicSetConstant<uint32_t> SetConstant;
+typedef BasicLetRA<uint32_t> LetRA;
+typedef BasicLetRAI<uint32_t> LetRAI;
+typedef BasicAndRA<uint32_t> AndRA;
+typedef BasicOrRA<uint32_t> OrRA;
+typedef BasicXorRA<uint32_t> XorRA;
+typedef BasicInverseR<uint32_t> InverseR;
+typedef BasicAddRA<uint32_t> AddRA;
+typedef BasicIncR<uint32_t> IncR;
+typedef BasicMulRA<uint32_t> MulRA;
+typedef BasicRestDivideRA<uint32_t> RestDivideRA;
+typedef BasicLcrRA<uint32_t> LcrRA;
+typedef BasicGoto<uint32_t> Goto;
+typedef BasicIfAMoreBGoto<uint32_t> IfAMoreBGoto;
+typedef BasicIfALessBGoto<uint32_t> IfALessBGoto;
+typedef BasicPrintVar<uint32_t> PrintVar;
+typedef BasicPrintText<uint32_t> PrintText;
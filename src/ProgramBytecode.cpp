@@ -0,0 +1,282 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "ProgramBytecode.h"
+#include "WordExpressions.h"
+
+namespace
+{
+    template<typename W>
+    W RotateLeft(W value, W amount)
+    {
+        const size_t bit_count = sizeof(W) * 8;
+        const size_t shift = amount % bit_count;
+        if (!shift)
+        {
+            return value;
+        }
+        return static_cast<W>((value << shift) | (value >> (bit_count - shift)));
+    }
+
+    // Returns the index of the next statement
+    template<typename W>
+    inline size_t RunInstruction(const BasicInstruction<W>& instruction, W* const values, size_t value_count, size_t statement_index)
+    {
+        W* const result = values + instruction.result;
+        switch (instruction.opcode)
+        {
+        case ProgramOpcode::Nop:
+            break;
+        case ProgramOpcode::SetConstant:
+            *result = instruction.value;
+            break;
+        case ProgramOpcode::LetRA:
+            *result = values[instruction.argument];
+            break;
+        case ProgramOpcode::LetRAI:
+        {
+            const size_t source_index = instruction.argument + static_cast<size_t>(values[instruction.index]);
+            if (source_index >= value_count)
+            {
+                throw std::runtime_error("ExecuteInstruction(): array index out of range");
+            }
+            *result = values[source_index];
+            break;
+        }
+        case ProgramOpcode::AndRA:
+            *result &= values[instruction.argument];
+            break;
+        case ProgramOpcode::OrRA:
+            *result |= values[instruction.argument];
+            break;
+        case ProgramOpcode::XorRA:
+            *result ^= values[instruction.argument];
+            break;
+        case ProgramOpcode::InverseR:
+            *result = static_cast<W>(~*result);
+            break;
+        case ProgramOpcode::AddRA:
+            *result = static_cast<W>(*result + values[instruction.argument]);
+            break;
+        case ProgramOpcode::IncR:
+            *result = static_cast<W>(*result + 1);
+            break;
+        case ProgramOpcode::MulRA:
+            *result = static_cast<W>(static_cast<uint64_t>(*result) * values[instruction.argument]);
+            break;
+        case ProgramOpcode::RestDivideRA:
+            if (!values[instruction.argument])
+            {
+                throw std::runtime_error("ExecuteInstruction(): division by zero");
+            }
+            *result %= values[instruction.argument];
+            break;
+        case ProgramOpcode::LcrRA:
+            *result = RotateLeft(*result, values[instruction.argument]);
+            break;
+        case ProgramOpcode::Goto:
+            return instruction.target;
+        case ProgramOpcode::IfAMoreBGoto:
+            if (*result > values[instruction.argument])
+            {
+                return instruction.target;
+            }
+            break;
+        case ProgramOpcode::IfALessBGoto:
+            if (*result < values[instruction.argument])
+            {
+                return instruction.target;
+            }
+            break;
+        }
+        return statement_index + 1;
+    }
+
+    size_t GetOperandCount(ProgramOpcode opcode)
+    {
+        switch (opcode)
+        {
+        case ProgramOpcode::Nop:
+        case ProgramOpcode::Goto:
+            return 0;
+        case ProgramOpcode::SetConstant:
+        case ProgramOpcode::InverseR:
+        case ProgramOpcode::IncR:
+            return 1;
+        case ProgramOpcode::LetRAI:
+            return 3;
+        default:
+            return 2;
+        }
+    }
+
+    bool IsJump(ProgramOpcode opcode)
+    {
+        return opcode == ProgramOpcode::Goto || opcode == ProgramOpcode::IfAMoreBGoto || opcode == ProgramOpcode::IfALessBGoto;
+    }
+}
+
+template<typename W>
+void ExecuteInstruction(const BasicInstruction<W>& instruction, BasicFullState<W>& state)
+{
+    const size_t bit_count = BasicFullState<W>::bit_count;
+    const size_t result = instruction.result;
+    const size_t argument = instruction.argument;
+    switch (instruction.opcode)
+    {
+    case ProgramOpcode::Nop:
+        break;
+    case ProgramOpcode::SetConstant:
+        state.SetWordExpression(result, word_const(instruction.value, bit_count));
+        break;
+    case ProgramOpcode::LetRA:
+        state.SetWordExpression(result, state.GetWordExpression(argument));
+        break;
+    case ProgramOpcode::LetRAI:
+        if (!state.IsCurrentVarConstant(instruction.index))
+        {
+            throw std::runtime_error("ExecuteInstruction(): array index is not constant");
+        }
+        state.SetWordExpression(result, state.GetWordExpression(argument + state.GetCurrentVarValue(instruction.index)));
+        break;
+    case ProgramOpcode::AndRA:
+        state.SetWordExpression(result, state.GetWordExpression(result) & state.GetWordExpression(argument));
+        break;
+    case ProgramOpcode::OrRA:
+        state.SetWordExpression(result, state.GetWordExpression(result) | state.GetWordExpression(argument));
+        break;
+    case ProgramOpcode::XorRA:
+        state.SetWordExpression(result, state.GetWordExpression(result) ^ state.GetWordExpression(argument));
+        break;
+    case ProgramOpcode::InverseR:
+        state.SetWordExpression(result, ~state.GetWordExpression(result));
+        break;
+    case ProgramOpcode::AddRA:
+        state.SetWordExpression(result, state.GetWordExpression(result) + state.GetWordExpression(argument));
+        break;
+    case ProgramOpcode::IncR:
+        state.SetWordExpression(result, state.GetWordExpression(result) + word_const(1, bit_count));
+        break;
+    case ProgramOpcode::MulRA:
+        state.SetWordExpression(result, state.GetWordExpression(result) * state.GetWordExpression(argument));
+        break;
+    case ProgramOpcode::RestDivideRA:
+    {
+        const W divisor = state.IsCurrentVarConstant(argument) ? state.GetCurrentVarValue(argument) : 0;
+        if (!divisor || (divisor & (divisor - 1)))
+        {
+            throw std::runtime_error("ExecuteInstruction(): divisor is not a constant power of two");
+        }
+        state.SetWordExpression(result, state.GetWordExpression(result) & word_const(divisor - 1, bit_count));
+        break;
+    }
+    case ProgramOpcode::LcrRA:
+        if (!state.IsCurrentVarConstant(argument))
+        {
+            throw std::runtime_error("ExecuteInstruction(): shift is not constant");
+        }
+        state.SetWordExpression(result, rotl(state.GetWordExpression(result), state.GetCurrentVarValue(argument)));
+        break;
+    case ProgramOpcode::Goto:
+        state.statement_index = instruction.target;
+        return;
+    case ProgramOpcode::IfAMoreBGoto:
+    case ProgramOpcode::IfALessBGoto:
+        if (!state.IsCurrentVarConstant(result) || !state.IsCurrentVarConstant(argument))
+        {
+            throw std::runtime_error("ExecuteInstruction(): condition is not constant");
+        }
+        if (instruction.opcode == ProgramOpcode::IfAMoreBGoto ? state.GetCurrentVarValue(result) > state.GetCurrentVarValue(argument) : state.GetCurrentVarValue(result) < state.GetCurrentVarValue(argument))
+        {
+            state.statement_index = instruction.target;
+            return;
+        }
+        break;
+    }
+    ++state.statement_index;
+}
+
+template<typename W>
+void ExecuteInstruction(const BasicInstruction<W>& instruction, BasicConcreteState<W>& state)
+{
+    state.statement_index = RunInstruction(instruction, state.values.data(), state.values.size(), state.statement_index);
+}
+
+template<typename W>
+std::shared_ptr<BasicProgramBytecode<W> > BasicProgramBytecode<W>::Compile(const BasicProgram<W>& program)
+{
+    auto code = std::make_shared<BasicProgramBytecode>();
+    code->instructions.reserve(program.statements.size());
+    code->variable_count = 0;
+    for (const auto& statement : program.statements)
+    {
+        const BasicInstruction<W> instruction = statement->Lower();
+        if (IsJump(instruction.opcode) && instruction.target > program.statements.size())
+        {
+            throw std::runtime_error("BasicProgramBytecode::Compile(): jump target out of range");
+        }
+        const uint32_t operands[] = { instruction.result, instruction.argument, instruction.index };
+        for (size_t operand = 0; operand < GetOperandCount(instruction.opcode); ++operand)
+        {
+            code->variable_count = std::max<size_t>(code->variable_count, operands[operand] + 1);
+        }
+        code->instructions.push_back(instruction);
+    }
+    return code;
+}
+
+template<typename W>
+void BasicProgramBytecode<W>::Step(BasicFullState<W>& state) const
+{
+    ExecuteInstruction(instructions[state.statement_index], state);
+}
+
+template<typename W>
+void BasicProgramBytecode<W>::Run(BasicConcreteState<W>& state) const
+{
+    if (state.values.size() < variable_count)
+    {
+        throw std::runtime_error("BasicProgramBytecode::Run(): state has too few variables");
+    }
+    const BasicInstruction<W>* const code = instructions.data();
+    const size_t instruction_count = instructions.size();
+    W* const values = state.values.data();
+    const size_t value_count = state.values.size();
+    size_t statement_index = state.statement_index;
+    while (statement_index < instruction_count)
+    {
+        statement_index = RunInstruction(code[statement_index], values, value_count, statement_index);
+    }
+    state.statement_index = statement_index;
+}
+
+#define INSTANTIATE_PROGRAM_BYTECODE(W) \
+    template void ExecuteInstruction<W>(const BasicInstruction<W>& instruction, BasicFullState<W>& state); \
+    template void ExecuteInstruction<W>(const BasicInstruction<W>& instruction, BasicConcreteState<W>& state); \
+    template struct BasicProgramBytecode<W>;
+
+INSTANTIATE_PROGRAM_BYTECODE(uint8_t)
+INSTANTIATE_PROGRAM_BYTECODE(uint16_t)
+INSTANTIATE_PROGRAM_BYTECODE(uint32_t)
+INSTANTIATE_PROGRAM_BYTECODE(uint64_t)
@@ -0,0 +1,51 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "Program.h"
+
+// Execute one lowered statement; jumps set the statement index to their target
+template<typename W>
+void ExecuteInstruction(const BasicInstruction<W>& instruction, BasicFullState<W>& state);
+template<typename W>
+void ExecuteInstruction(const BasicInstruction<W>& instruction, BasicConcreteState<W>& state);
+
+// Statements of a program lowered once, with jump targets checked and the variables they address
+// counted, so running it needs neither virtual calls nor statement lookups
+template<typename W>
+struct BasicProgramBytecode
+{
+    static std::shared_ptr<BasicProgramBytecode> Compile(const BasicProgram<W>& program);
+
+    void Step(BasicFullState<W>& state) const;
+    void Run(BasicConcreteState<W>& state) const;
+
+    std::vector<BasicInstruction<W> > instructions;
+    size_t variable_count;
+};
+
+typedef BasicProgramBytecode<uint32_t> ProgramBytecode;
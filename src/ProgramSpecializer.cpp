@@ -0,0 +1,327 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdexcept>
+
+#include "ProgramSpecializer.h"
+
+namespace
+{
+    // Tracks what is known about every variable while the residual program is being emitted
+    template<typename W>
+    struct ResidualBuilder
+    {
+        struct Variable
+        {
+            bool known;
+            bool stored;
+            W value;
+        };
+
+        ResidualBuilder(const BitExpressionStates& input, BasicProgram<W>& residual_)
+            : residual(residual_), variables(input.GetVariableCount())
+        {
+            for (size_t var_index = 0; var_index < variables.size(); ++var_index)
+            {
+                Variable& variable = variables[var_index];
+                variable.known = input.IsInputVarConstant(var_index);
+                variable.stored = true;
+                variable.value = variable.known ? static_cast<W>(input.GetInputVarValue(var_index)) : 0;
+            }
+        }
+
+        bool IsKnown(size_t var_index) const
+        {
+            return variables.at(var_index).known;
+        }
+
+        W GetValue(size_t var_index) const
+        {
+            return variables[var_index].value;
+        }
+
+        void SetKnown(size_t var_index, W value)
+        {
+            Variable& variable = variables.at(var_index);
+            variable.stored = variable.stored && variable.known && variable.value == value;
+            variable.known = true;
+            variable.value = value;
+        }
+
+        void SetFree(size_t var_index)
+        {
+            Variable& variable = variables.at(var_index);
+            variable.known = false;
+            variable.stored = true;
+        }
+
+        // Makes the residual state hold the known value before a statement reads it
+        void Store(size_t var_index, const std::string& label)
+        {
+            Variable& variable = variables.at(var_index);
+            if (variable.known && !variable.stored)
+            {
+                BasicSetConstant<W>::Create(residual, var_index, variable.value, true, label);
+                variable.stored = true;
+            }
+        }
+
+        void StoreAll(const std::string& label)
+        {
+            for (size_t var_index = 0; var_index < variables.size(); ++var_index)
+            {
+                Store(var_index, label);
+            }
+        }
+
+        BasicProgram<W>& residual;
+        std::vector<Variable> variables;
+    };
+
+    template<typename W>
+    W RotateLeft(W value, W amount)
+    {
+        const size_t bit_count = sizeof(W) * 8;
+        const size_t shift = amount % bit_count;
+        if (!shift)
+        {
+            return value;
+        }
+        return static_cast<W>((value << shift) | (value >> (bit_count - shift)));
+    }
+
+    template<typename W>
+    W Fold(ProgramOpcode opcode, W result, W argument)
+    {
+        switch (opcode)
+        {
+        case ProgramOpcode::AndRA:
+            return result & argument;
+        case ProgramOpcode::OrRA:
+            return result | argument;
+        case ProgramOpcode::XorRA:
+            return result ^ argument;
+        case ProgramOpcode::InverseR:
+            return static_cast<W>(~result);
+        case ProgramOpcode::AddRA:
+            return static_cast<W>(result + argument);
+        case ProgramOpcode::IncR:
+            return static_cast<W>(result + 1);
+        case ProgramOpcode::MulRA:
+            return static_cast<W>(static_cast<uint64_t>(result) * argument);
+        case ProgramOpcode::RestDivideRA:
+            if (!argument)
+            {
+                throw std::runtime_error("BasicProgramSpecializer::Build(): division by zero");
+            }
+            return result % argument;
+        case ProgramOpcode::LcrRA:
+            return RotateLeft(result, argument);
+        default:
+            throw std::runtime_error("BasicProgramSpecializer::Build(): unexpected opcode");
+        }
+    }
+
+    template<typename W>
+    void Emit(BasicProgram<W>& residual, ProgramOpcode opcode, size_t result_index, size_t argument_index, const std::string& label)
+    {
+        switch (opcode)
+        {
+        case ProgramOpcode::LetRA:
+            BasicLetRA<W>::Create(residual, result_index, argument_index, label);
+            break;
+        case ProgramOpcode::AndRA:
+            BasicAndRA<W>::Create(residual, result_index, argument_index, label);
+            break;
+        case ProgramOpcode::OrRA:
+            BasicOrRA<W>::Create(residual, result_index, argument_index, label);
+            break;
+        case ProgramOpcode::XorRA:
+            BasicXorRA<W>::Create(residual, result_index, argument_index, label);
+            break;
+        case ProgramOpcode::InverseR:
+            BasicInverseR<W>::Create(residual, result_index, label);
+            break;
+        case ProgramOpcode::AddRA:
+            BasicAddRA<W>::Create(residual, result_index, argument_index, label);
+            break;
+        case ProgramOpcode::IncR:
+            BasicIncR<W>::Create(residual, result_index, label);
+            break;
+        case ProgramOpcode::MulRA:
+            BasicMulRA<W>::Create(residual, result_index, argument_index, label);
+            break;
+        case ProgramOpcode::RestDivideRA:
+            BasicRestDivideRA<W>::Create(residual, result_index, argument_index, label);
+            break;
+        case ProgramOpcode::LcrRA:
+            BasicLcrRA<W>::Create(residual, result_index, argument_index, label);
+            break;
+        default:
+            throw std::runtime_error("BasicProgramSpecializer::Build(): unexpected opcode");
+        }
+    }
+}
+
+template<typename W>
+BasicProgramSpecializer<W>::BasicProgramSpecializer(const BasicProgram<W>& program_, size_t max_step_count_)
+    : program(program_), code(BasicProgramBytecode<W>::Compile(program_)), max_step_count(max_step_count_)
+{
+}
+
+template<typename W>
+std::shared_ptr<const BasicProgram<W> > BasicProgramSpecializer<W>::Specialize(const BitExpressionStates& input)
+{
+    key_type key;
+    key.reserve(input.GetVariableCount() * 2);
+    for (size_t var_index = 0; var_index < input.GetVariableCount(); ++var_index)
+    {
+        const bool constant = input.IsInputVarConstant(var_index);
+        key.push_back(constant);
+        key.push_back(constant ? input.GetInputVarValue(var_index) : 0);
+    }
+    auto found = cache.find(key);
+    if (found != cache.end())
+    {
+        return found->second;
+    }
+    const std::shared_ptr<const BasicProgram<W> > residual = Build(input);
+    cache.insert(std::make_pair(key, residual));
+    return residual;
+}
+
+template<typename W>
+size_t BasicProgramSpecializer<W>::GetCacheSize() const
+{
+    return cache.size();
+}
+
+template<typename W>
+void BasicProgramSpecializer<W>::ClearCache()
+{
+    cache.clear();
+}
+
+template<typename W>
+std::shared_ptr<const BasicProgram<W> > BasicProgramSpecializer<W>::Build(const BitExpressionStates& input) const
+{
+    if (input.GetBitCount() != sizeof(W) * 8)
+        throw std::runtime_error("BasicProgramSpecializer::Build(): word widths differ");
+    if (input.GetVariableCount() < code->variable_count)
+        throw std::runtime_error("BasicProgramSpecializer::Build(): input has too few variables");
+
+    // Statements keep a reference to their program, so the residual program must not move
+    auto residual = std::make_shared<BasicProgram<W> >();
+    ResidualBuilder<W> builder(input, *residual);
+    const std::vector<BasicInstruction<W> >& instructions = code->instructions;
+    size_t statement_index = 0;
+    for (size_t step = 0; statement_index < instructions.size(); ++step)
+    {
+        if (step == max_step_count)
+            throw std::runtime_error("BasicProgramSpecializer::Build(): step limit exceeded");
+
+        const BasicInstruction<W>& instruction = instructions[statement_index];
+        const std::string& label = program.statements[statement_index]->GetLabel();
+        const size_t result = instruction.result;
+        size_t argument = instruction.argument;
+        size_t next_index = statement_index + 1;
+        switch (instruction.opcode)
+        {
+        case ProgramOpcode::Nop:
+            break;
+        case ProgramOpcode::SetConstant:
+            builder.SetKnown(result, instruction.value);
+            break;
+        case ProgramOpcode::LetRAI:
+            if (!builder.IsKnown(instruction.index))
+                throw std::runtime_error("BasicProgramSpecializer::Build(): array index is not constant");
+            argument += builder.GetValue(instruction.index);
+            if (argument >= builder.variables.size())
+                throw std::runtime_error("BasicProgramSpecializer::Build(): array index out of range");
+            // fall through
+        case ProgramOpcode::LetRA:
+            if (builder.IsKnown(argument))
+            {
+                builder.SetKnown(result, builder.GetValue(argument));
+            }
+            else if (result != argument)
+            {
+                Emit(*residual, ProgramOpcode::LetRA, result, argument, label);
+                builder.SetFree(result);
+            }
+            break;
+        case ProgramOpcode::InverseR:
+        case ProgramOpcode::IncR:
+            if (builder.IsKnown(result))
+            {
+                builder.SetKnown(result, Fold<W>(instruction.opcode, builder.GetValue(result), 0));
+            }
+            else
+            {
+                Emit(*residual, instruction.opcode, result, 0, label);
+            }
+            break;
+        case ProgramOpcode::AndRA:
+        case ProgramOpcode::OrRA:
+        case ProgramOpcode::XorRA:
+        case ProgramOpcode::AddRA:
+        case ProgramOpcode::MulRA:
+        case ProgramOpcode::RestDivideRA:
+        case ProgramOpcode::LcrRA:
+            if (builder.IsKnown(result) && builder.IsKnown(argument))
+            {
+                builder.SetKnown(result, Fold(instruction.opcode, builder.GetValue(result), builder.GetValue(argument)));
+            }
+            else
+            {
+                builder.Store(result, label);
+                builder.Store(argument, label);
+                Emit(*residual, instruction.opcode, result, argument, label);
+                builder.SetFree(result);
+            }
+            break;
+        case ProgramOpcode::Goto:
+            next_index = instruction.target;
+            break;
+        case ProgramOpcode::IfAMoreBGoto:
+        case ProgramOpcode::IfALessBGoto:
+        {
+            if (!builder.IsKnown(result) || !builder.IsKnown(argument))
+                throw std::runtime_error("BasicProgramSpecializer::Build(): condition is not constant");
+            const W a = builder.GetValue(result);
+            const W b = builder.GetValue(argument);
+            if (instruction.opcode == ProgramOpcode::IfAMoreBGoto ? a > b : a < b)
+            {
+                next_index = instruction.target;
+            }
+            break;
+        }
+        }
+        statement_index = next_index;
+    }
+    builder.StoreAll("");
+    return residual;
+}
+
+template struct BasicProgramSpecializer<uint8_t>;
+template struct BasicProgramSpecializer<uint16_t>;
+template struct BasicProgramSpecializer<uint32_t>;
+template struct BasicProgramSpecializer<uint64_t>;
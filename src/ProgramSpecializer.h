@@ -0,0 +1,60 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "BitExpressions.h"
+#include "Program.h"
+#include "ProgramBytecode.h"
+
+// Partially evaluates a program on the fully constant input variables: branches are resolved,
+// loops unrolled and array indexes fixed, leaving a straight-line program over the free variables.
+// Constant values only reach the residual program through SetConstant, emitted right before a
+// statement that mixes them with free values and at the end for every variable that changed
+template<typename W>
+struct BasicProgramSpecializer
+{
+    static const size_t default_max_step_count = 1 << 24;
+
+    explicit BasicProgramSpecializer(const BasicProgram<W>& program, size_t max_step_count = default_max_step_count);
+
+    // Results are cached by which variables are fully constant and by their values
+    std::shared_ptr<const BasicProgram<W> > Specialize(const BitExpressionStates& input);
+    size_t GetCacheSize() const;
+    void ClearCache();
+private:
+    typedef std::vector<uint64_t> key_type;
+
+    std::shared_ptr<const BasicProgram<W> > Build(const BitExpressionStates& input) const;
+
+    const BasicProgram<W>& program;
+    std::shared_ptr<const BasicProgramBytecode<W> > code;
+    size_t max_step_count;
+    std::map<key_type, std::shared_ptr<const BasicProgram<W> > > cache;
+};
+
+typedef BasicProgramSpecializer<uint32_t> ProgramSpecializer;
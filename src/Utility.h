@@ -25,9 +25,11 @@
 #include <string>
 
 #include "BitExpressions.h"
+#include "BitExpressionPrinter.h"
 #include "Program.h"
 
-inline void Print(const Program& program, const FullState& info)
+template<typename W>
+void Print(const BasicProgram<W>& program, const BasicFullState<W>& info)
 {
     for (size_t index = 0; index < program.statements.size(); ++index)
     {
@@ -51,34 +53,43 @@ inline void PrintOutput(const BitExpressionStates& state)
     }
 }
 
-inline void PrintCurrentBit(const BitExpressionStates& state, size_t var_index, size_t bit_number)
+inline void AddCurrentVar(BitExpressionPrinter& printer, const BitExpressionStates& state, size_t var_index)
 {
-    std::string value;
-    size_t bit_index = BitExpressionStates::GetBitIndex(var_index, bit_number);
-    if (state.IsCurrentBitConstant(bit_index))
+    for (size_t bit_number = 0; bit_number < state.GetBitCount(); ++bit_number)
     {
-        value = state.GetCurrentBitValue(bit_index) ? "1" : "0";
+        const size_t bit_index = BitExpressionStates::GetBitIndex(var_index, bit_number);
+        if (!state.IsCurrentBitConstant(bit_index))
+        {
+            printer.AddRoot("Var " + state.GetVarName(var_index) + "." + std::to_string(bit_number), state.GetBitExpression(bit_index));
+        }
     }
-    else
-    {
-        value = state.GetBitExpression(bit_index)->ToString(state);
-        std::cout << "Var " << state.GetVarName(var_index) << "." << bit_number << " = " << value << std::endl;
-    }
-    //std::cout << "Var " << state.GetVarName(var_index) << "." << bit_number << " = " << value << std::endl;
 }
 
-inline void PrintCurrentVar(const BitExpressionStates& state, size_t var_index)
+inline void PrintCurrentBit(const BitExpressionStates& state, size_t var_index, size_t bit_number, std::ostream& output = std::cout)
 {
-    for (size_t bit_number = 0; bit_number < BitExpressionStates::bit_count; ++bit_number)
+    const size_t bit_index = BitExpressionStates::GetBitIndex(var_index, bit_number);
+    if (!state.IsCurrentBitConstant(bit_index))
     {
-        PrintCurrentBit(state, var_index, bit_number);
+        BitExpressionPrinter printer(state);
+        printer.AddRoot("Var " + state.GetVarName(var_index) + "." + std::to_string(bit_number), state.GetBitExpression(bit_index));
+        printer.Write(output);
     }
 }
 
-inline void PrintCurrent(const BitExpressionStates& state)
+inline void PrintCurrentVar(const BitExpressionStates& state, size_t var_index, std::ostream& output = std::cout)
+{
+    BitExpressionPrinter printer(state);
+    AddCurrentVar(printer, state, var_index);
+    printer.Write(output);
+}
+
+// Bits of all variables share one printer so subterms common to several variables are bound once
+inline void PrintCurrent(const BitExpressionStates& state, std::ostream& output = std::cout)
 {
+    BitExpressionPrinter printer(state);
     for (size_t var_index = 0; var_index < state.GetVariableCount(); ++var_index)
     {
-        PrintCurrentVar(state, var_index);
+        AddCurrentVar(printer, state, var_index);
     }
+    printer.Write(output);
 }
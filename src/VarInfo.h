@@ -24,12 +24,15 @@
 #include <stddef.h>
 #include <vector>
 #include <string>
+#include <iterator>
+#include <map>
+#include <unordered_map>
 
 struct Info
 {
-    virtual std::string GetVarName(size_t index) const = 0;
-    virtual std::string GetArrayName(size_t index) const = 0;
-    virtual std::string GetLabelName(size_t index) const = 0;
+    virtual const std::string& GetVarName(size_t index) const = 0;
+    virtual const std::string& GetArrayName(size_t index) const = 0;
+    virtual const std::string& GetLabelName(size_t index) const = 0;
 };
 
 class CVarInfo : public Info
@@ -43,10 +46,52 @@ class CVarInfo : public Info
     std::vector<ObjectInfo> arrays;
     std::vector<ObjectInfo> variables;
     std::vector<ObjectInfo> labels;
+    // Arrays keyed by their first index, so the array holding an index is found by upper_bound.
+    // Once two ranges overlap the first array added wins, which only a scan can tell
+    std::map<size_t, size_t> array_starts;
+    bool overlapping_arrays;
+    std::unordered_map<size_t, size_t> variable_indexes;
+    std::unordered_map<size_t, size_t> label_indexes;
+    // Composed names are built once and handed out by reference. The const getters fill these
+    // caches, so a CVarInfo must not be shared between threads
+    mutable std::unordered_map<size_t, std::string> display_names;
+    mutable std::unordered_map<size_t, std::string> unnamed_var_names;
+    mutable std::unordered_map<size_t, std::string> unnamed_label_names;
+
+    static bool Contains(const ObjectInfo& array, size_t index)
+    {
+        return index >= array.index && index < array.index + array.array_size;
+    }
+    const ObjectInfo* FindArray(size_t index) const
+    {
+        if (overlapping_arrays)
+        {
+            for (size_t i = 0; i < arrays.size(); ++i)
+            {
+                if (Contains(arrays[i], index))
+                    return &arrays[i];
+            }
+            return nullptr;
+        }
+        auto found = array_starts.upper_bound(index);
+        if (found == array_starts.begin())
+            return nullptr;
+        const ObjectInfo& array = arrays[(--found)->second];
+        return Contains(array, index) ? &array : nullptr;
+    }
+    static const std::string& GetUnnamed(std::unordered_map<size_t, std::string>& cache, size_t index, const std::string& prefix)
+    {
+        auto found = cache.find(index);
+        if (found == cache.end())
+        {
+            found = cache.insert(std::make_pair(index, prefix + std::to_string(index))).first;
+        }
+        return found->second;
+    }
 public:
     bool unnamed_labels;
 
-    CVarInfo() : unnamed_labels(false)
+    CVarInfo() : overlapping_arrays(false), unnamed_labels(false)
     {
     }
 
@@ -57,6 +102,14 @@ public:
         new_item.index = index;
         new_item.array_size = array_size;
         arrays.push_back(new_item);
+        if (array_size <= 0)
+            return;
+        auto next = array_starts.lower_bound(index);
+        if (next != array_starts.end() && next->first < index + array_size)
+            overlapping_arrays = true;
+        if (next != array_starts.begin() && Contains(arrays[std::prev(next)->second], index))
+            overlapping_arrays = true;
+        array_starts.insert(std::make_pair(index, arrays.size() - 1));
     }
     void AddVariable(const std::string& name, size_t index)
     {
@@ -65,6 +118,7 @@ public:
         new_item.index = index;
         new_item.array_size = 1;
         variables.push_back(new_item);
+        variable_indexes.insert(std::make_pair(index, variables.size() - 1));
     }
     void AddLabel(const std::string& name, size_t index)
     {
@@ -73,42 +127,38 @@ public:
         new_item.index = index;
         new_item.array_size = 1;
         labels.push_back(new_item);
+        label_indexes[index] = labels.size() - 1;
     }
-    std::string GetVarName(size_t index) const
+    const std::string& GetVarName(size_t index) const
     {
-        for (size_t i = 0; i < arrays.size(); ++i)
-        {
-            if (index >= arrays[i].index && index < arrays[i].index + arrays[i].array_size)
-                return arrays[i].name + "[" + std::to_string(index - arrays[i].index) + "]";
-        }
-        for (size_t i = 0; i < variables.size(); ++i)
+        if (const ObjectInfo* array = FindArray(index))
         {
-            if (index == variables[i].index)
-                return variables[i].name;
+            auto found = display_names.find(index);
+            if (found == display_names.end())
+            {
+                found = display_names.insert(std::make_pair(index, array->name + "[" + std::to_string(index - array->index) + "]")).first;
+            }
+            return found->second;
         }
-        return "V" + std::to_string(index) + "";
+        auto found = variable_indexes.find(index);
+        if (found != variable_indexes.end())
+            return variables[found->second].name;
+        return GetUnnamed(unnamed_var_names, index, "V");
     }
-    std::string GetArrayName(size_t index) const
+    const std::string& GetArrayName(size_t index) const
     {
-        for (size_t i = 0; i < arrays.size(); ++i)
-        {
-            if (index >= arrays[i].index && index < arrays[i].index + arrays[i].array_size)
-                return arrays[i].name;
-        }
-        return "V" + std::to_string(index) + "";
+        if (const ObjectInfo* array = FindArray(index))
+            return array->name;
+        return GetUnnamed(unnamed_var_names, index, "V");
     }
-    std::string GetLabelName(size_t index) const
+    const std::string& GetLabelName(size_t index) const
     {
-        std::string result;
-        for (size_t i = 0; i < labels.size(); ++i)
-        {
-            if (index == labels[i].index)
-                result = labels[i].name;
-        }
-        if (result.empty() && unnamed_labels)
-        {
-            result = std::to_string(index);
-        }
-        return result;
+        static const std::string empty;
+        auto found = label_indexes.find(index);
+        if (found != label_indexes.end() && !labels[found->second].name.empty())
+            return labels[found->second].name;
+        if (unnamed_labels)
+            return GetUnnamed(unnamed_label_names, index, "");
+        return empty;
     }
 };
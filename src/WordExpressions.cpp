@@ -0,0 +1,428 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdexcept>
+
+#include "WordExpressions.h"
+
+static bool AreComplementary(const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right)
+{
+    return (left->GetKind() == WordExpressionKind::Not && left->GetOperand(0) == right) ||
+        (right->GetKind() == WordExpressionKind::Not && right->GetOperand(0) == left);
+}
+
+static WordExpression::work_type RotateLeft(WordExpression::work_type value, size_t amount, size_t bit_count)
+{
+    return amount ? (value << amount) | (value >> (bit_count - amount)) : value;
+}
+
+WordExpression::WordExpression(WordExpressionKind kind_, size_t bit_count_, work_type value_, const std::shared_ptr<WordExpression>& left_, const std::shared_ptr<WordExpression>& right_)
+    : kind(kind_), bit_count(bit_count_), value(value_), left(left_), right(right_)
+{
+}
+
+std::shared_ptr<WordExpression> WordExpression::Const(work_type value, size_t bit_count)
+{
+    if (!bit_count || bit_count > BitExpressionStates::max_bit_count)
+        throw std::runtime_error("WordExpression::Const(): word width is not supported");
+
+    std::shared_ptr<WordExpression> result = std::make_shared<WordExpression>(WordExpressionKind::Const, bit_count, 0, nullptr, nullptr);
+    result->value = value & result->GetWordMask();
+    return result;
+}
+
+std::shared_ptr<WordExpression> WordExpression::Bits(const bits_type& bits)
+{
+    if (bits.empty() || bits.size() > BitExpressionStates::max_bit_count)
+        throw std::runtime_error("WordExpression::Bits(): wrong bit count");
+
+    work_type value = 0;
+    for (size_t bit_number = 0; bit_number < bits.size(); ++bit_number)
+    {
+        const BitExpressionKey& key = bits[bit_number]->GetKey();
+        if (key.kind != BitExpressionKind::Const)
+        {
+            std::shared_ptr<WordExpression> result = std::make_shared<WordExpression>(WordExpressionKind::Bits, bits.size(), 0, nullptr, nullptr);
+            result->bits = bits;
+            return result;
+        }
+        value |= static_cast<work_type>(key.first) << bit_number;
+    }
+    return Const(value, bits.size());
+}
+
+std::shared_ptr<WordExpression> WordExpression::Not(const std::shared_ptr<WordExpression>& argument)
+{
+    if (argument->IsConstant())
+    {
+        return Const(~argument->GetValue(), argument->bit_count);
+    }
+    if (argument->GetKind() == WordExpressionKind::Not)
+    {
+        return argument->GetOperand(0);
+    }
+    return std::make_shared<WordExpression>(WordExpressionKind::Not, argument->bit_count, 0, argument, nullptr);
+}
+
+std::shared_ptr<WordExpression> WordExpression::Binary(WordExpressionKind kind, const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right)
+{
+    switch (kind)
+    {
+    case WordExpressionKind::And:
+    case WordExpressionKind::Or:
+    case WordExpressionKind::Xor:
+    case WordExpressionKind::Add:
+    case WordExpressionKind::Mul:
+        break;
+    default:
+        throw std::runtime_error("WordExpression::Binary(): word expression kind is not binary");
+    }
+    if (left->bit_count != right->bit_count)
+        throw std::runtime_error("WordExpression::Binary(): word widths differ");
+
+    const size_t bit_count = left->bit_count;
+    const work_type all_ones = left->GetWordMask();
+    // All binary operators commute, so a constant operand is kept on the right
+    if (left->IsConstant() && !right->IsConstant())
+    {
+        return Binary(kind, right, left);
+    }
+    if (left->IsConstant())
+    {
+        const work_type a = left->GetValue();
+        const work_type b = right->GetValue();
+        switch (kind)
+        {
+        case WordExpressionKind::And:
+            return Const(a & b, bit_count);
+        case WordExpressionKind::Or:
+            return Const(a | b, bit_count);
+        case WordExpressionKind::Xor:
+            return Const(a ^ b, bit_count);
+        case WordExpressionKind::Add:
+            return Const(a + b, bit_count);
+        default:
+            return Const(a * b, bit_count);
+        }
+    }
+    if (right->IsConstant())
+    {
+        if (left->GetKind() == kind && left->GetOperand(1)->IsConstant())
+        {
+            return Binary(kind, left->GetOperand(0), Binary(kind, left->GetOperand(1), right));
+        }
+        const work_type constant = right->GetValue();
+        switch (kind)
+        {
+        case WordExpressionKind::And:
+            if (constant == 0 || constant == all_ones)
+                return constant ? left : right;
+            break;
+        case WordExpressionKind::Or:
+            if (constant == 0 || constant == all_ones)
+                return constant ? right : left;
+            break;
+        case WordExpressionKind::Xor:
+            if (constant == 0)
+                return left;
+            if (constant == all_ones)
+                return Not(left);
+            break;
+        case WordExpressionKind::Add:
+            if (constant == 0)
+                return left;
+            break;
+        default:
+            if (constant == 0)
+                return right;
+            if (constant == 1)
+                return left;
+            break;
+        }
+    }
+    else if (left == right)
+    {
+        if (kind == WordExpressionKind::And || kind == WordExpressionKind::Or)
+            return left;
+        if (kind == WordExpressionKind::Xor)
+            return Const(0, bit_count);
+    }
+    else if (AreComplementary(left, right))
+    {
+        if (kind == WordExpressionKind::And)
+            return Const(0, bit_count);
+        if (kind == WordExpressionKind::Or || kind == WordExpressionKind::Xor)
+            return Const(all_ones, bit_count);
+    }
+    return std::make_shared<WordExpression>(kind, bit_count, 0, left, right);
+}
+
+std::shared_ptr<WordExpression> WordExpression::Rotl(const std::shared_ptr<WordExpression>& argument, size_t amount)
+{
+    amount %= argument->bit_count;
+    if (!amount)
+    {
+        return argument;
+    }
+    if (argument->IsConstant())
+    {
+        return Const(RotateLeft(argument->GetValue(), amount, argument->bit_count), argument->bit_count);
+    }
+    if (argument->GetKind() == WordExpressionKind::Rotl)
+    {
+        return Rotl(argument->GetOperand(0), argument->GetAmount() + amount);
+    }
+    return std::make_shared<WordExpression>(WordExpressionKind::Rotl, argument->bit_count, static_cast<work_type>(amount), argument, nullptr);
+}
+
+WordExpressionKind WordExpression::GetKind() const
+{
+    return kind;
+}
+
+size_t WordExpression::GetBitCount() const
+{
+    return bit_count;
+}
+
+WordExpression::work_type WordExpression::GetWordMask() const
+{
+    return bit_count == BitExpressionStates::max_bit_count ? ~static_cast<work_type>(0) : (static_cast<work_type>(1) << bit_count) - 1;
+}
+
+bool WordExpression::IsConstant() const
+{
+    return kind == WordExpressionKind::Const;
+}
+
+WordExpression::work_type WordExpression::GetValue() const
+{
+    if (!IsConstant())
+        throw std::runtime_error("WordExpression::GetValue(): word expression is not constant");
+
+    return value;
+}
+
+size_t WordExpression::GetAmount() const
+{
+    return kind == WordExpressionKind::Rotl ? value : 0;
+}
+
+size_t WordExpression::GetOperandCount() const
+{
+    return right ? 2 : left ? 1 : 0;
+}
+
+const std::shared_ptr<WordExpression>& WordExpression::GetOperand(size_t index) const
+{
+    if (index >= GetOperandCount())
+        throw std::runtime_error("WordExpression::GetOperand(): operand index is out of range");
+
+    return index ? right : left;
+}
+
+const std::shared_ptr<IBitExpression>& WordExpression::GetBit(size_t bit_number) const
+{
+    return GetBits().at(bit_number);
+}
+
+const WordExpression::bits_type& WordExpression::GetBits() const
+{
+    if (bits.empty())
+    {
+        Blast();
+    }
+    return bits;
+}
+
+// Ripple-carry addition of addend into sum; addend bits below first_bit must be zero
+void WordExpression::AddBits(bits_type& sum, const bits_type& addend, size_t first_bit)
+{
+    std::shared_ptr<IBitExpression> carry = const_bool(false);
+    for (size_t bit_number = first_bit; bit_number < sum.size(); ++bit_number)
+    {
+        const std::shared_ptr<IBitExpression> a = sum[bit_number];
+        const std::shared_ptr<IBitExpression>& b = addend[bit_number];
+        const std::shared_ptr<IBitExpression> half_sum = a ^ b;
+        sum[bit_number] = half_sum ^ carry;
+        if (bit_number + 1 < sum.size())
+        {
+            carry = (a & b) | (carry & half_sum);
+        }
+    }
+}
+
+void WordExpression::Blast() const
+{
+    std::vector<const WordExpression*> nodes;
+    nodes.push_back(this);
+    while (!nodes.empty())
+    {
+        const WordExpression* node = nodes.back();
+        if (!node->bits.empty())
+        {
+            nodes.pop_back();
+            continue;
+        }
+        bool ready = true;
+        for (size_t i = 0; i < node->GetOperandCount(); ++i)
+        {
+            if (node->GetOperand(i)->bits.empty())
+            {
+                nodes.push_back(node->GetOperand(i).get());
+                ready = false;
+            }
+        }
+        if (!ready)
+        {
+            continue;
+        }
+        const size_t bit_count = node->bit_count;
+        bits_type result;
+        result.reserve(bit_count);
+        const bits_type* left_bits = node->left ? &node->left->bits : nullptr;
+        const bits_type* right_bits = node->right ? &node->right->bits : nullptr;
+        switch (node->kind)
+        {
+        case WordExpressionKind::Const:
+            for (size_t bit_number = 0; bit_number < bit_count; ++bit_number)
+            {
+                result.push_back(const_bool(BitExpressionStates::ExtractBit(node->value, bit_number)));
+            }
+            break;
+        case WordExpressionKind::Not:
+            for (size_t bit_number = 0; bit_number < bit_count; ++bit_number)
+            {
+                result.push_back(~(*left_bits)[bit_number]);
+            }
+            break;
+        case WordExpressionKind::And:
+        case WordExpressionKind::Or:
+        case WordExpressionKind::Xor:
+            for (size_t bit_number = 0; bit_number < bit_count; ++bit_number)
+            {
+                const std::shared_ptr<IBitExpression>& a = (*left_bits)[bit_number];
+                const std::shared_ptr<IBitExpression>& b = (*right_bits)[bit_number];
+                result.push_back(node->kind == WordExpressionKind::And ? a & b : node->kind == WordExpressionKind::Or ? a | b : a ^ b);
+            }
+            break;
+        case WordExpressionKind::Add:
+            result = *left_bits;
+            AddBits(result, *right_bits, 0);
+            break;
+        case WordExpressionKind::Mul:
+            result.assign(bit_count, const_bool(false));
+            for (size_t shift = 0; shift < bit_count; ++shift)
+            {
+                const std::shared_ptr<IBitExpression>& multiplier = (*right_bits)[shift];
+                const BitExpressionKey& key = multiplier->GetKey();
+                if (key.kind == BitExpressionKind::Const && !key.first)
+                {
+                    continue;
+                }
+                bits_type partial(bit_count, const_bool(false));
+                for (size_t bit_number = shift; bit_number < bit_count; ++bit_number)
+                {
+                    partial[bit_number] = (*left_bits)[bit_number - shift] & multiplier;
+                }
+                AddBits(result, partial, shift);
+            }
+            break;
+        case WordExpressionKind::Rotl:
+            result.resize(bit_count);
+            for (size_t bit_number = 0; bit_number < bit_count; ++bit_number)
+            {
+                result[(bit_number + node->value) % bit_count] = (*left_bits)[bit_number];
+            }
+            break;
+        default:
+            throw std::runtime_error("WordExpression::Blast(): unknown word expression");
+        }
+        node->bits.swap(result);
+        nodes.pop_back();
+    }
+}
+
+std::shared_ptr<WordExpression> word_const(WordExpression::work_type value, size_t bit_count)
+{
+    return WordExpression::Const(value, bit_count);
+}
+
+std::shared_ptr<WordExpression> word_bits(const WordExpression::bits_type& bits)
+{
+    return WordExpression::Bits(bits);
+}
+
+std::shared_ptr<WordExpression> rotl(const std::shared_ptr<WordExpression>& argument, size_t amount)
+{
+    return WordExpression::Rotl(argument, amount);
+}
+
+std::shared_ptr<WordExpression> operator&(const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right)
+{
+    return WordExpression::Binary(WordExpressionKind::And, left, right);
+}
+
+std::shared_ptr<WordExpression> operator|(const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right)
+{
+    return WordExpression::Binary(WordExpressionKind::Or, left, right);
+}
+
+std::shared_ptr<WordExpression> operator^(const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right)
+{
+    return WordExpression::Binary(WordExpressionKind::Xor, left, right);
+}
+
+std::shared_ptr<WordExpression> operator+(const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right)
+{
+    return WordExpression::Binary(WordExpressionKind::Add, left, right);
+}
+
+std::shared_ptr<WordExpression> operator*(const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right)
+{
+    return WordExpression::Binary(WordExpressionKind::Mul, left, right);
+}
+
+std::shared_ptr<WordExpression> operator~(const std::shared_ptr<WordExpression>& argument)
+{
+    return WordExpression::Not(argument);
+}
+
+std::shared_ptr<IBitExpression> word_less(const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right)
+{
+    if (left->GetBitCount() != right->GetBitCount())
+        throw std::runtime_error("word_less(): word widths differ");
+
+    if (left->IsConstant() && right->IsConstant())
+    {
+        return const_bool(left->GetValue() < right->GetValue());
+    }
+    const WordExpression::bits_type& left_bits = left->GetBits();
+    const WordExpression::bits_type& right_bits = right->GetBits();
+    std::shared_ptr<IBitExpression> less = const_bool(false);
+    for (size_t bit_number = 0; bit_number < left_bits.size(); ++bit_number)
+    {
+        const std::shared_ptr<IBitExpression>& a = left_bits[bit_number];
+        const std::shared_ptr<IBitExpression>& b = right_bits[bit_number];
+        less = (~a & b) | (~(a ^ b) & less);
+    }
+    return less;
+}
@@ -0,0 +1,90 @@
+/*
+ * HashReverser reverses hashes
+ * Copyright (C) 2017 Petr Petrovich Petrov
+ *
+ * This file is part of HashReverser.
+ *
+ * HashReverser is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HashReverser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HashReverser.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <memory>
+
+#include "BitExpressions.h"
+
+enum class WordExpressionKind : uint32_t
+{
+    Const,
+    Bits,
+    Not,
+    And,
+    Or,
+    Xor,
+    Add,
+    Mul,
+    Rotl
+};
+
+// Immutable word term over words of GetBitCount() bits; bits are blasted on first query and kept
+struct WordExpression
+{
+    typedef BitExpressionStates::work_type work_type;
+    typedef std::vector<std::shared_ptr<IBitExpression> > bits_type;
+
+    static std::shared_ptr<WordExpression> Const(work_type value, size_t bit_count);
+    static std::shared_ptr<WordExpression> Bits(const bits_type& bits);
+    static std::shared_ptr<WordExpression> Not(const std::shared_ptr<WordExpression>& argument);
+    static std::shared_ptr<WordExpression> Binary(WordExpressionKind kind, const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right);
+    static std::shared_ptr<WordExpression> Rotl(const std::shared_ptr<WordExpression>& argument, size_t amount);
+
+    WordExpressionKind GetKind() const;
+    size_t GetBitCount() const;
+    work_type GetWordMask() const;
+    bool IsConstant() const;
+    work_type GetValue() const;
+    size_t GetAmount() const;
+    size_t GetOperandCount() const;
+    const std::shared_ptr<WordExpression>& GetOperand(size_t index) const;
+    const std::shared_ptr<IBitExpression>& GetBit(size_t bit_number) const;
+    const bits_type& GetBits() const;
+
+    WordExpression(WordExpressionKind kind, size_t bit_count, work_type value, const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right);
+private:
+    static void AddBits(bits_type& sum, const bits_type& addend, size_t first_bit);
+    void Blast() const;
+
+    WordExpressionKind kind;
+    size_t bit_count;
+    work_type value;
+    std::shared_ptr<WordExpression> left, right;
+    mutable bits_type bits;
+};
+
+std::shared_ptr<WordExpression> word_const(WordExpression::work_type value, size_t bit_count);
+std::shared_ptr<WordExpression> word_bits(const WordExpression::bits_type& bits);
+std::shared_ptr<WordExpression> rotl(const std::shared_ptr<WordExpression>& argument, size_t amount);
+std::shared_ptr<WordExpression> operator&(const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right);
+std::shared_ptr<WordExpression> operator|(const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right);
+std::shared_ptr<WordExpression> operator^(const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right);
+std::shared_ptr<WordExpression> operator+(const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right);
+std::shared_ptr<WordExpression> operator*(const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right);
+std::shared_ptr<WordExpression> operator~(const std::shared_ptr<WordExpression>& argument);
+
+// Unsigned left < right as one bit, rippled up from the least significant bits
+std::shared_ptr<IBitExpression> word_less(const std::shared_ptr<WordExpression>& left, const std::shared_ptr<WordExpression>& right);